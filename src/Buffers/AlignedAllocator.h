@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+// Sample storage starts on a cache line, which also suits any SIMD width up to AVX-512
+#define BUFFER_ALIGNMENT 64
+
+namespace dePhonica {
+namespace Buffers {
+
+template<typename T, size_t Alignment = BUFFER_ALIGNMENT>
+struct AlignedAllocator
+{
+    using value_type = T;
+
+    template<typename U>
+    struct rebind
+    {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator() = default;
+
+    template<typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&)
+    {
+    }
+
+    T* allocate(size_t count)
+    {
+        return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(Alignment)));
+    }
+
+    void deallocate(T* pointer, size_t)
+    {
+        ::operator delete(pointer, std::align_val_t(Alignment));
+    }
+
+    template<typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+
+    template<typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+};
+
+template<typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+} // namespace Buffers
+} // namespace dePhonica
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+namespace dePhonica {
+namespace Buffers {
+
+#define RING_BUFFER_CACHE_LINE 64
+
+// Up to two contiguous regions of a ring, the second one starts at the beginning of the storage
+template<typename T>
+struct RingSpans
+{
+    T* First = nullptr;
+    size_t FirstLength = 0;
+
+    T* Second = nullptr;
+    size_t SecondLength = 0;
+
+    size_t Length() const { return FirstLength + SecondLength; }
+};
+
+// Single-producer single-consumer ring with a power-of-two capacity.
+// Positions only ever grow and are wrapped with a mask; each side owns its position and keeps a cached copy of the other one
+// on its own cache line, so the sides only share a line when the cached copy runs out. Never allocates after construction
+// or Reserve, a push that does not fit is refused and counted rather than overwriting unread data.
+template<typename T>
+class RingBuffer
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Ring buffers move data with memcpy");
+
+private:
+    std::vector<T> storeBuffer_;
+    size_t mask_;
+
+    alignas(RING_BUFFER_CACHE_LINE) std::atomic<size_t> writePosition_;
+    size_t cachedReadPosition_;
+    size_t overflowsCount_;
+
+    alignas(RING_BUFFER_CACHE_LINE) std::atomic<size_t> readPosition_;
+    size_t cachedWritePosition_;
+
+    static size_t RoundCapacity(size_t capacity)
+    {
+        size_t powerOfTwo = 1;
+
+        while (powerOfTwo < capacity)
+        {
+            powerOfTwo <<= 1;
+        }
+
+        return powerOfTwo;
+    }
+
+    RingSpans<T> SpansAt(size_t position, size_t length)
+    {
+        RingSpans<T> spans;
+
+        size_t offset = position & mask_;
+
+        spans.First = storeBuffer_.data() + offset;
+        spans.FirstLength = std::min(length, storeBuffer_.size() - offset);
+
+        spans.Second = storeBuffer_.data();
+        spans.SecondLength = length - spans.FirstLength;
+
+        return spans;
+    }
+
+public:
+    explicit RingBuffer(size_t capacity = 1)
+        : storeBuffer_(RoundCapacity(capacity))
+        , mask_(storeBuffer_.size() - 1)
+        , writePosition_(0)
+        , cachedReadPosition_(0)
+        , overflowsCount_(0)
+        , readPosition_(0)
+        , cachedWritePosition_(0)
+    {
+    }
+
+    // Copies the capacity only, so rings can be kept in vectors before they are used
+    RingBuffer(const RingBuffer& other)
+        : RingBuffer(other.Capacity())
+    {
+    }
+
+    size_t Capacity() const { return storeBuffer_.size(); }
+
+    // Exact from the owning side, a lower bound of what is available from the other one
+    size_t DataLengthSamples() const
+    {
+        return writePosition_.load(std::memory_order_acquire) - readPosition_.load(std::memory_order_acquire);
+    }
+
+    size_t FreeSpace() const { return Capacity() - DataLengthSamples(); }
+
+    size_t OverflowsCount() const { return overflowsCount_; }
+
+    // Producer side
+
+    // Free regions of at most maxLength, filled in place and published with CommitWrite
+    RingSpans<T> WriteSpans(size_t maxLength)
+    {
+        size_t writePosition = writePosition_.load(std::memory_order_relaxed);
+
+        if (Capacity() - (writePosition - cachedReadPosition_) < maxLength)
+        {
+            cachedReadPosition_ = readPosition_.load(std::memory_order_acquire);
+        }
+
+        return SpansAt(writePosition, std::min(maxLength, Capacity() - (writePosition - cachedReadPosition_)));
+    }
+
+    void CommitWrite(size_t length)
+    {
+        writePosition_.store(writePosition_.load(std::memory_order_relaxed) + length, std::memory_order_release);
+    }
+
+    // Copies all of the data or nothing
+    bool Push(const T* data, size_t length)
+    {
+        auto spans = WriteSpans(length);
+
+        if (spans.Length() < length)
+        {
+            overflowsCount_++;
+            return false;
+        }
+
+        memcpy(spans.First, data, spans.FirstLength * sizeof(T));
+
+        if (spans.SecondLength > 0)
+        {
+            memcpy(spans.Second, data + spans.FirstLength, spans.SecondLength * sizeof(T));
+        }
+
+        CommitWrite(length);
+
+        return true;
+    }
+
+    // Consumer side
+
+    // Stored regions of at most maxLength, read in place and released with CommitRead
+    RingSpans<T> ReadSpans(size_t maxLength)
+    {
+        size_t readPosition = readPosition_.load(std::memory_order_relaxed);
+
+        if (cachedWritePosition_ - readPosition < maxLength)
+        {
+            cachedWritePosition_ = writePosition_.load(std::memory_order_acquire);
+        }
+
+        return SpansAt(readPosition, std::min(maxLength, cachedWritePosition_ - readPosition));
+    }
+
+    void CommitRead(size_t length)
+    {
+        readPosition_.store(readPosition_.load(std::memory_order_relaxed) + length, std::memory_order_release);
+    }
+
+    // Copies what is available up to length, the rest of the destination is zeroed; returns the samples copied
+    size_t Pop(T* data, size_t length)
+    {
+        auto spans = ReadSpans(length);
+
+        memcpy(data, spans.First, spans.FirstLength * sizeof(T));
+
+        if (spans.SecondLength > 0)
+        {
+            memcpy(data + spans.FirstLength, spans.Second, spans.SecondLength * sizeof(T));
+        }
+
+        if (spans.Length() < length)
+        {
+            std::fill(data + spans.Length(), data + length, T());
+        }
+
+        CommitRead(spans.Length());
+
+        return spans.Length();
+    }
+
+    size_t Purge(size_t length)
+    {
+        auto spans = ReadSpans(length);
+
+        CommitRead(spans.Length());
+
+        return spans.Length();
+    }
+
+    // Neither side may be active
+
+    void Flush()
+    {
+        writePosition_.store(0, std::memory_order_relaxed);
+        readPosition_.store(0, std::memory_order_relaxed);
+
+        cachedReadPosition_ = cachedWritePosition_ = 0;
+    }
+
+    // Allocates when growing, stored data is kept
+    void Reserve(size_t capacity)
+    {
+        if (capacity <= Capacity())
+        {
+            return;
+        }
+
+        std::vector<T> newBuffer(RoundCapacity(capacity));
+
+        size_t dataLength = Pop(newBuffer.data(), DataLengthSamples());
+
+        storeBuffer_.swap(newBuffer);
+        mask_ = storeBuffer_.size() - 1;
+
+        Flush();
+        writePosition_.store(dataLength, std::memory_order_relaxed);
+    }
+};
+
+} // namespace Buffers
+} // namespace dePhonica
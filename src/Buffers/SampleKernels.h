@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstddef>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#include "SampleTraits.h"
+
+namespace dePhonica {
+namespace Buffers {
+
+// Single pass loops over one channel. Generic versions serve any sample type and saturate integer samples,
+// float has SSE overloads; pointers need no particular alignment, although SingleBuffer channels always start on BUFFER_ALIGNMENT.
+
+// target += source
+template<typename T>
+inline void MixSamples(T* targetSamples, const T* sourceSamples, size_t samplesCount)
+{
+    for (size_t n = 0; n < samplesCount; n++)
+    {
+        targetSamples[n] = SampleTraits<T>::FromDouble(static_cast<double>(targetSamples[n]) + sourceSamples[n]);
+    }
+}
+
+// target = source * gain
+template<typename T>
+inline void CopySamples(T* targetSamples, const T* sourceSamples, float gain, size_t samplesCount)
+{
+    for (size_t n = 0; n < samplesCount; n++)
+    {
+        targetSamples[n] = SampleTraits<T>::FromDouble(static_cast<double>(sourceSamples[n]) * gain);
+    }
+}
+
+template<typename T>
+inline void AmplifySamples(T* samples, float gain, size_t samplesCount)
+{
+    for (size_t n = 0; n < samplesCount; n++)
+    {
+        samples[n] = SampleTraits<T>::FromDouble(static_cast<double>(samples[n]) * gain);
+    }
+}
+
+// Sample n is scaled by initialGain + n * gainStep
+template<typename T>
+inline void RampSamples(T* samples, float initialGain, float gainStep, size_t samplesCount)
+{
+    for (size_t n = 0; n < samplesCount; n++)
+    {
+        samples[n] = SampleTraits<T>::FromDouble(static_cast<double>(samples[n]) * (initialGain + gainStep * static_cast<float>(n)));
+    }
+}
+
+#ifdef __SSE__
+
+inline void MixSamples(float* targetSamples, const float* sourceSamples, size_t samplesCount)
+{
+    size_t n = 0;
+
+    for (; n + 4 <= samplesCount; n += 4)
+    {
+        _mm_storeu_ps(targetSamples + n, _mm_add_ps(_mm_loadu_ps(targetSamples + n), _mm_loadu_ps(sourceSamples + n)));
+    }
+
+    for (; n < samplesCount; n++)
+    {
+        targetSamples[n] += sourceSamples[n];
+    }
+}
+
+inline void CopySamples(float* targetSamples, const float* sourceSamples, float gain, size_t samplesCount)
+{
+    const __m128 gains = _mm_set1_ps(gain);
+
+    size_t n = 0;
+
+    for (; n + 4 <= samplesCount; n += 4)
+    {
+        _mm_storeu_ps(targetSamples + n, _mm_mul_ps(_mm_loadu_ps(sourceSamples + n), gains));
+    }
+
+    for (; n < samplesCount; n++)
+    {
+        targetSamples[n] = sourceSamples[n] * gain;
+    }
+}
+
+inline void AmplifySamples(float* samples, float gain, size_t samplesCount)
+{
+    const __m128 gains = _mm_set1_ps(gain);
+
+    size_t n = 0;
+
+    for (; n + 4 <= samplesCount; n += 4)
+    {
+        _mm_storeu_ps(samples + n, _mm_mul_ps(_mm_loadu_ps(samples + n), gains));
+    }
+
+    for (; n < samplesCount; n++)
+    {
+        samples[n] *= gain;
+    }
+}
+
+inline void RampSamples(float* samples, float initialGain, float gainStep, size_t samplesCount)
+{
+    // Gains are computed from the sample index rather than accumulated, so long blocks do not drift
+    const __m128 initialGains = _mm_set1_ps(initialGain);
+    const __m128 gainSteps = _mm_set1_ps(gainStep);
+    const __m128 indexStep = _mm_set1_ps(4.0f);
+
+    __m128 indices = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+
+    size_t n = 0;
+
+    for (; n + 4 <= samplesCount; n += 4)
+    {
+        __m128 gains = _mm_add_ps(initialGains, _mm_mul_ps(gainSteps, indices));
+        _mm_storeu_ps(samples + n, _mm_mul_ps(_mm_loadu_ps(samples + n), gains));
+
+        indices = _mm_add_ps(indices, indexStep);
+    }
+
+    for (; n < samplesCount; n++)
+    {
+        samples[n] *= initialGain + gainStep * static_cast<float>(n);
+    }
+}
+
+#endif
+
+} // namespace Buffers
+} // namespace dePhonica
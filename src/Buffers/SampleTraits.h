@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace dePhonica {
+namespace Buffers {
+
+// How a sample type maps to the normalized [-1, 1] range the detectors and thresholds work in.
+// Floating point samples are normalized already, integer samples are fixed point with full scale at the type maximum.
+template<typename T>
+struct SampleTraits
+{
+    static constexpr double FullScale = 1.0;
+
+    // Identity, so float arithmetic stays in float exactly as it was written
+    static T Normalized(T sample) { return sample; }
+
+    static T FromDouble(double value) { return static_cast<T>(value); }
+
+    static T FromNormalized(double value) { return static_cast<T>(value); }
+};
+
+template<>
+struct SampleTraits<int32_t>
+{
+    static constexpr double FullScale = 2147483647.0;
+
+    static double Normalized(int32_t sample) { return sample / FullScale; }
+
+    // Rounds and saturates, out of range conversions would be undefined
+    static int32_t FromDouble(double value)
+    {
+        if (value >= FullScale)
+        {
+            return std::numeric_limits<int32_t>::max();
+        }
+
+        if (value <= -FullScale - 1)
+        {
+            return std::numeric_limits<int32_t>::min();
+        }
+
+        return static_cast<int32_t>(std::lrint(value));
+    }
+
+    static int32_t FromNormalized(double value) { return FromDouble(value * FullScale); }
+};
+
+// Converts between sample types through the normalized range
+template<typename Target, typename Source>
+inline void ConvertSamples(Target* targetSamples, const Source* sourceSamples, size_t samplesCount)
+{
+    for (size_t n = 0; n < samplesCount; n++)
+    {
+        targetSamples[n] = SampleTraits<Target>::FromNormalized(SampleTraits<Source>::Normalized(sourceSamples[n]));
+    }
+}
+
+} // namespace Buffers
+} // namespace dePhonica
@@ -1,9 +1,12 @@
 #pragma once
 
+#include <algorithm>
 #include <limits>
 #include <vector>
 #include <iostream>
 
+#include "AlignedAllocator.h"
+#include "SampleKernels.h"
 #include "Configuration.h"
 
 namespace dePhonica {
@@ -11,59 +14,107 @@ namespace Buffers {
 
 static float DefaultBufferSampleRate = 44100;
 
+// Samples are stored planar: every channel occupies its own contiguous region of ChannelStride() samples,
+// strides are rounded so every channel starts on BUFFER_ALIGNMENT
 template<typename T>
 class SingleBuffer
 {
 private:
-    std::vector<T> bufferData_;
+    AlignedVector<T> bufferData_;
 
     int channelsCount_;
+    size_t channelStride_;
     float sampleRate_;
     size_t dataLengthSamples_;
 
+    static size_t AlignedStride(size_t samplesCount)
+    {
+        const size_t alignmentSamples = BUFFER_ALIGNMENT / sizeof(T) > 0 ? BUFFER_ALIGNMENT / sizeof(T) : 1;
+
+        return (samplesCount + alignmentSamples - 1) / alignmentSamples * alignmentSamples;
+    }
+
+    void Reshape(int channelsCount, size_t channelStride)
+    {
+        // Same stride keeps every channel in place, so the storage is only reallocated when it is too small
+        if (channelStride == channelStride_ && channelsCount * channelStride <= bufferData_.size())
+        {
+            channelsCount_ = channelsCount;
+            return;
+        }
+
+        AlignedVector<T> reshapedData(channelsCount * channelStride);
+
+        int channelsToKeep = std::min(channelsCount, channelsCount_);
+        size_t samplesToKeep = std::min(channelStride, channelStride_);
+
+        for (int channel = 0; channel < channelsToKeep; channel++)
+        {
+            auto sourceStart = bufferData_.cbegin() + channel * channelStride_;
+            std::copy(sourceStart, sourceStart + samplesToKeep, reshapedData.begin() + channel * channelStride);
+        }
+
+        bufferData_.swap(reshapedData);
+
+        channelsCount_ = channelsCount;
+        channelStride_ = channelStride;
+    }
+
 public:
-    SingleBuffer(size_t samplesPerBuffer = 0)
+    SingleBuffer(size_t samplesPerBuffer = 0, int channelsCount = 1)
         : channelsCount_(1)
+        , channelStride_(0)
         , sampleRate_(DefaultBufferSampleRate)
         , dataLengthSamples_(0)
     {
+        Channels(channelsCount);
+
         if (samplesPerBuffer > 0)
         {
             Ensure(samplesPerBuffer);
         }
     }
 
-    const std::vector<T>& BufferDataConst() const
+    const AlignedVector<T>& BufferDataConst() const
     {
-        if (IsDebug && bufferData_.size() < DataLengthSamples())
+        if (IsDebug && channelStride_ < DataLengthSamples())
         {
             std::cout << "C: Something went wrong - data length samples in buffer is " << DataLengthSamples() << ", but allocated size is "
-                      << bufferData_.size() << std::endl;
+                      << channelStride_ << std::endl;
             std::cout << "Buffer address: " << (size_t) this << std::endl;
         }
 
         return bufferData_;
     }
 
-    std::vector<T>& BufferData()
+    AlignedVector<T>& BufferData()
     {
-        if (IsDebug && bufferData_.size() < DataLengthSamples())
+        if (IsDebug && channelStride_ < DataLengthSamples())
         {
             std::cout << "R: Something went wrong - data length samples in buffer is " << DataLengthSamples() << ", but allocated size is "
-                      << bufferData_.size() << std::endl;
+                      << channelStride_ << std::endl;
             std::cout << "Buffer address: " << (size_t) this << std::endl;
         }
 
         return bufferData_;
     }
 
+    size_t ChannelOffset(int channel) const { return channel * channelStride_; }
+
+    size_t ChannelStride() const { return channelStride_; }
+
+    T* ChannelData(int channel) { return BufferData().data() + ChannelOffset(channel); }
+
+    const T* ChannelDataConst(int channel) const { return BufferDataConst().data() + ChannelOffset(channel); }
+
+    // Makes room for desiredSize samples in every channel
     void Ensure(size_t desiredSize)
     {
-        if (bufferData_.size() < desiredSize)
+        if (channelStride_ < desiredSize)
         {
             try
             {
-                bufferData_.resize(desiredSize);
+                Reshape(channelsCount_, AlignedStride(desiredSize));
             }
             catch(const std::exception& e)
             {
@@ -78,77 +129,161 @@ public:
 
     int Channels() const { return channelsCount_; }
 
-    void Channels(int channelsCount) { channelsCount_ = channelsCount; }
+    void Channels(int channelsCount)
+    {
+        if (channelsCount != channelsCount_)
+        {
+            try
+            {
+                Reshape(channelsCount, channelStride_);
+            }
+            catch(const std::exception& e)
+            {
+                std::cerr << e.what() << '\n';
+            }
+        }
+    }
 
+    // Samples per channel
     size_t DataLengthSamples() const { return dataLengthSamples_; }
 
     void DataLengthSamples(size_t dataLengthSamples) { dataLengthSamples_ = dataLengthSamples; }
 
     float DataLengthSeconds() const
     {
-        if (SampleRate() < std::numeric_limits<float>::min() || Channels() < 1)
+        if (SampleRate() < std::numeric_limits<float>::min())
         {
             return 0;
         }
 
-        return static_cast<float>(DataLengthSamples() / SampleRate() / Channels());
+        return static_cast<float>(DataLengthSamples() / SampleRate());
     }
 
     void Copy(const SingleBuffer<T>& sourceBuffer)
     {
+        Channels(sourceBuffer.Channels());
+        Ensure(sourceBuffer.DataLengthSamples());
+
+        for (int channel = 0; channel < Channels(); channel++)
+        {
+            const T* sourceData = sourceBuffer.ChannelDataConst(channel);
+            std::copy(sourceData, sourceData + sourceBuffer.DataLengthSamples(), ChannelData(channel));
+        }
+
+        SampleRate(sourceBuffer.SampleRate());
+        DataLengthSamples(sourceBuffer.DataLengthSamples());
+    }
+
+    // Copy and gain in one pass
+    void Copy(const SingleBuffer<T>& sourceBuffer, float gain)
+    {
+        Channels(sourceBuffer.Channels());
         Ensure(sourceBuffer.DataLengthSamples());
 
-        const auto& sourceData = sourceBuffer.BufferDataConst();
+        for (int channel = 0; channel < Channels(); channel++)
+        {
+            CopySamples(ChannelData(channel), sourceBuffer.ChannelDataConst(channel), gain, sourceBuffer.DataLengthSamples());
+        }
 
-        std::copy(sourceData.cbegin(), sourceData.cbegin() + sourceBuffer.DataLengthSamples(), BufferData().begin());
+        SampleRate(sourceBuffer.SampleRate());
+        DataLengthSamples(sourceBuffer.DataLengthSamples());
+    }
 
+    // Copy from another sample type, through the normalized range
+    template<typename Source>
+    void CopyConverted(const SingleBuffer<Source>& sourceBuffer)
+    {
         Channels(sourceBuffer.Channels());
+        Ensure(sourceBuffer.DataLengthSamples());
+
+        for (int channel = 0; channel < Channels(); channel++)
+        {
+            ConvertSamples(ChannelData(channel), sourceBuffer.ChannelDataConst(channel), sourceBuffer.DataLengthSamples());
+        }
+
         SampleRate(sourceBuffer.SampleRate());
         DataLengthSamples(sourceBuffer.DataLengthSamples());
     }
 
+    // Takes interleaved samples, samplesCount covers all the channels
     void Copy(const T* sourceData, int samplesCount, float sampleRate = DefaultBufferSampleRate, int channelsCount = 1)
     {
-        bufferData_.clear();
-
-        std::copy(sourceData, sourceData + samplesCount, std::back_inserter(bufferData_));
+        size_t framesCount = samplesCount / channelsCount;
 
         Channels(channelsCount);
+        Ensure(framesCount);
+
+        for (int channel = 0; channel < channelsCount; channel++)
+        {
+            T* targetData = ChannelData(channel);
+
+            for (size_t n = 0; n < framesCount; n++)
+            {
+                targetData[n] = sourceData[n * channelsCount + channel];
+            }
+        }
+
         SampleRate(sampleRate);
-        DataLengthSamples(samplesCount);
+        DataLengthSamples(framesCount);
     }
 
-    void Mix(const SingleBuffer<T>& sourceBuffer)
+    // Places all the channels of the source starting from targetChannel, the buffer grows to fit them
+    void CopyChannels(const SingleBuffer<T>& sourceBuffer, int targetChannel)
     {
-        size_t samplesToMix = std::min(DataLengthSamples(), sourceBuffer.DataLengthSamples());
-
-        const auto& sourceData = sourceBuffer.BufferDataConst();
-        auto& targetData = BufferData();
+        Channels(std::max(Channels(), targetChannel + sourceBuffer.Channels()));
+        Ensure(sourceBuffer.DataLengthSamples());
 
-        for (size_t n = 0; n < samplesToMix; n++)
+        for (int channel = 0; channel < sourceBuffer.Channels(); channel++)
         {
-            targetData[n] += sourceData[n];
+            const T* sourceData = sourceBuffer.ChannelDataConst(channel);
+            std::copy(sourceData, sourceData + sourceBuffer.DataLengthSamples(), ChannelData(targetChannel + channel));
         }
+
+        SampleRate(sourceBuffer.SampleRate());
+        DataLengthSamples(sourceBuffer.DataLengthSamples());
     }
 
-    void Invert()
+    void CopyChannel(int channel, const T* sourceData, size_t samplesCount)
     {
-        auto& bufferSamples = BufferData();
+        Ensure(samplesCount);
 
-        for (size_t n = 0; n < DataLengthSamples(); n++)
+        std::copy(sourceData, sourceData + samplesCount, ChannelData(channel));
+    }
+
+    void Mix(const SingleBuffer<T>& sourceBuffer)
+    {
+        size_t samplesToMix = std::min(DataLengthSamples(), sourceBuffer.DataLengthSamples());
+        int channelsToMix = std::min(Channels(), sourceBuffer.Channels());
+
+        for (int channel = 0; channel < channelsToMix; channel++)
         {
-            bufferSamples[n] = -bufferSamples[n];
+            MixSamples(ChannelData(channel), sourceBuffer.ChannelDataConst(channel), samplesToMix);
         }
     }
 
     void Amplify(float gain)
     {
-        auto& samplesToAdjust = BufferData();
+        for (int channel = 0; channel < Channels(); channel++)
+        {
+            AmplifySamples(ChannelData(channel), gain, DataLengthSamples());
+        }
+    }
+
+    // Gain moves linearly from initialGain on the first sample towards finalGain, reached right after the last one
+    void Amplify(float initialGain, float finalGain)
+    {
         size_t samplesCount = DataLengthSamples();
 
-        for (size_t n = 0; n < samplesCount; n++)
+        if (samplesCount == 0)
+        {
+            return;
+        }
+
+        float gainStep = (finalGain - initialGain) / samplesCount;
+
+        for (int channel = 0; channel < Channels(); channel++)
         {
-            samplesToAdjust[n] *= gain;
+            RampSamples(ChannelData(channel), initialGain, gainStep, samplesCount);
         }
     }
 };
@@ -1,6 +1,6 @@
 #pragma once
 
-#include <iostream>
+#include <algorithm>
 #include <vector>
 
 namespace dePhonica {
@@ -17,6 +17,9 @@ private:
 
     bool isCanGrow_;
 
+    size_t overflowsCount_;
+
+    // Allocates, growing buffers are sized to never get here while processing
     void UpsizeBuffer(int newSize = -1)
     {
         size_t newBufferSize = newSize > 0 ? newSize : storeBuffer_.size() * 2;
@@ -31,16 +34,16 @@ private:
             amountOfData = newBufferSize;
         }
 
-        Pop(newBuffer, 0, amountOfData);
+        Pop(newBuffer.data(), amountOfData);
 
-        storeBuffer_.assign(newBuffer.begin(), newBuffer.end());
+        storeBuffer_.swap(newBuffer);
 
         positionLow_ = 0;
         positionHigh_ = amountOfData;
         dataStored_ = amountOfData;
     }
 
-    void PopInternal(std::vector<T>& buffer, int offset, int length, bool purge)
+    void PopInternal(T* buffer, size_t length, bool purge)
     {
         size_t copyLength = length;
         size_t remainingLength = 0;
@@ -57,7 +60,7 @@ private:
         {
             if (purge == false)
             {
-                std::copy(storeBuffer_.begin() + positionLow_, storeBuffer_.begin() + positionLow_ + copyLength, buffer.begin() + offset);
+                std::copy(storeBuffer_.begin() + positionLow_, storeBuffer_.begin() + positionLow_ + copyLength, buffer);
             }
 
             positionLow_ += copyLength;
@@ -68,15 +71,13 @@ private:
 
             if (purge == false)
             {
-                std::copy(storeBuffer_.begin() + positionLow_,
-                          storeBuffer_.begin() + positionLow_ + firstChunkLength,
-                          buffer.begin() + offset);
+                std::copy(storeBuffer_.begin() + positionLow_, storeBuffer_.begin() + positionLow_ + firstChunkLength, buffer);
             }
 
             size_t secondChunkLength = copyLength - firstChunkLength;
             if (purge == false)
             {
-                std::copy(storeBuffer_.begin(), storeBuffer_.begin() + secondChunkLength, buffer.begin() + offset + firstChunkLength);
+                std::copy(storeBuffer_.begin(), storeBuffer_.begin() + secondChunkLength, buffer + firstChunkLength);
             }
 
             positionLow_ = secondChunkLength;
@@ -84,10 +85,7 @@ private:
 
         if (remainingLength > 0 && purge == false)
         {
-            for (size_t n = 0, targetIndex = offset + copyLength; n < remainingLength; n++, targetIndex++)
-            {
-                buffer[targetIndex] = T();
-            }
+            std::fill(buffer + copyLength, buffer + length, T());
         }
 
         dataStored_ -= copyLength;
@@ -97,6 +95,7 @@ public:
     SlidingBuffer(size_t bufferSize = InitialSlidingBufferSize, bool isCanGrow = false)
         : storeBuffer_(bufferSize)
         , isCanGrow_(isCanGrow)
+        , overflowsCount_(0)
     {
         Flush();
     }
@@ -107,7 +106,9 @@ public:
         dataStored_ = 0;
     }
 
-    void Push(const std::vector<T>& buffer, int offset, size_t length)
+    void Push(const std::vector<T>& buffer, int offset, size_t length) { Push(buffer.data() + offset, length); }
+
+    void Push(const T* buffer, size_t length)
     {
         if (length > storeBuffer_.size())
         {
@@ -117,7 +118,8 @@ public:
             }
             else
             {
-                std::cerr << "Sliding buffer push overflow";
+                // Counted rather than reported, as pushes run on the audio thread
+                overflowsCount_++;
                 return;
             }
         }
@@ -144,18 +146,16 @@ public:
 
         if (storeTop - positionHigh_ >= length)
         {
-            std::copy(buffer.cbegin() + offset, buffer.cbegin() + offset + length, storeBuffer_.begin() + positionHigh_);
+            std::copy(buffer, buffer + length, storeBuffer_.begin() + positionHigh_);
             positionHigh_ += length;
         }
         else
         {
             size_t firstChunkLength = storeTop - positionHigh_;
-            std::copy(buffer.cbegin() + offset, buffer.cbegin() + offset + firstChunkLength, storeBuffer_.begin() + positionHigh_);
+            std::copy(buffer, buffer + firstChunkLength, storeBuffer_.begin() + positionHigh_);
 
             size_t secondChunkLength = length - firstChunkLength;
-            std::copy(buffer.cbegin() + offset + firstChunkLength,
-                      buffer.cbegin() + offset + firstChunkLength + secondChunkLength,
-                      storeBuffer_.begin());
+            std::copy(buffer + firstChunkLength, buffer + firstChunkLength + secondChunkLength, storeBuffer_.begin());
 
             positionHigh_ = secondChunkLength;
         }
@@ -163,17 +163,17 @@ public:
         dataStored_ += length;
     }
 
-    void Pop(std::vector<T>& buffer, int offset, int length) { PopInternal(buffer, offset, length, false); }
+    void Pop(std::vector<T>& buffer, int offset, int length) { PopInternal(buffer.data() + offset, length, false); }
 
-    void Purge(int samplesCount)
-    {
-        std::vector<T> nullVector;
-        PopInternal(nullVector, 0, samplesCount, true);
-    }
+    void Pop(T* buffer, size_t length) { PopInternal(buffer, length, false); }
+
+    void Purge(int samplesCount) { PopInternal(nullptr, samplesCount, true); }
 
     size_t FreeSpace() const { return storeBuffer_.size() - dataStored_; }
 
     size_t DataLengthSamples() const { return dataStored_; }
+
+    size_t OverflowsCount() const { return overflowsCount_; }
 };
 
 } // namespace Buffers
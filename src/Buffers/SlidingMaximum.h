@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace dePhonica {
+namespace Buffers {
+
+// Fixed size window of the latest values with O(1) maximum queries.
+// Keeps a monotonic queue of the indices that can still become the maximum, no allocations after construction.
+template<typename T>
+class SlidingMaximum
+{
+private:
+    std::vector<T> values_;
+    std::vector<size_t> candidates_;
+
+    size_t capacity_;
+
+    // Absolute indices, the window is [firstIndex_, nextIndex_)
+    size_t firstIndex_, nextIndex_;
+
+    // Candidate values decrease from front to back
+    size_t candidatesFront_, candidatesCount_;
+
+    T& ValueAt(size_t index) { return values_[index % capacity_]; }
+    const T& ValueAt(size_t index) const { return values_[index % capacity_]; }
+
+    size_t& CandidateAt(size_t position) { return candidates_[(candidatesFront_ + position) % capacity_]; }
+    size_t CandidateAt(size_t position) const { return candidates_[(candidatesFront_ + position) % capacity_]; }
+
+    void PushCandidate(size_t index)
+    {
+        const T& value = ValueAt(index);
+
+        while (candidatesCount_ > 0 && ValueAt(CandidateAt(candidatesCount_ - 1)) <= value)
+        {
+            candidatesCount_--;
+        }
+
+        CandidateAt(candidatesCount_) = index;
+        candidatesCount_++;
+    }
+
+public:
+    explicit SlidingMaximum(size_t capacity = 1)
+        : values_(capacity > 0 ? capacity : 1)
+        , candidates_(values_.size())
+        , capacity_(values_.size())
+        , firstIndex_(0)
+        , nextIndex_(0)
+        , candidatesFront_(0)
+        , candidatesCount_(0)
+    {
+    }
+
+    size_t Capacity() const { return capacity_; }
+    size_t Size() const { return nextIndex_ - firstIndex_; }
+    bool IsEmpty() const { return nextIndex_ == firstIndex_; }
+
+    // Appends a value, dropping the oldest one when the window is full
+    void Push(T value)
+    {
+        if (Size() == capacity_)
+        {
+            if (CandidateAt(0) == firstIndex_)
+            {
+                candidatesFront_ = (candidatesFront_ + 1) % capacity_;
+                candidatesCount_--;
+            }
+
+            firstIndex_++;
+        }
+
+        ValueAt(nextIndex_) = value;
+        PushCandidate(nextIndex_);
+
+        nextIndex_++;
+    }
+
+    // Raises the latest value, lower values are ignored; the window must not be empty
+    void RaiseLast(T value)
+    {
+        size_t lastIndex = nextIndex_ - 1;
+
+        if (value <= ValueAt(lastIndex))
+        {
+            return;
+        }
+
+        ValueAt(lastIndex) = value;
+        PushCandidate(lastIndex);
+    }
+
+    T Last() const { return ValueAt(nextIndex_ - 1); }
+
+    // Largest value of the window; the window must not be empty
+    T Maximum() const { return ValueAt(CandidateAt(0)); }
+
+    void Clear()
+    {
+        firstIndex_ = nextIndex_ = 0;
+        candidatesFront_ = candidatesCount_ = 0;
+    }
+};
+
+} // namespace Buffers
+} // namespace dePhonica
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "SingleBuffer.h"
+#include "SlidingBuffer.h"
+
+namespace dePhonica {
+namespace Buffers {
+
+// Lines up several streams by sample index when they deliver blocks of different lengths,
+// e.g. a branch with FIR pre-buffering next to a branch without it
+template<typename T>
+class StreamAligner
+{
+private:
+    // Per stream, per channel
+    std::vector<std::vector<SlidingBuffer<T>>> backlogs_;
+
+public:
+    StreamAligner(size_t streamsCount, int channelsCount)
+    {
+        backlogs_.resize(streamsCount);
+
+        for (auto& streamBacklogs : backlogs_)
+        {
+            for (int channel = 0; channel < channelsCount; channel++)
+            {
+                streamBacklogs.emplace_back(InitialSlidingBufferSize, true);
+            }
+        }
+    }
+
+    bool IsEmpty() const
+    {
+        for (const auto& streamBacklogs : backlogs_)
+        {
+            if (streamBacklogs.size() > 0 && streamBacklogs[0].DataLengthSamples() > 0)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void Push(size_t stream, const SingleBuffer<T>& buffer)
+    {
+        auto& streamBacklogs = backlogs_[stream];
+        int channelsCount = std::min(buffer.Channels(), static_cast<int>(streamBacklogs.size()));
+
+        for (int channel = 0; channel < channelsCount; channel++)
+        {
+            streamBacklogs[channel].Push(buffer.ChannelDataConst(channel), buffer.DataLengthSamples());
+        }
+    }
+
+    // Samples available in every stream
+    size_t AvailableSamples() const
+    {
+        size_t availableSamples = 0;
+        bool isFirstStream = true;
+
+        for (const auto& streamBacklogs : backlogs_)
+        {
+            size_t streamSamples = streamBacklogs.size() > 0 ? streamBacklogs[0].DataLengthSamples() : 0;
+
+            availableSamples = isFirstStream ? streamSamples : std::min(availableSamples, streamSamples);
+            isFirstStream = false;
+        }
+
+        return availableSamples;
+    }
+
+    // Writes the stream channels into the target starting from targetChannel, the target must already hold enough channels
+    void Pop(size_t stream, SingleBuffer<T>& target, int targetChannel, size_t samplesCount)
+    {
+        auto& streamBacklogs = backlogs_[stream];
+
+        target.Ensure(samplesCount);
+
+        for (size_t channel = 0; channel < streamBacklogs.size(); channel++)
+        {
+            streamBacklogs[channel].Pop(target.ChannelData(targetChannel + channel), samplesCount);
+        }
+    }
+
+    void Flush()
+    {
+        for (auto& streamBacklogs : backlogs_)
+        {
+            for (auto& backlog : streamBacklogs)
+            {
+                backlog.Flush();
+            }
+        }
+    }
+};
+
+} // namespace Buffers
+} // namespace dePhonica
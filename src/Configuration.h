@@ -7,7 +7,19 @@
 
 namespace dePhonica
 {
-    static bool IsDebug = true;
+    // Consistency checks, compiled out of release builds
+#ifdef NDEBUG
+    constexpr bool IsDebug = false;
+#else
+    constexpr bool IsDebug = true;
+#endif
+
+    // Per-stage timing of Pipeline::Push, build with -DPIPELINE_STAGE_COUNTERS to compile it in
+#ifdef PIPELINE_STAGE_COUNTERS
+    constexpr bool IsStageCounted = true;
+#else
+    constexpr bool IsStageCounted = false;
+#endif
 }
 
 #pragma GCC diagnostic pop
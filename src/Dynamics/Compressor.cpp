@@ -2,14 +2,16 @@
 #include "LogConversions.h"
 
 #include <algorithm>
+#include <cstring>
 #include <stdio.h>
 
 namespace dePhonica {
 namespace Dynamics {
 
-Compressor::Compressor(unsigned sampleRate, const CompressorDescription& compressorDescription)
+template<typename T>
+Compressor<T>::Compressor(unsigned sampleRate, int channelsCount, const CompressorDescription& compressorDescription)
     : compressorDescription_(compressorDescription)
-    , linearSlope_(0.0)
+    , linearSlopes_(channelsCount, 0.0)
     , attackCoefficient_(MACROMIN(1.0, 1.0 / (compressorDescription_.AttackMilliseconds * sampleRate / 4000.0)))
     , releaseCoefficient_(MACROMIN(1.0, 1.0 / (compressorDescription_.ReleaseMilliseconds * sampleRate / 4000.0)))
     , threshold_(Math::LogConversions::DecibelsToValue(compressorDescription.ThresholdDb))
@@ -23,7 +25,12 @@ Compressor::Compressor(unsigned sampleRate, const CompressorDescription& compres
     , compressedKneeStop((kneeStop_ - threshold_) / compressorDescription.Ratio + threshold_)
     , makeupGain_(Math::LogConversions::DecibelsToValue(compressorDescription.MakeupGainDb))
     , sideChainGain_(Math::LogConversions::DecibelsToValue(compressorDescription.SideChainGainDb))
+    , minimumGain_(1.0)
+    , maximumGain_(1.0)
+    , graphStartBits_(0)
+    , graphPointShift_(0)
 {
+    InitCompressionGraph();
 }
 
 // A fake infinity value (because real infinity may break some hosts)
@@ -98,81 +105,204 @@ static double CalculateOutputGain(double linearSlope,
     return exp(gain - slope);
 }
 
-void Compressor::ApplyCompression(const Buffers::SingleBuffer<PCMTYPE>& inputBuffer, Buffers::SingleBuffer<PCMTYPE>& outputBuffer)
+static inline uint32_t FloatBits(float value)
 {
-    const size_t inputSamplesCount = inputBuffer.DataLengthSamples();
-    const int sourceChannelCount = inputBuffer.Channels();
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
 
-    const bool isMaxChannelSample = compressorDescription_.AreSidechainChannelsAveraged == false;
+    return bits;
+}
+
+static inline float BitsFloat(uint32_t bits)
+{
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+
+    return value;
+}
+
+template<typename T>
+double Compressor<T>::CurveGain(double linearSlope) const
+{
+    return CalculateOutputGain(linearSlope,
+                               compressorDescription_.Ratio,
+                               threshold_,
+                               compressorDescription_.Knee,
+                               kneeStart_,
+                               kneeStop_,
+                               compressedKneeStart_,
+                               compressedKneeStop,
+                               compressorDescription_.IsRmsDetector,
+                               compressorDescription_.IsUpward);
+}
+
+template<typename T>
+void Compressor<T>::InitCompressionGraph()
+{
+    const bool isRmsDetector = compressorDescription_.IsRmsDetector;
+
+    // The RMS detector runs on squared samples, an octave of amplitude is two of its octaves
+    const int mantissaBits = 23;
+    const int octavePoints = isRmsDetector ? COMPRESSION_GRAPH_OCTAVE_POINTS / 2 : COMPRESSION_GRAPH_OCTAVE_POINTS;
+
+    graphPointShift_ = mantissaBits;
+
+    for (int points = octavePoints; points > 1; points /= 2)
+    {
+        graphPointShift_--;
+    }
+
+    double startAmplitude = Math::LogConversions::DecibelsToValue(COMPRESSION_GRAPH_MIN);
+    double startSlope = isRmsDetector ? startAmplitude * startAmplitude : startAmplitude;
+
+    // Starts on a point of the grid below the graph minimum
+    graphStartBits_ = FloatBits(static_cast<float>(startSlope)) >> graphPointShift_ << graphPointShift_;
+
+    compressionGraph_.resize(COMPRESSION_GRAPH_POINTS);
+
+    for (size_t index = 0; index < compressionGraph_.size(); index++)
+    {
+        double slope = BitsFloat(graphStartBits_ + (static_cast<uint32_t>(index) << graphPointShift_));
+        double gain = CurveGain(slope);
+
+        auto& graphPoint = compressionGraph_[index];
+        graphPoint.StartXDb = static_cast<float>(isRmsDetector ? 10 * std::log10(slope) : 20 * std::log10(slope));
+        graphPoint.StartYDb = static_cast<float>(graphPoint.StartXDb + 20 * std::log10(gain));
+        graphPoint.Gain = static_cast<float>(gain);
+    }
+}
+
+template<typename T>
+double Compressor<T>::GraphGain(double linearSlope) const
+{
+    uint32_t offset = FloatBits(static_cast<float>(linearSlope)) - graphStartBits_;
+    size_t index = offset >> graphPointShift_;
+
+    // Below the graph the offset wraps around and is caught here as well
+    if (index >= COMPRESSION_GRAPH_POINTS - 1)
+    {
+        return CurveGain(linearSlope);
+    }
+
+    // Linear in the mantissa, so linear in the detector value between two points
+    double fraction = (offset & ((1u << graphPointShift_) - 1)) * (1.0 / (1u << graphPointShift_));
+
+    const auto& graphPoint = compressionGraph_[index];
+
+    return graphPoint.Gain + (compressionGraph_[index + 1].Gain - graphPoint.Gain) * fraction;
+}
+
+template<typename T>
+double Compressor<T>::DetectGain(double& linearSlope, double detectedSample) const
+{
     const bool isRmsDetector = compressorDescription_.IsRmsDetector;
     const bool isUpward = compressorDescription_.IsUpward;
 
     const double kneeStartLinear = isRmsDetector ? adjustedKneeStart_ : linearKneeStart_;
     const double kneeStopLinear = isRmsDetector ? adjustedKneeStop_ : linearKneeStop_;
 
-    const float ratio = compressorDescription_.Ratio;
-    const float knee = compressorDescription_.Knee;
+    if (isRmsDetector)
+    {
+        detectedSample *= detectedSample;
+    }
+
+    linearSlope += (detectedSample - linearSlope) * (detectedSample > linearSlope ? attackCoefficient_ : releaseCoefficient_);
+
+    bool detected = isUpward ? linearSlope < kneeStopLinear : linearSlope > kneeStartLinear;
+
+    return (linearSlope > 0.0 && detected) ? GraphGain(linearSlope) : 1.0;
+}
+
+template<typename T>
+void Compressor<T>::ApplyLinkedCompression(const Buffers::SingleBuffer<T>& inputBuffer, Buffers::SingleBuffer<T>& outputBuffer)
+{
+    const size_t inputSamplesCount = inputBuffer.DataLengthSamples();
+    const int sourceChannelCount = inputBuffer.Channels();
+
+    const bool isMaxChannelSample = compressorDescription_.AreSidechainChannelsAveraged == false;
+
+    const size_t sourceStride = inputBuffer.ChannelStride();
+    const size_t targetStride = outputBuffer.ChannelStride();
 
     auto& sourceSamples = inputBuffer.BufferDataConst();
     auto& targetSamples = outputBuffer.BufferData();
 
-    size_t samplePointer = 0;
-
     for (size_t iz = 0; iz < inputSamplesCount; iz++)
     {
-        double abs_sample = std::fabs(sourceSamples[samplePointer] * sideChainGain_);
+        double abs_sample = std::fabs(Buffers::SampleTraits<T>::Normalized(sourceSamples[iz]) * sideChainGain_);
 
         if (isMaxChannelSample)
         {
             for (int c = 1; c < sourceChannelCount; c++)
             {
-                abs_sample = MACROMAX(std::fabs(sourceSamples[samplePointer + c] * sideChainGain_), abs_sample);
+                abs_sample = MACROMAX(std::fabs(Buffers::SampleTraits<T>::Normalized(sourceSamples[c * sourceStride + iz]) * sideChainGain_), abs_sample);
             }
         }
         else
         {
             for (int c = 1; c < sourceChannelCount; c++)
             {
-                abs_sample += std::fabs(sourceSamples[samplePointer + c] * sideChainGain_);
+                abs_sample += std::fabs(Buffers::SampleTraits<T>::Normalized(sourceSamples[c * sourceStride + iz]) * sideChainGain_);
             }
 
             abs_sample /= sourceChannelCount;
         }
 
-        if (isRmsDetector)
+        double gain = DetectGain(linearSlopes_[0], abs_sample);
+
+        minimumGain_ = MACROMIN(gain, minimumGain_);
+        maximumGain_ = MACROMAX(gain, maximumGain_);
+
+        for (int c = 0; c < sourceChannelCount; c++)
         {
-            abs_sample *= abs_sample;
+            targetSamples[c * targetStride + iz] = Buffers::SampleTraits<T>::FromDouble(sourceSamples[c * sourceStride + iz] * gain * makeupGain_);
         }
+    }
+}
 
-        linearSlope_ += (abs_sample - linearSlope_) * (abs_sample > linearSlope_ ? attackCoefficient_ : releaseCoefficient_);
+template<typename T>
+void Compressor<T>::ApplyCompression(const Buffers::SingleBuffer<T>& inputBuffer, Buffers::SingleBuffer<T>& outputBuffer)
+{
+    const size_t inputSamplesCount = inputBuffer.DataLengthSamples();
+    const int sourceChannelCount = std::min(inputBuffer.Channels(), static_cast<int>(linearSlopes_.size()));
 
-        bool detected = isUpward ? linearSlope_ < kneeStopLinear : linearSlope_ > kneeStartLinear;
+    for (int c = 0; c < sourceChannelCount; c++)
+    {
+        const T* sourceSamples = inputBuffer.ChannelDataConst(c);
+        T* targetSamples = outputBuffer.ChannelData(c);
 
-        double gain = (linearSlope_ > 0.0 && detected) ? CalculateOutputGain(linearSlope_,
-                                                                             ratio,
-                                                                             threshold_,
-                                                                             knee,
-                                                                             kneeStart_,
-                                                                             kneeStop_,
-                                                                             compressedKneeStart_,
-                                                                             compressedKneeStop,
-                                                                             isRmsDetector,
-                                                                             isUpward)
-                                                       : 1.0;
+        double& linearSlope = linearSlopes_[c];
 
-        for (int c = 0; c < sourceChannelCount; c++)
+        for (size_t iz = 0; iz < inputSamplesCount; iz++)
         {
-            targetSamples[samplePointer + c] = sourceSamples[samplePointer + c] * gain * makeupGain_;
-        }
+            double gain = DetectGain(linearSlope, std::fabs(Buffers::SampleTraits<T>::Normalized(sourceSamples[iz]) * sideChainGain_));
 
-        samplePointer += sourceChannelCount;
+            minimumGain_ = MACROMIN(gain, minimumGain_);
+            maximumGain_ = MACROMAX(gain, maximumGain_);
+
+            targetSamples[iz] = Buffers::SampleTraits<T>::FromDouble(sourceSamples[iz] * gain * makeupGain_);
+        }
     }
 }
 
-void Compressor::Apply(Buffers::SingleBuffer<PCMTYPE>& inputBuffer)
+template<typename T>
+void Compressor<T>::Apply(Buffers::SingleBuffer<T>& inputBuffer)
 {
-    ApplyCompression(inputBuffer, inputBuffer);
+    minimumGain_ = maximumGain_ = 1.0;
+
+    if (compressorDescription_.AreChannelsLinked || inputBuffer.Channels() == 1)
+    {
+        ApplyLinkedCompression(inputBuffer, inputBuffer);
+    }
+    else
+    {
+        ApplyCompression(inputBuffer, inputBuffer);
+    }
 }
 
+template class Compressor<float>;
+template class Compressor<double>;
+template class Compressor<int32_t>;
+
 } // namespace Dynamics
 } // namespace dePhonica
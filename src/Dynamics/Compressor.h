@@ -1,16 +1,23 @@
 #pragma once
 
+#include <cstdint>
+#include <vector>
+
 #include "Buffers/SingleBuffer.h"
 #include "CompressorDescription.h"
+#include "LogConversions.h"
 #include "Configuration.h"
 
 #define COMPRESSION_GRAPH_POINTS        8193
 #define COMPRESSION_GRAPH_MIN           (-100.0)
+// Graph points per octave of the detected amplitude, the graph spans COMPRESSION_GRAPH_POINTS / this octaves
+#define COMPRESSION_GRAPH_OCTAVE_POINTS 256
 #define ATTACK_RELEASE_CONST_DB         10.0
 
 namespace dePhonica {
 namespace Dynamics {
 
+// Detected level and compressed level of a static curve point, Gain is the linear ratio of the two
 struct CompressionGraphPoint
 {
     float StartXDb, StartYDb;
@@ -20,12 +27,14 @@ struct CompressionGraphPoint
 #define MACROMAX(a,b) ((a) > (b) ? (a) : (b))
 #define MACROMIN(a,b) ((a) > (b) ? (b) : (a))
 
+// Instantiated for float, double and int32_t samples, detection and thresholds work on the normalized level
+template<typename T>
 class Compressor
 {
 private:
     const CompressorDescription compressorDescription_;
 
-    double linearSlope_;
+    std::vector<double> linearSlopes_;
     double attackCoefficient_, releaseCoefficient_;
 
     double threshold_;
@@ -36,19 +45,47 @@ private:
 
     float makeupGain_, sideChainGain_;
 
-    Buffers::SingleBuffer<PCMTYPE> processingBuffer_, gainBuffer_;
+    // Extremes of the detected gain over the last block, for metering
+    double minimumGain_, maximumGain_;
+
+    // Static curve sampled at detector values whose float representations are evenly spaced, exponent and mantissa
+    // being a piecewise linear log2 the lookup needs neither log nor exp. Values off the graph take the exact curve.
+    std::vector<CompressionGraphPoint> compressionGraph_;
+    uint32_t graphStartBits_;
+    int graphPointShift_;
+
+    Buffers::SingleBuffer<T> processingBuffer_, gainBuffer_;
+
+    void InitCompressionGraph();
+
+    double CurveGain(double linearSlope) const;
+    double GraphGain(double linearSlope) const;
+
+    double DetectGain(double& linearSlope, double detectedSample) const;
 
-    void ApplyCompression(const Buffers::SingleBuffer<PCMTYPE>& inputBuffer, Buffers::SingleBuffer<PCMTYPE>& outputBuffer);
+    void ApplyLinkedCompression(const Buffers::SingleBuffer<T>& inputBuffer, Buffers::SingleBuffer<T>& outputBuffer);
+    void ApplyCompression(const Buffers::SingleBuffer<T>& inputBuffer, Buffers::SingleBuffer<T>& outputBuffer);
 
 public:
-    Compressor(unsigned sampleRate, const CompressorDescription& compressorDescription);
+    Compressor(unsigned sampleRate, int channelsCount, const CompressorDescription& compressorDescription);
 
-    void Apply(Buffers::SingleBuffer<PCMTYPE>& inputBuffer);
+    void Apply(Buffers::SingleBuffer<T>& inputBuffer);
+
+    // Gain furthest from unity applied over the last block, without makeup gain
+    double BlockGainDb() const
+    {
+        double minimumGainDb = Math::LogConversions::ValueToDecibels(minimumGain_);
+        double maximumGainDb = Math::LogConversions::ValueToDecibels(maximumGain_);
+
+        return -minimumGainDb > maximumGainDb ? minimumGainDb : maximumGainDb;
+    }
 
     void Flush() 
     {
         processingBuffer_.DataLengthSamples(0);
-        linearSlope_ = 0.0;
+        std::fill(linearSlopes_.begin(), linearSlopes_.end(), 0.0);
+
+        minimumGain_ = maximumGain_ = 1.0;
     }
 };
 
@@ -21,6 +21,8 @@ struct CompressorDescription
     bool IsUpward;
     bool IsRmsDetector;
     bool AreSidechainChannelsAveraged;
+    // Linked channels share one detector and gain, otherwise every channel is compressed on its own
+    bool AreChannelsLinked = true;
 
     float AttackMilliseconds;
     float ReleaseMilliseconds;
@@ -2,16 +2,23 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <mutex>
 
 namespace dePhonica {
 namespace Fir {
 
+// Only plan execution is thread safe in FFTW, engines created or destroyed on several threads at once
+// (parallel instantiate, batch rendering) have to take turns
+static std::mutex FftwPlannerMutex;
+
 FftEngine::FftEngine(size_t fftSize)
     : cpuRealBuffer_(fftSize)
     , cpuComplexBuffer_(fftSize / 2 + 1)
     , convolutionBuffer_(fftSize / 2 + 1)
     , convolutionKernel_(fftSize)
 {
+    std::lock_guard<std::mutex> plannerLock(FftwPlannerMutex);
+
 	planForwardCpu_ = fftwf_plan_dft_r2c_1d(fftSize, cpuRealBuffer_.data(),
 							cpuComplexBuffer_.data(), FFTW_ESTIMATE | FFTW_PATIENT);
     planBackwardCpu_ = fftwf_plan_dft_c2r_1d(fftSize, cpuComplexBuffer_.data(),
@@ -20,6 +27,8 @@ FftEngine::FftEngine(size_t fftSize)
 
 FftEngine::~FftEngine()
 {
+    std::lock_guard<std::mutex> plannerLock(FftwPlannerMutex);
+
     fftwf_destroy_plan(planForwardCpu_);
     fftwf_destroy_plan(planBackwardCpu_);
 }
@@ -5,14 +5,14 @@
 namespace dePhonica {
 namespace Fir {
 
-FirBlockConvolver::FirBlockConvolver(const FirKernelSource& kernelSource)
+FirBlockConvolver::FirBlockConvolver(const FirKernelSource& kernelSource, int channelsCount)
     : taps_(kernelSource.GetTaps())
     , chunkSize_(taps_)
     , fftSize_(KernelConverter::GetDesiredSizeOfFft(taps_, chunkSize_))
     , fftEngine_(fftSize_)
     , storingBuffer_(fftSize_)
-    , processingBuffer_(fftSize_)
-    , isFirstRun_(true)
+    , processingBuffers_(channelsCount, std::vector<PCMTYPE>(fftSize_))
+    , isFirstRun_(channelsCount, true)
 {
     Flush();
 
@@ -33,28 +33,36 @@ FirBlockConvolver::FirBlockConvolver(const FirKernelSource& kernelSource)
 
 void FirBlockConvolver::Flush()
 {
-    isFirstRun_ = true;
+    std::fill(isFirstRun_.begin(), isFirstRun_.end(), true);
 
     std::fill(storingBuffer_.begin(), storingBuffer_.end(), 0);
-    std::fill(processingBuffer_.begin(), processingBuffer_.end(), 0);
+
+    for (auto& processingBuffer : processingBuffers_)
+    {
+        std::fill(processingBuffer.begin(), processingBuffer.end(), 0);
+    }
 }
 
-size_t FirBlockConvolver::Convolve(const std::vector<PCMTYPE>& inputBuffer, std::vector<PCMTYPE>& outputBuffer, float gain)
+size_t FirBlockConvolver::Convolve(int channel, const std::vector<PCMTYPE>& inputBuffer, std::vector<PCMTYPE>& outputBuffer, float gain)
 {
-    std::copy(processingBuffer_.begin() + chunkSize_, processingBuffer_.end(), processingBuffer_.begin());
-    std::copy(inputBuffer.begin(), inputBuffer.end(), processingBuffer_.begin() + chunkSize_);
+    auto& processingBuffer = processingBuffers_[channel];
+
+    std::copy(processingBuffer.begin() + chunkSize_, processingBuffer.end(), processingBuffer.begin());
+    std::copy(inputBuffer.begin(), inputBuffer.end(), processingBuffer.begin() + chunkSize_);
+
+    fftEngine_.ExecuteConvolution(processingBuffer, storingBuffer_);
 
-    fftEngine_.ExecuteConvolution(processingBuffer_, storingBuffer_);
+    bool isFirstRun = isFirstRun_[channel];
 
-    size_t filteredLength = isFirstRun_ ? chunkSize_ / 2 : chunkSize_;
-    size_t sourcePointer = taps_ - 1 + (isFirstRun_ ? chunkSize_ / 2 : 0);
+    size_t filteredLength = isFirstRun ? chunkSize_ / 2 : chunkSize_;
+    size_t sourcePointer = taps_ - 1 + (isFirstRun ? chunkSize_ / 2 : 0);
 
     for (size_t targetPointer = 0; targetPointer < filteredLength; targetPointer++, sourcePointer++)
     {
         outputBuffer[targetPointer] = storingBuffer_[sourcePointer] * gain;
     }
 
-    isFirstRun_ = false;
+    isFirstRun_[channel] = false;
     return filteredLength;
 }
 
@@ -15,17 +15,19 @@ class FirBlockConvolver
 private:
     size_t taps_, chunkSize_, fftSize_;
 
+    // Kernel and FFT plans are shared by all the channels, only the overlap history is per channel
     FftEngine fftEngine_;
 
-    std::vector<PCMTYPE> storingBuffer_, processingBuffer_;
+    std::vector<PCMTYPE> storingBuffer_;
+    std::vector<std::vector<PCMTYPE>> processingBuffers_;
 
-    bool isFirstRun_;
+    std::vector<bool> isFirstRun_;
 
 public:
-    explicit FirBlockConvolver(const FirKernelSource& kernelSource);
+    FirBlockConvolver(const FirKernelSource& kernelSource, int channelsCount = 1);
 
     void Flush();
-    size_t Convolve(const std::vector<PCMTYPE>& inputBuffer, std::vector<PCMTYPE>& outputBuffer, float gain);
+    size_t Convolve(int channel, const std::vector<PCMTYPE>& inputBuffer, std::vector<PCMTYPE>& outputBuffer, float gain);
 
     size_t ChunkSize() const
     {
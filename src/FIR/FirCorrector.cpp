@@ -4,26 +4,36 @@
 namespace dePhonica {
 namespace Fir {
 
-FirCorrector::FirCorrector(unsigned sampleRate, const std::vector<EnvelopePoint>& filterEnvelope, float gain, size_t initialSamplesBuffered)
-    : streamConvolver_(FirKernelSource(sampleRate, filterEnvelope), initialSamplesBuffered)
+FirCorrector::FirCorrector(unsigned sampleRate, int channelsCount, const std::vector<EnvelopePoint>& filterEnvelope, float gain,
+    size_t initialSamplesBuffered)
+    : streamConvolver_(FirKernelSource(sampleRate, filterEnvelope), initialSamplesBuffered, channelsCount)
     , gain_(gain)
     , isDisabled_(filterEnvelope.size() < 1)
 {
 }
 
-void FirCorrector::Push(const Buffers::SingleBuffer<PCMTYPE>& inputBuffer)
+void FirCorrector::Process(const Buffers::SingleBuffer<PCMTYPE>& inputBuffer, Buffers::SingleBuffer<PCMTYPE>& outputBuffer)
 {
     if (isDisabled_)
     {
-        outputBuffer_.Copy(inputBuffer);
-        outputBuffer_.Amplify(gain_);
+        if (&outputBuffer != &inputBuffer)
+        {
+            outputBuffer.Copy(inputBuffer, gain_);
+        }
+        else
+        {
+            outputBuffer.Amplify(gain_);
+        }
+
         return;
     }
 
-    outputBuffer_.Ensure(inputBuffer.DataLengthSamples());
+    outputBuffer.Channels(inputBuffer.Channels());
+    outputBuffer.Ensure(inputBuffer.DataLengthSamples());
+    outputBuffer.SampleRate(inputBuffer.SampleRate());
 
-    outputBuffer_.DataLengthSamples(
-        streamConvolver_.Convolve(inputBuffer.BufferDataConst(), outputBuffer_.BufferData(), inputBuffer.DataLengthSamples(), gain_));
+    // The stream convolver takes all the input before writing any output, so processing in place is safe
+    outputBuffer.DataLengthSamples(streamConvolver_.Convolve(inputBuffer, outputBuffer, gain_));
 }
 
 } // namespace Fir
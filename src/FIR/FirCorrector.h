@@ -14,8 +14,6 @@ namespace Fir {
 class FirCorrector
 {
 private:
-    Buffers::SingleBuffer<PCMTYPE> outputBuffer_;
-
     FirStreamConvolver streamConvolver_;
 
     float gain_;
@@ -23,15 +21,11 @@ private:
     bool isDisabled_;
 
 public:
-    FirCorrector(unsigned sampleRate, const std::vector<EnvelopePoint>& filterEnvelope, float gain, 
+    FirCorrector(unsigned sampleRate, int channelsCount, const std::vector<EnvelopePoint>& filterEnvelope, float gain,
         size_t initialSamplesBuffered);
 
-    void Push(const Buffers::SingleBuffer<PCMTYPE>& inputBuffer);
-
-    const Buffers::SingleBuffer<PCMTYPE>& Pop() const
-    {
-        return outputBuffer_;
-    }
+    // Output may be the input buffer itself
+    void Process(const Buffers::SingleBuffer<PCMTYPE>& inputBuffer, Buffers::SingleBuffer<PCMTYPE>& outputBuffer);
 
     void Flush()
     {
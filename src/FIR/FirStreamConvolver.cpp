@@ -5,10 +5,10 @@ namespace Fir {
 
 static size_t StreamConvolverInitBufferSize = 65536 * 2;
 
-FirStreamConvolver::FirStreamConvolver(const FirKernelSource& kernelSource, size_t initialSamplesBuffered)
-    : collectBuffer_(StreamConvolverInitBufferSize, true)
-    , resultBuffer_(StreamConvolverInitBufferSize, true)
-    , blockConvolver_(kernelSource)
+FirStreamConvolver::FirStreamConvolver(const FirKernelSource& kernelSource, size_t initialSamplesBuffered, int channelsCount)
+    : collectBuffers_(channelsCount, Buffers::SlidingBuffer<PCMTYPE>(StreamConvolverInitBufferSize, true))
+    , resultBuffers_(channelsCount, Buffers::SlidingBuffer<PCMTYPE>(StreamConvolverInitBufferSize, true))
+    , blockConvolver_(kernelSource, channelsCount)
     , inputProcessingBuffer_(blockConvolver_.ChunkSize())
     , outputProcessingBuffer_(blockConvolver_.ChunkSize())
     , isPreBuffering_(true)
@@ -16,12 +16,17 @@ FirStreamConvolver::FirStreamConvolver(const FirKernelSource& kernelSource, size
 {
 }
 
-size_t FirStreamConvolver::Convolve(const std::vector<PCMTYPE>& inputBuffer,
-                                    std::vector<PCMTYPE>& outputBuffer,
-                                    size_t samplesCount,
+size_t FirStreamConvolver::Convolve(const Buffers::SingleBuffer<PCMTYPE>& inputBuffer,
+                                    Buffers::SingleBuffer<PCMTYPE>& outputBuffer,
                                     float gain)
 {
-    collectBuffer_.Push(inputBuffer, 0, samplesCount);
+    size_t samplesCount = inputBuffer.DataLengthSamples();
+    int channelsCount = static_cast<int>(collectBuffers_.size());
+
+    for (int channel = 0; channel < channelsCount; channel++)
+    {
+        collectBuffers_[channel].Push(inputBuffer.ChannelDataConst(channel), samplesCount);
+    }
 
     size_t expectedSize = blockConvolver_.ChunkSize();
     if (isPreBuffering_)
@@ -34,22 +39,28 @@ size_t FirStreamConvolver::Convolve(const std::vector<PCMTYPE>& inputBuffer,
         }
     }
 
-    while (collectBuffer_.DataLengthSamples() >= expectedSize)
+    while (collectBuffers_[0].DataLengthSamples() >= expectedSize)
     {
         isPreBuffering_ = false;
 
-        collectBuffer_.Pop(inputProcessingBuffer_, 0, inputProcessingBuffer_.size());
+        for (int channel = 0; channel < channelsCount; channel++)
+        {
+            collectBuffers_[channel].Pop(inputProcessingBuffer_, 0, inputProcessingBuffer_.size());
 
-        size_t convolvedSamples = blockConvolver_.Convolve(inputProcessingBuffer_, outputProcessingBuffer_, gain);
+            size_t convolvedSamples = blockConvolver_.Convolve(channel, inputProcessingBuffer_, outputProcessingBuffer_, gain);
 
-        resultBuffer_.Push(outputProcessingBuffer_, 0, convolvedSamples);
+            resultBuffers_[channel].Push(outputProcessingBuffer_, 0, convolvedSamples);
+        }
     }
 
-    size_t resultLength = std::min(resultBuffer_.DataLengthSamples(), samplesCount);
+    size_t resultLength = std::min(resultBuffers_[0].DataLengthSamples(), samplesCount);
 
     if (resultLength > 0)
     {
-        resultBuffer_.Pop(outputBuffer, 0, resultLength);
+        for (int channel = 0; channel < channelsCount; channel++)
+        {
+            resultBuffers_[channel].Pop(outputBuffer.ChannelData(channel), resultLength);
+        }
     }
 
     return resultLength;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Buffers/SingleBuffer.h"
 #include "Buffers/SlidingBuffer.h"
 #include "Configuration.h"
 #include "FirBlockConvolver.h"
@@ -11,7 +12,7 @@ namespace Fir {
 class FirStreamConvolver
 {
 private:
-    Buffers::SlidingBuffer<PCMTYPE> collectBuffer_, resultBuffer_;
+    std::vector<Buffers::SlidingBuffer<PCMTYPE>> collectBuffers_, resultBuffers_;
     FirBlockConvolver blockConvolver_;
 
     std::vector<PCMTYPE> inputProcessingBuffer_, outputProcessingBuffer_;
@@ -20,16 +21,25 @@ private:
     size_t initialSamplesBuffered_;
 
 public:
-    FirStreamConvolver(const FirKernelSource& kernelSource, size_t initialSamplesBuffered = 0);
+    FirStreamConvolver(const FirKernelSource& kernelSource, size_t initialSamplesBuffered = 0, int channelsCount = 1);
 
     void Flush()
     {
-        collectBuffer_.Flush();
-        resultBuffer_.Flush();
+        for (auto& collectBuffer : collectBuffers_)
+        {
+            collectBuffer.Flush();
+        }
+
+        for (auto& resultBuffer : resultBuffers_)
+        {
+            resultBuffer.Flush();
+        }
+
         blockConvolver_.Flush();
     }
 
-    size_t Convolve(const std::vector<PCMTYPE>& inputBuffer, std::vector<PCMTYPE>& outputBuffer, size_t samplesCount, float gain);
+    // Channels advance in lockstep, so all of them are buffered and convolved at the same positions
+    size_t Convolve(const Buffers::SingleBuffer<PCMTYPE>& inputBuffer, Buffers::SingleBuffer<PCMTYPE>& outputBuffer, float gain);
 };
 
 } // namespace Fir
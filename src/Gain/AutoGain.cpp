@@ -4,22 +4,40 @@
 namespace dePhonica {
 namespace Gain {
 
-AutoGain::AutoGain(unsigned sampleRate, const AutoGainDescription& autoGainDescription, Core::PipelineReflection& pipelineReflection)
+template<typename T>
+AutoGain<T>::AutoGain(unsigned sampleRate, const AutoGainDescription& autoGainDescription, Core::PipelineReflection& pipelineReflection)
     : sampleRate_(sampleRate)
     , autoGainDescription_(autoGainDescription)
     , pipelineReflection_(pipelineReflection)
+    , gainStepSlot_(0)
     , gainIncreaseThreshold_(Math::LogConversions::DecibelsToValue(autoGainDescription.GainIncreaseThresholdDb))
     , gainReduceThreshold_(Math::LogConversions::DecibelsToValue(autoGainDescription.GainReduceThresholdDb))
     , gainStepIndex_(0)
     , samplesFromLastGainIncrease_(0)
     , samplesPerGainIncrease_(autoGainDescription.GainIncreasePeriodMs * sampleRate / 1000)
 {
+    if (autoGainDescription_.IsBypassed == false)
+    {
+        // Only the master measures, followers just read the gain step
+        if (autoGainDescription_.IsMaster)
+        {
+            levelBinding_ = pipelineReflection_.LevelBindingSlot(autoGainDescription_.Binding);
+        }
+
+        gainStepSlot_ = pipelineReflection_.VariableSlot(autoGainDescription_.GainStepVariableName);
+    }
 }
 
-void AutoGain::Apply(Buffers::SingleBuffer<PCMTYPE>& inputBuffer)
+template<typename T>
+void AutoGain<T>::Apply(Buffers::SingleBuffer<T>& inputBuffer, float outputGain)
 {
     if (autoGainDescription_.IsBypassed)
     {
+        if (outputGain != 1.0f)
+        {
+            inputBuffer.Amplify(outputGain);
+        }
+
         return;
     }
 
@@ -27,25 +45,28 @@ void AutoGain::Apply(Buffers::SingleBuffer<PCMTYPE>& inputBuffer)
 
     if (autoGainDescription_.IsMaster)
     {
-        auto measuredValue = pipelineReflection_.GetPeakLevel(autoGainDescription_.Binding);
+        auto measuredValue = pipelineReflection_.GetLevel(levelBinding_);
+
+        // Loudness windows refill after every step, nothing is decided until they do
+        bool isMeasured = pipelineReflection_.IsLevelMeasured(levelBinding_);
 
         //printf("Peak value: %f for binding %s\n", measuredValue, autoGainDescription_.Binding.c_str());
 
-        if (measuredValue > gainReduceThreshold_ && gainStepIndex_ < autoGainDescription_.MaxGainSteps)
+        if (isMeasured && measuredValue > gainReduceThreshold_ && gainStepIndex_ < autoGainDescription_.MaxGainSteps)
         {
             gainStepIndex_++;
-            pipelineReflection_.FlushPeakLevel(autoGainDescription_.Binding);
-            pipelineReflection_.SetVariable(autoGainDescription_.GainStepVariableName, gainStepIndex_);
+            pipelineReflection_.FlushLevel(levelBinding_);
+            pipelineReflection_.SetVariable(gainStepSlot_, gainStepIndex_);
 
             samplesFromLastGainIncrease_ = 0;
 
             //printf("Gain down, step: %d\n", gainStepIndex_);
         }
-        else if (measuredValue < gainIncreaseThreshold_ && gainStepIndex_ > 0 && samplesFromLastGainIncrease_ >= samplesPerGainIncrease_)
+        else if (isMeasured && measuredValue < gainIncreaseThreshold_ && gainStepIndex_ > 0 && samplesFromLastGainIncrease_ >= samplesPerGainIncrease_)
         {
             gainStepIndex_--;
-            pipelineReflection_.FlushPeakLevel(autoGainDescription_.Binding);
-            pipelineReflection_.SetVariable(autoGainDescription_.GainStepVariableName, gainStepIndex_);
+            pipelineReflection_.FlushLevel(levelBinding_);
+            pipelineReflection_.SetVariable(gainStepSlot_, gainStepIndex_);
 
             samplesFromLastGainIncrease_ = 0;
 
@@ -54,41 +75,34 @@ void AutoGain::Apply(Buffers::SingleBuffer<PCMTYPE>& inputBuffer)
     }
     else
     {
-        gainStepIndex_ = pipelineReflection_.GetVariable(autoGainDescription_.GainStepVariableName);
+        gainStepIndex_ = pipelineReflection_.GetVariable(gainStepSlot_);
     }
 
     samplesFromLastGainIncrease_ += inputBuffer.DataLengthSamples();
 
     double finalGain = Math::LogConversions::DecibelsToValue(autoGainDescription_.GainStepValueDb * gainStepIndex_);
 
-    ApplyGain(inputBuffer, initialGain, finalGain);
+    ApplyGain(inputBuffer, initialGain, finalGain, outputGain);
 }
 
-void AutoGain::ApplyGain(Buffers::SingleBuffer<PCMTYPE>& inputBuffer, double initialGain, double finalGain)
+template<typename T>
+void AutoGain<T>::ApplyGain(Buffers::SingleBuffer<T>& inputBuffer, double initialGain, double finalGain, float outputGain)
 {
-    auto& dataSamples = inputBuffer.BufferData();
-    size_t samplesCount = inputBuffer.DataLengthSamples();
-
     if (std::abs(finalGain - initialGain) < 0.0001)
     {
         // constant gain
-        for (size_t n = 0; n < samplesCount; n++)
-        {
-            dataSamples[n] *= initialGain;
-        }
+        inputBuffer.Amplify(static_cast<float>(initialGain * outputGain));
     }
     else
     {
         // fading
-        double currentGain = initialGain;
-        double gainStep = (finalGain - initialGain) / samplesCount;
-
-        for (size_t n = 0; n < samplesCount; n++, currentGain += gainStep)
-        {
-            dataSamples[n] *= static_cast<float>(currentGain);
-        }
+        inputBuffer.Amplify(static_cast<float>(initialGain * outputGain), static_cast<float>(finalGain * outputGain));
     }
 }
 
+template class AutoGain<float>;
+template class AutoGain<double>;
+template class AutoGain<int32_t>;
+
 } // namespace Gain
 } // namespace dePhonica
@@ -8,24 +8,29 @@
 namespace dePhonica {
 namespace Gain {
 
+// Instantiated for float, double and int32_t samples
+template<typename T>
 class AutoGain
 {
 private:
     unsigned sampleRate_;
     const AutoGainDescription& autoGainDescription_;
     Core::PipelineReflection& pipelineReflection_;
+    Core::LevelBinding levelBinding_;
+    Core::ReflectionSlot gainStepSlot_;
 
     float gainIncreaseThreshold_, gainReduceThreshold_;
 
     int gainStepIndex_;
     int samplesFromLastGainIncrease_, samplesPerGainIncrease_;
 
-    void ApplyGain(Buffers::SingleBuffer<PCMTYPE>& inputBuffer, double initialGain, double finalGain);
+    void ApplyGain(Buffers::SingleBuffer<T>& inputBuffer, double initialGain, double finalGain, float outputGain);
 
 public:
     AutoGain(unsigned sampleRate, const AutoGainDescription& autoGainDescription, Core::PipelineReflection& pipelineReflection);
 
-    void Apply(Buffers::SingleBuffer<PCMTYPE>& inputBuffer);
+    // outputGain is applied in the same pass, even when bypassed; -1 inverts the band
+    void Apply(Buffers::SingleBuffer<T>& inputBuffer, float outputGain = 1.0f);
 
     void Flush() 
     {
@@ -10,8 +10,9 @@ namespace Gain {
 struct AutoGainDescription
 {
     bool IsBypassed = true;
-    bool IsMaster;
+    bool IsMaster = false;
 
+    // Reflection tap name, with a ":momentary", ":shortTerm" or ":integrated" suffix thresholds are in LUFS
     std::string Binding;
     std::string GainStepVariableName;
 
@@ -1,18 +1,14 @@
+#include <type_traits>
+
 #include "IirFilter.h"
 
 namespace dePhonica {
 namespace Iir {
 
-IirFilter::IirFilter(unsigned sampleRate, const IirFilterDescription &filterDescription) :
-    filterDescription_(filterDescription)
+IirFilter::IirFilter(unsigned sampleRate, int channelsCount, const IirFilterDescription &filterDescription) :
+    filterDescription_(filterDescription),
+    channelsCount_(channelsCount)
 {
-    bandPass_[0] = bandPass_[1] = NULL;
-    lowPass_[0] = lowPass_[1] = NULL;
-    highPass_[0] = highPass_[1] = NULL;
-    lowShelf_[0] = lowShelf_[1] = NULL;
-    highShelf_[0] = highShelf_[1] = NULL;
-    bandShelf_[0] = bandShelf_[1] = NULL;
-
     if (filterDescription.IsCrossover)
     {
         auto order = (filterDescription.Order + (filterDescription.Order % 2)) / 2;
@@ -35,53 +31,37 @@ void IirFilter::CreateFilter(int filterIndex, IirFilterTypes filterType, double
     switch (filterType)
     {
     case IirFilterTypes::BandPass:
-        bandPass_[filterIndex] = new Dsp::SimpleFilter<Dsp::Butterworth::BandPass<16>, 1>();
+        bandPass_[filterIndex] = std::make_unique<ChannelsFilter<Dsp::Butterworth::BandPass<16>>>(channelsCount_);
         bandPass_[filterIndex]->setup(order, sampleRate, centerFrequency, bandWidth);
         break;
 
     case IirFilterTypes::HighPass:
-        highPass_[filterIndex] = new Dsp::SimpleFilter<Dsp::Butterworth::HighPass<16>, 1>();
+        highPass_[filterIndex] = std::make_unique<ChannelsFilter<Dsp::Butterworth::HighPass<16>>>(channelsCount_);
         highPass_[filterIndex]->setup(order, sampleRate, centerFrequency);
         break;
 
     case IirFilterTypes::HighShelf:
-        highShelf_[filterIndex] = new Dsp::SimpleFilter<Dsp::Butterworth::HighShelf<16>, 1>();
+        highShelf_[filterIndex] = std::make_unique<ChannelsFilter<Dsp::Butterworth::HighShelf<16>>>(channelsCount_);
         highShelf_[filterIndex]->setup(order, sampleRate, centerFrequency, gainDb);
         break;
 
     case IirFilterTypes::LowPass:
-        lowPass_[filterIndex] = new Dsp::SimpleFilter<Dsp::Butterworth::LowPass<16>, 1>();
+        lowPass_[filterIndex] = std::make_unique<ChannelsFilter<Dsp::Butterworth::LowPass<16>>>(channelsCount_);
         lowPass_[filterIndex]->setup(order, sampleRate, centerFrequency);
         break;
 
     case IirFilterTypes::LowShelf:
-        lowShelf_[filterIndex] = new Dsp::SimpleFilter<Dsp::Butterworth::LowShelf<16>, 1>();
+        lowShelf_[filterIndex] = std::make_unique<ChannelsFilter<Dsp::Butterworth::LowShelf<16>>>(channelsCount_);
         lowShelf_[filterIndex]->setup(order, sampleRate, centerFrequency, gainDb);
         break;
 
     case IirFilterTypes::BandShelf:
-        bandShelf_[filterIndex] = new Dsp::SimpleFilter<Dsp::Butterworth::BandShelf<16>, 1>();
+        bandShelf_[filterIndex] = std::make_unique<ChannelsFilter<Dsp::Butterworth::BandShelf<16>>>(channelsCount_);
         bandShelf_[filterIndex]->setup(order, sampleRate, centerFrequency, bandWidth, gainDb);
         break;
     }
 }
 
-IirFilter::~IirFilter()
-{
-    if (bandPass_[0]) delete bandPass_[0];
-    if (bandPass_[1]) delete bandPass_[1];
-    if (lowPass_[0]) delete lowPass_[0];
-    if (lowPass_[1]) delete lowPass_[1];
-    if (highPass_[0]) delete highPass_[0];
-    if (highPass_[1]) delete highPass_[1];
-    if (lowShelf_[0]) delete lowShelf_[0];
-    if (lowShelf_[1]) delete lowShelf_[1];
-    if (highShelf_[0]) delete highShelf_[0];
-    if (highShelf_[1]) delete highShelf_[1];
-    if (bandShelf_[0]) delete bandShelf_[0];
-    if (bandShelf_[1]) delete bandShelf_[1];
-}
-
 void IirFilter::Flush()
 {
     if (bandPass_[0]) bandPass_[0]->reset();
@@ -98,43 +78,61 @@ void IirFilter::Flush()
     if (bandShelf_[1]) bandShelf_[1]->reset();
 }
 
-void IirFilter::Apply(Buffers::SingleBuffer<PCMTYPE>& processingBuffer)
+template<typename T>
+void IirFilter::Apply(Buffers::SingleBuffer<T>& processingBuffer)
 {
-    PCMTYPE *channels[] = {processingBuffer.BufferData().data()};
+    if constexpr (std::is_integral<T>::value)
+    {
+        integerScratch_.CopyConverted(processingBuffer);
+        ApplyFilters(integerScratch_);
+        processingBuffer.CopyConverted(integerScratch_);
+    }
+    else
+    {
+        ApplyFilters(processingBuffer);
+    }
+}
 
+template<typename T>
+void IirFilter::ApplyFilters(Buffers::SingleBuffer<T>& processingBuffer)
+{
     switch (filterDescription_.FilterType)
     {
     case IirFilterTypes::BandPass:
-        bandPass_[0]->process(processingBuffer.DataLengthSamples(), channels);
-        if (bandPass_[1]) bandPass_[1]->process(processingBuffer.DataLengthSamples(), channels);
+        bandPass_[0]->process(processingBuffer);
+        if (bandPass_[1]) bandPass_[1]->process(processingBuffer);
         break;
 
     case IirFilterTypes::HighPass:
-        highPass_[0]->process(processingBuffer.DataLengthSamples(), channels);
-        if (highPass_[1]) highPass_[1]->process(processingBuffer.DataLengthSamples(), channels);
+        highPass_[0]->process(processingBuffer);
+        if (highPass_[1]) highPass_[1]->process(processingBuffer);
         break;
 
     case IirFilterTypes::HighShelf:
-        highShelf_[0]->process(processingBuffer.DataLengthSamples(), channels);
-        if (highShelf_[1]) highShelf_[1]->process(processingBuffer.DataLengthSamples(), channels);
+        highShelf_[0]->process(processingBuffer);
+        if (highShelf_[1]) highShelf_[1]->process(processingBuffer);
         break;
 
     case IirFilterTypes::LowPass:
-        lowPass_[0]->process(processingBuffer.DataLengthSamples(), channels);
-        if (lowPass_[1]) lowPass_[1]->process(processingBuffer.DataLengthSamples(), channels);
+        lowPass_[0]->process(processingBuffer);
+        if (lowPass_[1]) lowPass_[1]->process(processingBuffer);
         break;
 
     case IirFilterTypes::LowShelf:
-        lowShelf_[0]->process(processingBuffer.DataLengthSamples(), channels);
-        if (lowShelf_[1]) lowShelf_[1]->process(processingBuffer.DataLengthSamples(), channels);
+        lowShelf_[0]->process(processingBuffer);
+        if (lowShelf_[1]) lowShelf_[1]->process(processingBuffer);
         break;
 
     case IirFilterTypes::BandShelf:
-        bandShelf_[0]->process(processingBuffer.DataLengthSamples(), channels);
-        if (bandShelf_[1]) bandShelf_[1]->process(processingBuffer.DataLengthSamples(), channels);
+        bandShelf_[0]->process(processingBuffer);
+        if (bandShelf_[1]) bandShelf_[1]->process(processingBuffer);
         break;
     }
 }
 
+template void IirFilter::Apply(Buffers::SingleBuffer<float>& processingBuffer);
+template void IirFilter::Apply(Buffers::SingleBuffer<double>& processingBuffer);
+template void IirFilter::Apply(Buffers::SingleBuffer<int32_t>& processingBuffer);
+
 } // namespace Iir
 } // namespace dePhonica
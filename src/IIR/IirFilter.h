@@ -1,5 +1,9 @@
 #pragma once
 
+#include <memory>
+#include <type_traits>
+#include <vector>
+
 #include "IirFilterDescription.h"
 #include "Buffers/SingleBuffer.h"
 #include "Configuration.h"
@@ -9,28 +13,82 @@
 namespace dePhonica {
 namespace Iir {
 
+// One filter design shared by all the channels, every channel keeps its own history
+template<class DesignClass>
+class ChannelsFilter : public DesignClass
+{
+private:
+    // State objects point into themselves, so the vector is sized once and never reallocated
+    std::vector<typename DesignClass::template State<Dsp::DirectFormII>> channelStates_;
+
+public:
+    explicit ChannelsFilter(int channelsCount)
+        : channelStates_(channelsCount)
+    {
+    }
+
+    void reset()
+    {
+        for (auto& channelState : channelStates_)
+        {
+            channelState.reset();
+        }
+    }
+
+    template<typename T>
+    void process(Buffers::SingleBuffer<T>& processingBuffer)
+    {
+        int samplesCount = static_cast<int>(processingBuffer.DataLengthSamples());
+
+        for (size_t channel = 0; channel < channelStates_.size(); channel++)
+        {
+            DesignClass::process(samplesCount, processingBuffer.ChannelData(channel), channelStates_[channel]);
+        }
+    }
+};
+
 class IirFilter
 {
 private:
     const IirFilterDescription& filterDescription_;
+    int channelsCount_;
+
+    std::unique_ptr<ChannelsFilter<Dsp::Butterworth::BandPass<16>>> bandPass_[2];
+    std::unique_ptr<ChannelsFilter<Dsp::Butterworth::LowPass<16>>> lowPass_[2];
+    std::unique_ptr<ChannelsFilter<Dsp::Butterworth::HighPass<16>>> highPass_[2];
+    std::unique_ptr<ChannelsFilter<Dsp::Butterworth::LowShelf<16>>> lowShelf_[2];
+    std::unique_ptr<ChannelsFilter<Dsp::Butterworth::HighShelf<16>>> highShelf_[2];
+    std::unique_ptr<ChannelsFilter<Dsp::Butterworth::BandShelf<16>>> bandShelf_[2];
 
-    Dsp::SimpleFilter <Dsp::Butterworth::BandPass <16>, 1> *bandPass_[2];
-	Dsp::SimpleFilter <Dsp::Butterworth::LowPass <16>, 1> *lowPass_[2];
-	Dsp::SimpleFilter <Dsp::Butterworth::HighPass <16>, 1> *highPass_[2];
-	Dsp::SimpleFilter <Dsp::Butterworth::LowShelf <16>, 1> *lowShelf_[2];    
-	Dsp::SimpleFilter <Dsp::Butterworth::HighShelf <16>, 1> *highShelf_[2];
-    Dsp::SimpleFilter <Dsp::Butterworth::BandShelf <16>, 1> *bandShelf_[2];
+    // Integer samples are filtered in double, the cascade would wrap around on overshoot
+    Buffers::SingleBuffer<double> integerScratch_;
 
     void CreateFilter(int filterIndex, IirFilterTypes filterType, double sampleRate, int order,
         double centerFrequency, double bandWidth, double gainDb);
 
+    template<typename T>
+    void ApplyFilters(Buffers::SingleBuffer<T>& processingBuffer);
+
 public:
-    IirFilter(unsigned sampleRate, const IirFilterDescription& filterDescription);
-    ~IirFilter();
+    IirFilter(unsigned sampleRate, int channelsCount, const IirFilterDescription& filterDescription);
+
+    // Instantiated for float, double and int32_t samples
+    template<typename T>
+    void Apply(Buffers::SingleBuffer<T>& processingBuffer);
 
-    void Apply(Buffers::SingleBuffer<PCMTYPE>& processingBuffer);
     void Flush();
+
+    // Only integer samples need the scratch, float and double bands allocate nothing
+    template<typename T>
+    void Reserve(size_t samplesCount)
+    {
+        if constexpr (std::is_integral<T>::value)
+        {
+            integerScratch_.Channels(channelsCount_);
+            integerScratch_.Ensure(samplesCount);
+        }
+    }
 };
 
 } // namespace Iir
-} // namespace dePhonica
\ No newline at end of file
+} // namespace dePhonica
@@ -1,29 +1,42 @@
+#include <algorithm>
 #include <iostream>
+#include <stdexcept>
 #include <vector>
+#include <string>
 #include <string.h>
+#include <unistd.h>
 
 #include "Ladspa/src/ladspa.h"
 #include "PipelineWrapper.h"
 
 using namespace dePhonica::Core;
 
-#define PORT_INPUT ((int)PipelineWrapperPorts::Input)
-#define PORT_OUTPUT ((int)PipelineWrapperPorts::Output)
+struct PipelineDescriptorData
+{
+    std::string ConfigFileJson;
+    PipelineOutputs Outputs;
+};
 
 static LADSPA_Handle instantiatePipeline(const LADSPA_Descriptor* ladspaDescriptor, unsigned long sampleRate)
 {
-    auto configFileJson = static_cast<const char*>(ladspaDescriptor->ImplementationData);
+    auto descriptorData = static_cast<const PipelineDescriptorData*>(ladspaDescriptor->ImplementationData);
 
-    return new PipelineWrapper(sampleRate, configFileJson);
+    try
+    {
+        return new PipelineWrapper(sampleRate, descriptorData->ConfigFileJson, descriptorData->Outputs);
+    }
+    catch (const std::invalid_argument& e)
+    {
+        std::cerr << "Unable to build pipeline from " << descriptorData->ConfigFileJson << ": " << e.what() << std::endl;
+    }
+
+    return NULL;
 }
 
 static void connectPortToPipeline(LADSPA_Handle instance, unsigned long port, LADSPA_Data* dataLocation)
 {
-    if (port < PipelineWrapperPortsCount)
-    {
-        auto pipelineWrapper = static_cast<PipelineWrapper*>(instance);
-        pipelineWrapper->SetPortDataLocation((PipelineWrapperPorts)port, dataLocation);
-    }
+    auto pipelineWrapper = static_cast<PipelineWrapper*>(instance);
+    pipelineWrapper->SetPortDataLocation(port, dataLocation);
 }
 
 static void activatePipeline(LADSPA_Handle instance)
@@ -58,32 +71,65 @@ private:
         return output;
     }
 
-    void ConstructPorts(LADSPA_Descriptor* ladspaDescriptor)
+    static char* PortName(const char* baseName, const PipelineWrapperPortLayout& portLayout, int channel, int output = -1)
     {
-        ladspaDescriptor->PortCount = PipelineWrapperPortsCount;
+        std::string portName = baseName;
 
-        auto ladspaPortDescriptors = new LADSPA_PortDescriptor[PipelineWrapperPortsCount];
-        ladspaPortDescriptors[PORT_INPUT] = LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO;
-        ladspaPortDescriptors[PORT_OUTPUT] = LADSPA_PORT_OUTPUT | LADSPA_PORT_AUDIO;
+        if (portLayout.Channels() > 1)
+        {
+            portName += " " + std::to_string(channel + 1);
+        }
 
-        ladspaDescriptor->PortDescriptors = ladspaPortDescriptors;
+        if (output >= 0 && portLayout.Outputs() > 1)
+        {
+            portName += ", band " + std::to_string(output + 1);
+        }
 
-        // Port names
-        auto portNames = new char*[PipelineWrapperPortsCount];
-        portNames[PORT_INPUT] = LocalStrdup("Input audio stream");
-        portNames[PORT_OUTPUT] = LocalStrdup("Output audio stream");
+        return LocalStrdup(portName.c_str());
+    }
 
-        ladspaDescriptor->PortNames = portNames;
+    void ConstructPorts(LADSPA_Descriptor* ladspaDescriptor, const PipelineWrapperPortLayout& portLayout)
+    {
+        auto portsCount = portLayout.PortsCount();
+        ladspaDescriptor->PortCount = portsCount;
+
+        auto ladspaPortDescriptors = new LADSPA_PortDescriptor[portsCount];
+        auto portNames = new char*[portsCount];
+        auto portRanges = new LADSPA_PortRangeHint[portsCount];
 
-        // Port range hint
-        auto portRanges = new LADSPA_PortRangeHint[PipelineWrapperPortsCount];
-        portRanges[PORT_INPUT].HintDescriptor = 0;
-        portRanges[PORT_OUTPUT].HintDescriptor = 0;
+        for (unsigned long port = 0; port < portsCount; port++)
+        {
+            int channel = portLayout.PortChannel(port);
 
+            switch (portLayout.PortType(port))
+            {
+            case PipelineWrapperPorts::Input:
+                ladspaPortDescriptors[port] = LADSPA_PORT_INPUT | LADSPA_PORT_AUDIO;
+                portNames[port] = PortName("Input audio stream", portLayout, channel);
+                portRanges[port].HintDescriptor = 0;
+                break;
+
+            case PipelineWrapperPorts::Output:
+                ladspaPortDescriptors[port] = LADSPA_PORT_OUTPUT | LADSPA_PORT_AUDIO;
+                portNames[port] = PortName("Output audio stream", portLayout, channel, portLayout.PortOutput(port));
+                portRanges[port].HintDescriptor = 0;
+                break;
+
+            case PipelineWrapperPorts::Latency:
+                ladspaPortDescriptors[port] = LADSPA_PORT_OUTPUT | LADSPA_PORT_CONTROL;
+                // Hosts look for an output control port named "latency" to compensate plug-in delay
+                portNames[port] = LocalStrdup("latency");
+                portRanges[port].HintDescriptor = LADSPA_HINT_INTEGER;
+                break;
+            }
+        }
+
+        ladspaDescriptor->PortDescriptors = ladspaPortDescriptors;
+        ladspaDescriptor->PortNames = portNames;
         ladspaDescriptor->PortRangeHints = portRanges;
     }
 
-    void ConstructDescriptors(const char* label, const char* configFileJson)
+    void ConstructDescriptors(const char* label, const char* configFileJson, PipelineOutputs outputs = PipelineOutputs::Mixed)
     {
         auto ladspaDescriptor = new LADSPA_Descriptor();
         if (ladspaDescriptor == NULL)
@@ -95,12 +141,22 @@ private:
         ladspaDescriptor->UniqueID = 8286 + ladspaDescriptors_.size();
         ladspaDescriptor->Properties = 0;
         ladspaDescriptor->Label = LocalStrdup(label);
-        ladspaDescriptor->Name = LocalStrdup("Audio processor and crossover");
+        ladspaDescriptor->Name = LocalStrdup(outputs == PipelineOutputs::SubBands ? "Audio processor and crossover, output per band"
+                                                                                   : "Audio processor and crossover");
         ladspaDescriptor->Maker = LocalStrdup("Max Klimenko @ dePhonica sound labs");
         ladspaDescriptor->Copyright = LocalStrdup("Mail.RU");
-        ladspaDescriptor->ImplementationData = LocalStrdup(configFileJson);
+        ladspaDescriptor->ImplementationData = new PipelineDescriptorData{ configFileJson, outputs };
 
-        ConstructPorts(ladspaDescriptor);
+        auto pipelineLayout = PipelineDescription::ReadLayout(configFileJson);
+        int outputsCount = outputs == PipelineOutputs::SubBands ? std::max<int>(1, pipelineLayout.SubBandsCount) : 1;
+
+        // Graph pipelines declare their outputs explicitly
+        if (pipelineLayout.GraphOutputsCount > 0)
+        {
+            outputsCount = static_cast<int>(pipelineLayout.GraphOutputsCount);
+        }
+
+        ConstructPorts(ladspaDescriptor, PipelineWrapperPortLayout(pipelineLayout.ChannelsCount, outputsCount));
 
         ladspaDescriptor->instantiate = instantiatePipeline;
         ladspaDescriptor->connect_port = connectPortToPipeline;
@@ -114,6 +170,14 @@ private:
         ladspaDescriptors_.push_back(ladspaDescriptor);
     }
 
+    // A description compiled by configcompiler takes precedence over the JSON one
+    static std::string ConfigFileName(const std::string& baseName)
+    {
+        std::string compiledFileName = baseName + ".dphb";
+
+        return access(compiledFileName.c_str(), R_OK) == 0 ? compiledFileName : baseName + ".json";
+    }
+
     void DestructDescriptors()
     {
         for (auto descriptor : ladspaDescriptors_)
@@ -136,7 +200,7 @@ private:
 
             delete[] descriptor->PortNames;
             delete[] descriptor->PortRangeHints;
-            delete[] static_cast<char*>(descriptor->ImplementationData);
+            delete static_cast<PipelineDescriptorData*>(descriptor->ImplementationData);
             delete descriptor;
         }
 
@@ -146,8 +210,10 @@ private:
 public:
     LadspaWrapper()
     {
-        ConstructDescriptors("deph_crossover_woofer", "/etc/dephonica/woofer.json");
-        ConstructDescriptors("deph_crossover_tweeter", "/etc/dephonica/tweeter.json");
+        ConstructDescriptors("deph_crossover_woofer", ConfigFileName("/etc/dephonica/woofer").c_str());
+        ConstructDescriptors("deph_crossover_tweeter", ConfigFileName("/etc/dephonica/tweeter").c_str());
+        // Full-band correction and pre-processing are done once for all the sub-bands
+        ConstructDescriptors("deph_crossover", ConfigFileName("/etc/dephonica/crossover").c_str(), PipelineOutputs::SubBands);
     }
 
     ~LadspaWrapper() { DestructDescriptors(); }
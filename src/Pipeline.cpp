@@ -1,75 +1,404 @@
 #include "Pipeline.h"
 
+#include <iostream>
+#include <stdexcept>
+
 namespace dePhonica {
 namespace Core {
 
-Pipeline::Pipeline(unsigned sampleRate, const PipelineDescription& pipelineDescription)
-    : firCorrector_(sampleRate, pipelineDescription.CorrectionEnvelope, pipelineDescription.CorrectionGain, 
-        pipelineDescription.InitialSamplesBuffered)
-    , pipelineReflection_(sampleRate, pipelineDescription.PeakMonitoringPeriodSeconds)        
-    , preProcessor_(sampleRate, pipelineDescription.PreProcessing, pipelineReflection_)
-    , masterProcessor_(sampleRate, pipelineDescription.MasterProcessing, pipelineReflection_)
+Pipeline::Pipeline(unsigned sampleRate, const PipelineDescription& pipelineDescription, PipelineOutputs outputs)
+    : firCorrector_(sampleRate, pipelineDescription.ChannelsCount, pipelineDescription.CorrectionEnvelope,
+        pipelineDescription.CorrectionGain, pipelineDescription.InitialSamplesBuffered)
+    , pipelineReflection_(sampleRate, pipelineDescription.ChannelsCount, pipelineDescription.PeakMonitoringPeriodSeconds,
+        pipelineDescription.MeteringDecimation, pipelineDescription.LoudnessChannelWeights)
+    , preProcessor_(PipelineBandProcessor::Create(sampleRate, pipelineDescription.ChannelsCount, pipelineDescription.PreProcessing,
+        pipelineReflection_, "preprocessing"))
+    , outputs_(pipelineDescription.SubBandProcessings.size() > 0 ? outputs : PipelineOutputs::Mixed)
+    , processingBuffer_(0, pipelineDescription.ChannelsCount)
+    , mixBuffer_(0, pipelineDescription.ChannelsCount)
+    , bandBuffer_(0, pipelineDescription.ChannelsCount)
+    , resultBuffer_(&processingBuffer_)
+    , inputSlot_(0)
+    , preProcessedSlot_(0)
+    , mixedSlot_(0)
+    , postProcessedSlot_(0)
 {
-    InitProcessings(sampleRate, pipelineDescription.SubBandProcessings);
+    if (pipelineDescription.GraphNodes.size() > 0)
+    {
+        graph_ = std::make_unique<PipelineGraph>(sampleRate, pipelineDescription.ChannelsCount, pipelineDescription.GraphNodes,
+            pipelineReflection_);
+
+        if (pipelineDescription.IsGraphPlanPrinted)
+        {
+            std::cerr << graph_->DescribePlan();
+        }
+
+        if (pipelineDescription.IsPipelined)
+        {
+            std::cerr << "Pipelined mode is not available for graph pipelines, running synchronously" << std::endl;
+        }
+    }
+    else
+    {
+        InitProcessings(sampleRate, pipelineDescription.ChannelsCount, pipelineDescription);
+        InitBindings();
+
+        if (pipelineDescription.IsPipelined)
+        {
+            InitStageScheduler(pipelineDescription.PipelineBlockSize, pipelineDescription.MaxBlockSize, pipelineDescription.ChannelsCount);
+        }
+    }
+
+    for (const auto& tapDescription : pipelineDescription.SpectrumTaps)
+    {
+        pipelineReflection_.AttachSpectrum(tapDescription);
+    }
+
+    // All bindings and variables are registered by now
+    if (pipelineDescription.SharedMetersName.empty() == false)
+    {
+        pipelineReflection_.ExportMeters(pipelineDescription.SharedMetersName);
+    }
 }
 
-void Pipeline::InitProcessings(unsigned sampleRate, const std::vector<PipelineBandDescription>& bandDescriptions)
+Pipeline::~Pipeline()
 {
-    for (const auto& bandDescription : bandDescriptions)
+    // Stage threads refer to the processors, stop them first
+    stageScheduler_.reset();
+}
+
+PipelineBandDescription Pipeline::BandMasterDescription(const PipelineBandDescription& masterDescription, size_t bandNumber)
+{
+    PipelineBandDescription bandMasterDescription = masterDescription;
+    auto& autoGain = bandMasterDescription.AutoGain;
+
+    if (autoGain.IsBypassed || autoGain.IsMaster == false)
+    {
+        return bandMasterDescription;
+    }
+
+    auto bandSuffix = std::to_string(bandNumber);
+    auto tapName = autoGain.Binding.substr(0, autoGain.Binding.rfind(':'));
+
+    if (tapName == "mixed")
+    {
+        throw std::invalid_argument("Master auto gain can't be bound to \"mixed\" when sub-bands are separate outputs, "
+            "bind it to \"postprocessed\" to measure every band after its master processing");
+    }
+
+    // Every band measures its own output and publishes its own gain step
+    if (tapName == "postprocessed")
     {
-        bandProcessors_.push_back(std::make_unique<PipelineBandProcessor>(sampleRate, bandDescription, pipelineReflection_));
+        autoGain.Binding.insert(tapName.size(), bandSuffix);
     }
+
+    autoGain.GainStepVariableName += bandSuffix;
+
+    return bandMasterDescription;
 }
 
-void Pipeline::Push(const Buffers::SingleBuffer<PCMTYPE>& inputBuffer)
+void Pipeline::InitProcessings(unsigned sampleRate, int channelsCount, const PipelineDescription& pipelineDescription)
+{
+    size_t bandsCount = pipelineDescription.SubBandProcessings.size();
+
+    if (outputs_ == PipelineOutputs::SubBands)
+    {
+        // Filled before any processor is created, processors keep referring to their description
+        for (size_t bandIndex = 0; bandIndex < bandsCount; bandIndex++)
+        {
+            bandMasterDescriptions_.push_back(BandMasterDescription(pipelineDescription.MasterProcessing, bandIndex + 1));
+        }
+    }
+    else
+    {
+        masterProcessor_ = PipelineBandProcessor::Create(
+            sampleRate, channelsCount, pipelineDescription.MasterProcessing, pipelineReflection_, "master");
+    }
+
+    for (size_t bandIndex = 0; bandIndex < bandsCount; bandIndex++)
+    {
+        auto bandNumber = std::to_string(bandIndex + 1);
+
+        bandProcessors_.push_back(PipelineBandProcessor::Create(
+            sampleRate, channelsCount, pipelineDescription.SubBandProcessings[bandIndex], pipelineReflection_, "subband" + bandNumber));
+
+        if (outputs_ == PipelineOutputs::SubBands)
+        {
+            bandMasterProcessors_.push_back(PipelineBandProcessor::Create(
+                sampleRate, channelsCount, bandMasterDescriptions_[bandIndex], pipelineReflection_, "master" + bandNumber));
+        }
+    }
+}
+
+void Pipeline::InitBindings()
+{
+    inputSlot_ = pipelineReflection_.PeakLevelSlot("input");
+    preProcessedSlot_ = pipelineReflection_.PeakLevelSlot("preprocessed");
+
+    // Sub-bands are bound as "subband1", "subband2" and so on
+    for (size_t bandIndex = 0; bandIndex < bandProcessors_.size(); bandIndex++)
+    {
+        subBandSlots_.push_back(pipelineReflection_.PeakLevelSlot("subband" + std::to_string(bandIndex + 1)));
+    }
+
+    // Separate sub-band outputs are never mixed, every band is bound after its master as "postprocessed1" and so on
+    if (outputs_ == PipelineOutputs::SubBands)
+    {
+        for (size_t bandIndex = 0; bandIndex < bandProcessors_.size(); bandIndex++)
+        {
+            postProcessedBandSlots_.push_back(pipelineReflection_.PeakLevelSlot("postprocessed" + std::to_string(bandIndex + 1)));
+        }
+    }
+    else
+    {
+        mixedSlot_ = pipelineReflection_.PeakLevelSlot("mixed");
+        postProcessedSlot_ = pipelineReflection_.PeakLevelSlot("postprocessed");
+    }
+}
+
+void Pipeline::InitStageScheduler(size_t blockSize, size_t maxSamplesCount, int channelsCount)
+{
+    // Stages touch the reflection from different threads
+    pipelineReflection_.IsShared(true);
+
+    stageOverrunsSlot_ = pipelineReflection_.VariableSlot("pipeline.overruns");
+
+    std::vector<PipelineStageScheduler::StageFunction> stageFunctions = {
+        [this](Buffers::SingleBuffer<PCMTYPE>& block) { ProcessCorrection(block, block); }
+    };
+
+    if (outputs_ == PipelineOutputs::SubBands)
+    {
+        // Band outputs need more channels than the pre-processed block, so they are built aside
+        stageFunctions.push_back([this](Buffers::SingleBuffer<PCMTYPE>& block) { block.Copy(ProcessBandOutputs(block)); });
+    }
+    else
+    {
+        stageFunctions.push_back([this](Buffers::SingleBuffer<PCMTYPE>& block) { ProcessBands(block); });
+        stageFunctions.push_back([this](Buffers::SingleBuffer<PCMTYPE>& block) { ProcessMaster(block); });
+    }
+
+    stageScheduler_ = std::make_unique<PipelineStageScheduler>(
+        blockSize, maxSamplesCount, channelsCount, channelsCount * static_cast<int>(OutputsCount()), stageFunctions);
+}
+
+void Pipeline::Reserve(size_t samplesCount)
+{
+    if (graph_)
+    {
+        graph_->Reserve(samplesCount);
+        return;
+    }
+
+    // Pipelined stages see blocks of the scheduler size rather than host blocks
+    size_t processorSamplesCount = samplesCount;
+
+    if (stageScheduler_)
+    {
+        stageScheduler_->Reserve(samplesCount);
+        processorSamplesCount = std::max(samplesCount, stageScheduler_->BlockSize());
+    }
+
+    preProcessor_->Reserve(processorSamplesCount);
+
+    if (masterProcessor_)
+    {
+        masterProcessor_->Reserve(processorSamplesCount);
+    }
+
+    for (auto& bandProcessor : bandProcessors_)
+    {
+        bandProcessor->Reserve(processorSamplesCount);
+    }
+
+    for (auto& bandMasterProcessor : bandMasterProcessors_)
+    {
+        bandMasterProcessor->Reserve(processorSamplesCount);
+    }
+
+    processingBuffer_.Ensure(samplesCount);
+    mixBuffer_.Ensure(samplesCount);
+    bandBuffer_.Ensure(samplesCount);
+
+    if (outputs_ == PipelineOutputs::SubBands)
+    {
+        bandOutputsBuffer_.Channels(processingBuffer_.Channels() * static_cast<int>(bandProcessors_.size()));
+        bandOutputsBuffer_.Ensure(samplesCount);
+    }
+}
+
+void Pipeline::ProcessCorrection(const Buffers::SingleBuffer<PCMTYPE>& inputBuffer, Buffers::SingleBuffer<PCMTYPE>& outputBuffer)
 {
-    pipelineReflection_.PushPeakLevel("input", inputBuffer);
+    StageTicks reflectionTicks = 0;
+    StageTicks mark = stageCounters_.Mark();
+
+    pipelineReflection_.PushPeakLevel(inputSlot_, inputBuffer);
+    mark = stageCounters_.Lap(reflectionTicks, mark);
 
     // Overall envelope correction
-    firCorrector_.Push(inputBuffer);
-    const auto& correctedBuffer = firCorrector_.Pop();
+    firCorrector_.Process(inputBuffer, outputBuffer);
+    mark = stageCounters_.Lap(PipelineStages::Correction, mark);
 
-    preProcessor_.Push(correctedBuffer);
-    const auto& preProcessedBuffer = preProcessor_.Pop();
+    preProcessor_->Apply(outputBuffer);
+    mark = stageCounters_.Lap(PipelineStages::PreProcessing, mark);
 
-    pipelineReflection_.PushPeakLevel("preprocessed", preProcessedBuffer);
+    pipelineReflection_.PushPeakLevel(preProcessedSlot_, outputBuffer);
+    stageCounters_.Lap(reflectionTicks, mark);
 
-    // Band processors
-    intermediateBuffer_.Ensure(inputBuffer.DataLengthSamples());
+    stageCounters_.Record(PipelineStages::Reflection, reflectionTicks);
+}
+
+void Pipeline::ProcessBands(Buffers::SingleBuffer<PCMTYPE>& processingBuffer)
+{
+    size_t bandsCount = bandProcessors_.size();
 
-    if (bandProcessors_.size() > 0)
+    StageTicks mixTicks = 0, reflectionTicks = 0;
+    StageTicks mark = stageCounters_.Mark();
+
+    // Every sub-band but the last one works on a copy, the last one takes the pre-processed samples over
+    for (size_t bandIndex = 0; bandIndex < bandsCount; bandIndex++)
     {
-        int subBandIndex = 1;
-        bool isFirstBuffer = true;
+        bool isLastBand = bandIndex + 1 == bandsCount;
+
+        auto& bandBuffer = isLastBand ? processingBuffer : (bandIndex == 0 ? mixBuffer_ : bandBuffer_);
+
+        if (isLastBand == false)
+        {
+            bandBuffer.Copy(processingBuffer);
+            mark = stageCounters_.Lap(mixTicks, mark);
+        }
 
-        for (auto& bandProcessor : bandProcessors_)
+        bandProcessors_[bandIndex]->Apply(bandBuffer);
+        mark = stageCounters_.Lap(PipelineStages::Band, mark, bandIndex);
+
+        pipelineReflection_.PushPeakLevel(subBandSlots_[bandIndex], bandBuffer);
+        mark = stageCounters_.Lap(reflectionTicks, mark);
+
+        if (bandIndex > 0 && isLastBand == false)
         {
-            bandProcessor->Push(preProcessedBuffer);
-
-            const auto& bandBuffer = bandProcessor->Pop();
-            pipelineReflection_.PushPeakLevel("subband" + subBandIndex, bandBuffer);
-            subBandIndex++;
-
-            if (isFirstBuffer)
-            {
-                isFirstBuffer = false;
-                intermediateBuffer_.Copy(bandBuffer);
-            }
-            else
-            {
-                intermediateBuffer_.Mix(bandBuffer);
-            }
+            mixBuffer_.Mix(bandBuffer);
+            mark = stageCounters_.Lap(mixTicks, mark);
         }
-    } else
+    }
+
+    if (bandsCount > 1)
     {
-        intermediateBuffer_.Copy(preProcessedBuffer);
+        processingBuffer.Mix(mixBuffer_);
+        mark = stageCounters_.Lap(mixTicks, mark);
     }
 
-    pipelineReflection_.PushPeakLevel("mixed", intermediateBuffer_);
+    pipelineReflection_.PushPeakLevel(mixedSlot_, processingBuffer);
+    stageCounters_.Lap(reflectionTicks, mark);
+
+    stageCounters_.Record(PipelineStages::Mix, mixTicks);
+    stageCounters_.Record(PipelineStages::Reflection, reflectionTicks);
+}
+
+const Buffers::SingleBuffer<PCMTYPE>& Pipeline::ProcessBandOutputs(Buffers::SingleBuffer<PCMTYPE>& processingBuffer)
+{
+    int channelsCount = processingBuffer.Channels();
+    size_t bandsCount = bandProcessors_.size();
+
+    bandOutputsBuffer_.Channels(channelsCount * static_cast<int>(bandsCount));
+    bandOutputsBuffer_.Ensure(processingBuffer.DataLengthSamples());
+
+    StageTicks mixTicks = 0, masterTicks = 0, reflectionTicks = 0;
+    StageTicks mark = stageCounters_.Mark();
+
+    for (size_t bandIndex = 0; bandIndex < bandsCount; bandIndex++)
+    {
+        bool isLastBand = bandIndex + 1 == bandsCount;
+
+        auto& bandBuffer = isLastBand ? processingBuffer : bandBuffer_;
+
+        if (isLastBand == false)
+        {
+            bandBuffer.Copy(processingBuffer);
+            mark = stageCounters_.Lap(mixTicks, mark);
+        }
+
+        bandProcessors_[bandIndex]->Apply(bandBuffer);
+        mark = stageCounters_.Lap(PipelineStages::Band, mark, bandIndex);
+
+        pipelineReflection_.PushPeakLevel(subBandSlots_[bandIndex], bandBuffer);
+        mark = stageCounters_.Lap(reflectionTicks, mark);
+
+        bandMasterProcessors_[bandIndex]->Apply(bandBuffer);
+        mark = stageCounters_.Lap(masterTicks, mark);
+
+        pipelineReflection_.PushPeakLevel(postProcessedBandSlots_[bandIndex], bandBuffer);
+        mark = stageCounters_.Lap(reflectionTicks, mark);
+
+        bandOutputsBuffer_.CopyChannels(bandBuffer, static_cast<int>(bandIndex) * channelsCount);
+        mark = stageCounters_.Lap(mixTicks, mark);
+    }
+
+    bandOutputsBuffer_.DataLengthSamples(processingBuffer.DataLengthSamples());
+
+    stageCounters_.Record(PipelineStages::Mix, mixTicks);
+    stageCounters_.Record(PipelineStages::Master, masterTicks);
+    stageCounters_.Record(PipelineStages::Reflection, reflectionTicks);
+
+    return bandOutputsBuffer_;
+}
+
+void Pipeline::ProcessMaster(Buffers::SingleBuffer<PCMTYPE>& processingBuffer)
+{
+    StageTicks mark = stageCounters_.Mark();
 
     // Master correction
-    masterProcessor_.Push(intermediateBuffer_);
-    pipelineReflection_.PushPeakLevel("postprocessed", masterProcessor_.Pop());
+    masterProcessor_->Apply(processingBuffer);
+    mark = stageCounters_.Lap(PipelineStages::Master, mark);
+
+    pipelineReflection_.PushPeakLevel(postProcessedSlot_, processingBuffer);
+    stageCounters_.Lap(PipelineStages::Reflection, mark);
+}
+
+void Pipeline::Push(const Buffers::SingleBuffer<PCMTYPE>& inputBuffer)
+{
+    StageTicks mark = stageCounters_.Mark();
+
+    PushStages(inputBuffer);
+
+    stageCounters_.Lap(PipelineStages::Push, mark);
+}
+
+void Pipeline::PushStages(const Buffers::SingleBuffer<PCMTYPE>& inputBuffer)
+{
+    pipelineReflection_.CountBlock(inputBuffer.DataLengthSamples());
+
+    if (graph_)
+    {
+        graph_->Push(inputBuffer);
+        return;
+    }
+
+    if (stageScheduler_)
+    {
+        stageScheduler_->Push(inputBuffer);
+
+        float overrunsCount = static_cast<float>(stageScheduler_->OverrunsCount());
+
+        if (overrunsCount != pipelineReflection_.PeekVariable(stageOverrunsSlot_))
+        {
+            pipelineReflection_.PublishVariable(stageOverrunsSlot_, overrunsCount);
+        }
+
+        return;
+    }
+
+    ProcessCorrection(inputBuffer, processingBuffer_);
+
+    if (outputs_ == PipelineOutputs::SubBands)
+    {
+        resultBuffer_ = &ProcessBandOutputs(processingBuffer_);
+        return;
+    }
+
+    ProcessBands(processingBuffer_);
+    ProcessMaster(processingBuffer_);
+
+    resultBuffer_ = &processingBuffer_;
 }
 
 } // namespace Core
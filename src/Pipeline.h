@@ -2,18 +2,30 @@
 
 #include <vector>
 #include <memory>
+#include <string>
 
 #include "PipelineDescription.h"
 #include "FIR/FirCorrector.h"
 #include "PipelineBandProcessor.h"
+#include "PipelineGraph.h"
+#include "PipelineStageScheduler.h"
 #include "Buffers/SingleBuffer.h"
 #include "Reflection/PipelineReflection.h"
+#include "Reflection/StageCounters.h"
 
 #include "Configuration.h"
 
 namespace dePhonica {
 namespace Core {
 
+enum class PipelineOutputs
+{
+    // Sub-bands are mixed and passed through the master processing
+    Mixed = 0,
+    // Every sub-band is an output of its own, master processing is done per sub-band
+    SubBands
+};
+
 class Pipeline
 {
 private:
@@ -21,25 +33,132 @@ private:
 
     PipelineReflection pipelineReflection_;
     
-    PipelineBandProcessor preProcessor_;
+    std::unique_ptr<PipelineBandProcessor> preProcessor_;
     std::vector<std::unique_ptr<PipelineBandProcessor>> bandProcessors_;
-    PipelineBandProcessor masterProcessor_;
+    // Only created when the sub-bands are mixed
+    std::unique_ptr<PipelineBandProcessor> masterProcessor_;
+
+    PipelineOutputs outputs_;
+    // Master processing of every separate sub-band output, a master auto gain binds and publishes per band
+    std::vector<PipelineBandDescription> bandMasterDescriptions_;
+    std::vector<std::unique_ptr<PipelineBandProcessor>> bandMasterProcessors_;
+
+    // Correction, pre-processing, the last sub-band and the master all run in place on this buffer
+    Buffers::SingleBuffer<PCMTYPE> processingBuffer_;
+    // Sum of all the sub-bands but the last one
+    Buffers::SingleBuffer<PCMTYPE> mixBuffer_;
+    Buffers::SingleBuffer<PCMTYPE> bandBuffer_;
+    Buffers::SingleBuffer<PCMTYPE> bandOutputsBuffer_;
+
+    const Buffers::SingleBuffer<PCMTYPE>* resultBuffer_;
+
+    ReflectionSlot inputSlot_, preProcessedSlot_, mixedSlot_, postProcessedSlot_;
+    std::vector<ReflectionSlot> subBandSlots_, postProcessedBandSlots_;
+
+    std::unique_ptr<PipelineStageScheduler> stageScheduler_;
+    // Published as "pipeline.overruns" whenever the scheduler counts one more
+    ReflectionSlot stageOverrunsSlot_;
 
-    Buffers::SingleBuffer<PCMTYPE> intermediateBuffer_;
+    std::unique_ptr<PipelineGraph> graph_;
 
-    void InitProcessings(unsigned sampleRate, const std::vector<PipelineBandDescription>& bandDescriptions);
+    // Only recorded when built with PIPELINE_STAGE_COUNTERS
+    StageCounters stageCounters_;
+
+    static PipelineBandDescription BandMasterDescription(const PipelineBandDescription& masterDescription, size_t bandNumber);
+
+    void InitProcessings(unsigned sampleRate, int channelsCount, const PipelineDescription& pipelineDescription);
+    void InitBindings();
+    void InitStageScheduler(size_t blockSize, size_t maxSamplesCount, int channelsCount);
+
+    // Output may be the input buffer itself
+    void ProcessCorrection(const Buffers::SingleBuffer<PCMTYPE>& inputBuffer, Buffers::SingleBuffer<PCMTYPE>& outputBuffer);
+    // Replaces the pre-processed samples with the mix of the sub-bands
+    void ProcessBands(Buffers::SingleBuffer<PCMTYPE>& processingBuffer);
+    // The pre-processed samples are used up by the last sub-band
+    const Buffers::SingleBuffer<PCMTYPE>& ProcessBandOutputs(Buffers::SingleBuffer<PCMTYPE>& processingBuffer);
+    void ProcessMaster(Buffers::SingleBuffer<PCMTYPE>& processingBuffer);
+
+    void PushStages(const Buffers::SingleBuffer<PCMTYPE>& inputBuffer);
 
 public:
-    Pipeline(unsigned sampleRate, const PipelineDescription& pipelineDescription);
+    Pipeline(unsigned sampleRate, const PipelineDescription& pipelineDescription, PipelineOutputs outputs = PipelineOutputs::Mixed);
     void Push(const Buffers::SingleBuffer<PCMTYPE>& inputBuffer);
 
+    ~Pipeline();
+
+    // Sizes the processing buffers for blocks of up to samplesCount, called at activate to keep run() from allocating
+    void Reserve(size_t samplesCount);
+
+    // Holds OutputsCount() groups of channels, one after another
     const Buffers::SingleBuffer<PCMTYPE>& Pop() const
     {
-        return masterProcessor_.Pop();
+        if (stageScheduler_)
+        {
+            return stageScheduler_->Pop();
+        }
+
+        if (graph_)
+        {
+            return graph_->Pop();
+        }
+
+        return *resultBuffer_;
+    }
+
+    PipelineReflection& Reflection()
+    {
+        return pipelineReflection_;
+    }
+
+    // Per-stage timing, the graph mode only counts the whole Push
+    const StageCounters& Counters() const
+    {
+        return stageCounters_;
+    }
+
+    StageCounters& Counters()
+    {
+        return stageCounters_;
+    }
+
+    size_t OutputsCount() const
+    {
+        if (graph_)
+        {
+            return graph_->OutputsCount();
+        }
+
+        return outputs_ == PipelineOutputs::SubBands ? bandProcessors_.size() : 1;
+    }
+
+    // Offline renders of the pipelined mode wait for late blocks instead of replacing them by silence
+    void Freewheel(bool isFreewheeling)
+    {
+        if (stageScheduler_)
+        {
+            stageScheduler_->Freewheel(isFreewheeling);
+        }
+    }
+
+    // Extra delay introduced by the pipelined mode, the FIR pre-buffering is not included
+    size_t LatencySamples() const
+    {
+        return stageScheduler_ ? stageScheduler_->LatencySamples() : 0;
     }
 
     void Flush()
     {
+        if (graph_)
+        {
+            graph_->Flush();
+            return;
+        }
+
+        if (stageScheduler_)
+        {
+            stageScheduler_->Drain();
+        }
+
         firCorrector_.Flush();
 
         for (auto &bandProcessor : bandProcessors_)
@@ -47,7 +166,20 @@ public:
             bandProcessor->Flush();
         }
 
-        masterProcessor_.Flush();
+        if (masterProcessor_)
+        {
+            masterProcessor_->Flush();
+        }
+
+        for (auto& bandMasterProcessor : bandMasterProcessors_)
+        {
+            bandMasterProcessor->Flush();
+        }
+
+        if (stageScheduler_)
+        {
+            stageScheduler_->Flush();
+        }
     }
 };
 
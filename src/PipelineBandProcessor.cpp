@@ -1,55 +1,133 @@
+#include <type_traits>
+
 #include "PipelineBandProcessor.h"
 
 namespace dePhonica {
 namespace Core {
 
-PipelineBandProcessor::PipelineBandProcessor(unsigned sampleRate,
-                                             const PipelineBandDescription& bandDescription,
-                                             PipelineReflection& pipelineReflection)
-    : isInverted_(bandDescription.IsInverted)
+std::unique_ptr<PipelineBandProcessor> PipelineBandProcessor::Create(unsigned sampleRate,
+                                                                     int channelsCount,
+                                                                     const PipelineBandDescription& bandDescription,
+                                                                     PipelineReflection& pipelineReflection,
+                                                                     const std::string& processorName)
+{
+    switch (bandDescription.SampleType)
+    {
+    case SampleTypes::Double:
+        return std::make_unique<SampleBandProcessor<double>>(sampleRate, channelsCount, bandDescription, pipelineReflection, processorName);
+
+    case SampleTypes::Int32:
+        return std::make_unique<SampleBandProcessor<int32_t>>(sampleRate, channelsCount, bandDescription, pipelineReflection, processorName);
+
+    default:
+        return std::make_unique<SampleBandProcessor<float>>(sampleRate, channelsCount, bandDescription, pipelineReflection, processorName);
+    }
+}
+
+template<typename T>
+SampleBandProcessor<T>::SampleBandProcessor(unsigned sampleRate,
+                                            int channelsCount,
+                                            const PipelineBandDescription& bandDescription,
+                                            PipelineReflection& pipelineReflection,
+                                            const std::string& processorName)
+    : channelsCount_(channelsCount)
+    , isInverted_(bandDescription.IsInverted)
     , autoGainInstance_(sampleRate, bandDescription.AutoGain, pipelineReflection)
+    , pipelineReflection_(pipelineReflection)
+    , isCompressorGainReported_(processorName.empty() == false && bandDescription.Compressors.size() > 0)
+    , compressorGainSlot_(0)
+    , sampleBuffer_(0, channelsCount)
 {
-    InitFilters(sampleRate, bandDescription.IirFilters);
-    InitCompressors(sampleRate, bandDescription.Compressors);
+    InitFilters(sampleRate, channelsCount, bandDescription.IirFilters);
+    InitCompressors(sampleRate, channelsCount, bandDescription.Compressors);
+
+    // Named processors report the overall compressors gain as "<name>.compressorGainDb"
+    if (isCompressorGainReported_)
+    {
+        compressorGainSlot_ = pipelineReflection_.VariableSlot(processorName + ".compressorGainDb");
+    }
 }
 
-void PipelineBandProcessor::InitFilters(unsigned sampleRate, const std::vector<Iir::IirFilterDescription>& filterDescriptions)
+template<typename T>
+void SampleBandProcessor<T>::InitFilters(unsigned sampleRate,
+                                         int channelsCount,
+                                         const std::vector<Iir::IirFilterDescription>& filterDescriptions)
 {
     for (const auto& filterDescription : filterDescriptions)
     {
-        iirFilters_.push_back(std::make_unique<Iir::IirFilter>(sampleRate, filterDescription));
+        iirFilters_.push_back(std::make_unique<Iir::IirFilter>(sampleRate, channelsCount, filterDescription));
     }
 }
 
-void PipelineBandProcessor::InitCompressors(unsigned sampleRate, const std::vector<Dynamics::CompressorDescription>& compressorDescriptions)
+template<typename T>
+void SampleBandProcessor<T>::InitCompressors(unsigned sampleRate,
+                                             int channelsCount,
+                                             const std::vector<Dynamics::CompressorDescription>& compressorDescriptions)
 {
     for (const auto& compressorDescription : compressorDescriptions)
     {
-        compressorInstances_.push_back(std::make_unique<Dynamics::Compressor>(sampleRate, compressorDescription));
+        compressorInstances_.push_back(std::make_unique<Dynamics::Compressor<T>>(sampleRate, channelsCount, compressorDescription));
     }
 }
 
-void PipelineBandProcessor::Push(const Buffers::SingleBuffer<PCMTYPE>& inputBuffer)
+template<typename T>
+void SampleBandProcessor<T>::Reserve(size_t samplesCount)
 {
-    outputBuffer_.Copy(inputBuffer);
+    if (std::is_same<T, PCMTYPE>::value == false)
+    {
+        sampleBuffer_.Channels(channelsCount_);
+        sampleBuffer_.Ensure(samplesCount);
+    }
 
     for (auto& iirFilter : iirFilters_)
     {
-        iirFilter->Apply(outputBuffer_);
+        iirFilter->Reserve<T>(samplesCount);
     }
+}
 
-    for (auto& compressor : compressorInstances_)
+template<typename T>
+void SampleBandProcessor<T>::Apply(Buffers::SingleBuffer<PCMTYPE>& processingBuffer)
+{
+    if constexpr (std::is_same<T, PCMTYPE>::value)
+    {
+        Process(processingBuffer);
+    }
+    else
     {
-        compressor->Apply(outputBuffer_);
+        sampleBuffer_.CopyConverted(processingBuffer);
+        Process(sampleBuffer_);
+        processingBuffer.CopyConverted(sampleBuffer_);
     }
+}
 
-    autoGainInstance_.Apply(outputBuffer_);
+template<typename T>
+void SampleBandProcessor<T>::Process(Buffers::SingleBuffer<T>& processingBuffer)
+{
+    for (auto& iirFilter : iirFilters_)
+    {
+        iirFilter->Apply(processingBuffer);
+    }
 
-    if (isInverted_)
+    double compressorGainDb = 0.0;
+
+    for (auto& compressor : compressorInstances_)
     {
-        outputBuffer_.Invert();
+        compressor->Apply(processingBuffer);
+        compressorGainDb += compressor->BlockGainDb();
     }
+
+    if (isCompressorGainReported_)
+    {
+        pipelineReflection_.SetVariable(compressorGainSlot_, compressorGainDb);
+    }
+
+    // Inversion rides along with the auto gain pass
+    autoGainInstance_.Apply(processingBuffer, isInverted_ ? -1.0f : 1.0f);
 }
 
+template class SampleBandProcessor<float>;
+template class SampleBandProcessor<double>;
+template class SampleBandProcessor<int32_t>;
+
 } // namespace Core
 } // namespace dePhonica
@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <memory>
+#include <string>
 
 #include "PipelineDescription.h"
 #include "IIR/IirFilter.h"
@@ -14,31 +15,63 @@
 namespace dePhonica {
 namespace Core {
 
+// IIR filters, compressors and auto gain of one band, the pipeline hands over PCMTYPE buffers
+// whatever sample type the band processes in
 class PipelineBandProcessor
 {
+public:
+    virtual ~PipelineBandProcessor() = default;
+
+    // Processes the buffer in place
+    virtual void Apply(Buffers::SingleBuffer<PCMTYPE>& processingBuffer) = 0;
+
+    virtual void Flush() = 0;
+
+    // Sizes the conversion buffers for blocks of up to samplesCount
+    virtual void Reserve(size_t samplesCount) = 0;
+
+    // Picks the instantiation matching the band sample type
+    static std::unique_ptr<PipelineBandProcessor> Create(unsigned sampleRate,
+                                                         int channelsCount,
+                                                         const PipelineBandDescription& bandDescription,
+                                                         PipelineReflection& pipelineReflection,
+                                                         const std::string& processorName = "");
+};
+
+// Instantiated for float, double and int32_t samples, other than PCMTYPE blocks are converted in and out
+template<typename T>
+class SampleBandProcessor : public PipelineBandProcessor
+{
 private:
+    int channelsCount_;
     bool isInverted_;
 
     std::vector<std::unique_ptr<Iir::IirFilter>> iirFilters_;
-    std::vector<std::unique_ptr<Dynamics::Compressor>> compressorInstances_;
+    std::vector<std::unique_ptr<Dynamics::Compressor<T>>> compressorInstances_;
+
+    Gain::AutoGain<T> autoGainInstance_;
+
+    PipelineReflection& pipelineReflection_;
+    bool isCompressorGainReported_;
+    ReflectionSlot compressorGainSlot_;
 
-    Gain::AutoGain autoGainInstance_;
+    Buffers::SingleBuffer<T> sampleBuffer_;
 
-    Buffers::SingleBuffer<PCMTYPE> outputBuffer_;
+    void InitFilters(unsigned sampleRate, int channelsCount, const std::vector<Iir::IirFilterDescription>& filterDescriptions);
+    void InitCompressors(unsigned sampleRate, int channelsCount, const std::vector<Dynamics::CompressorDescription>& compressorDescriptions);
 
-    void InitFilters(unsigned sampleRate, const std::vector<Iir::IirFilterDescription>& filterDescriptions);
-    void InitCompressors(unsigned sampleRate, const std::vector<Dynamics::CompressorDescription>& compressorDescriptions);
+    void Process(Buffers::SingleBuffer<T>& processingBuffer);
 
 public:
-    PipelineBandProcessor(unsigned sampleRate, const PipelineBandDescription& bandDescription, PipelineReflection& pipelineReflection);
-    void Push(const Buffers::SingleBuffer<PCMTYPE>& inputBuffer);
+    SampleBandProcessor(unsigned sampleRate,
+                        int channelsCount,
+                        const PipelineBandDescription& bandDescription,
+                        PipelineReflection& pipelineReflection,
+                        const std::string& processorName = "");
 
-    const Buffers::SingleBuffer<PCMTYPE>& Pop() const
-    {
-        return outputBuffer_;
-    }
+    void Apply(Buffers::SingleBuffer<PCMTYPE>& processingBuffer) override;
 
-    void Flush()
+    void Flush() override
     {
         for (auto& iirFilter : iirFilters_)
         {
@@ -50,6 +83,8 @@ public:
             compressor->Flush();
         }
     }
+
+    void Reserve(size_t samplesCount) override;
 };
 
 } // namespace Core
@@ -1,10 +1,14 @@
 #include "PipelineDescription.h"
 
+#include <algorithm>
 #include <fstream>
+#include <iostream>
 #include <locale>
+#include <stdexcept>
 
 #include "JSON/reader.h"
 #include "LogConversions.h"
+#include "PipelineDescriptionBinary.h"
 #include "StringHelpers.h"
 
 namespace dePhonica {
@@ -41,6 +45,11 @@ std::vector<Fir::EnvelopePoint> PipelineDescription::ReadCorrectionEnvelope(cons
 
 const PipelineDescription PipelineDescription::FromFile(std::string descriptionFileName)
 {
+    if (PipelineDescriptionBinary::IsBinaryFile(descriptionFileName))
+    {
+        return PipelineDescriptionBinary::Load(descriptionFileName);
+    }
+
     std::ifstream jsonDescriptionStream(descriptionFileName);
 
     json::Object jsonDescription;
@@ -48,6 +57,11 @@ const PipelineDescription PipelineDescription::FromFile(std::string descriptionF
 
     PipelineDescription pipelineDescription;
 
+    if (jsonDescription.Find("channels") != jsonDescription.End())
+    {
+        pipelineDescription.ChannelsCount = std::max(1, static_cast<int>(static_cast<json::Number>(jsonDescription["channels"])));
+    }
+
     pipelineDescription.InitialSamplesBuffered = static_cast<json::Number>(jsonDescription["initialSamplesBuffered"]);
 
     pipelineDescription.CorrectionGain = Math::LogConversions::DecibelsToValue(
@@ -72,9 +86,148 @@ const PipelineDescription PipelineDescription::FromFile(std::string descriptionF
         pipelineDescription.MasterProcessing = ReadSubBandDescription(jsonDescription["postProcess"]);
     }
 
+    if (jsonDescription.Find("maxBlockSize") != jsonDescription.End())
+    {
+        pipelineDescription.MaxBlockSize = static_cast<json::Number>(jsonDescription["maxBlockSize"]);
+    }
+
+    if (jsonDescription.Find("meteringDecimation") != jsonDescription.End())
+    {
+        pipelineDescription.MeteringDecimation = static_cast<json::Number>(jsonDescription["meteringDecimation"]);
+    }
+
+    if (jsonDescription.Find("loudnessChannels") != jsonDescription.End())
+    {
+        pipelineDescription.LoudnessChannelWeights = ReadLoudnessChannels(static_cast<json::Array&>(jsonDescription["loudnessChannels"]));
+
+        if (pipelineDescription.LoudnessChannelWeights.size() != static_cast<size_t>(pipelineDescription.ChannelsCount))
+        {
+            throw std::invalid_argument("loudnessChannels must name every one of the " +
+                                        std::to_string(pipelineDescription.ChannelsCount) + " channels");
+        }
+    }
+
+    if (jsonDescription.Find("sharedMetersName") != jsonDescription.End())
+    {
+        pipelineDescription.SharedMetersName = static_cast<json::String>(jsonDescription["sharedMetersName"]);
+    }
+
+    if (jsonDescription.Find("spectrumTaps") != jsonDescription.End())
+    {
+        pipelineDescription.SpectrumTaps = ReadSpectrumTaps(static_cast<json::Array&>(jsonDescription["spectrumTaps"]));
+    }
+
+    if (jsonDescription.Find("graph") != jsonDescription.End())
+    {
+        auto& graph = static_cast<json::Object&>(jsonDescription["graph"]);
+
+        if (graph.Find("nodes") != graph.End())
+        {
+            pipelineDescription.GraphNodes = ReadGraphNodes(static_cast<json::Array&>(graph["nodes"]));
+        }
+
+        if (graph.Find("printPlan") != graph.End())
+        {
+            pipelineDescription.IsGraphPlanPrinted = static_cast<json::Boolean>(graph["printPlan"]);
+        }
+    }
+
+    if (jsonDescription.Find("flightRecorder") != jsonDescription.End())
+    {
+        auto& flightRecorder = static_cast<json::Object&>(jsonDescription["flightRecorder"]);
+
+        pipelineDescription.FlightRecorderFile = static_cast<json::String>(flightRecorder["file"]);
+
+        if (flightRecorder.Find("deadlineFraction") != flightRecorder.End())
+        {
+            pipelineDescription.FlightRecorderDeadlineFraction = static_cast<json::Number>(flightRecorder["deadlineFraction"]);
+        }
+
+        if (flightRecorder.Find("blocks") != flightRecorder.End())
+        {
+            pipelineDescription.FlightRecorderBlocks = std::max(1, static_cast<int>(static_cast<json::Number>(flightRecorder["blocks"])));
+        }
+    }
+
+    if (jsonDescription.Find("hostCapture") != jsonDescription.End())
+    {
+        auto& hostCapture = static_cast<json::Object&>(jsonDescription["hostCapture"]);
+
+        pipelineDescription.HostCaptureFile = static_cast<json::String>(hostCapture["file"]);
+
+        if (hostCapture.Find("isAudioCaptured") != hostCapture.End())
+        {
+            pipelineDescription.IsHostAudioCaptured = static_cast<json::Boolean>(hostCapture["isAudioCaptured"]);
+        }
+
+        if (hostCapture.Find("maxSeconds") != hostCapture.End())
+        {
+            pipelineDescription.HostCaptureMaxSeconds = static_cast<json::Number>(hostCapture["maxSeconds"]);
+        }
+    }
+
+    if (jsonDescription.Find("isPipelined") != jsonDescription.End())
+    {
+        pipelineDescription.IsPipelined = static_cast<json::Boolean>(jsonDescription["isPipelined"]);
+    }
+
+    if (jsonDescription.Find("pipelineBlockSize") != jsonDescription.End())
+    {
+        pipelineDescription.PipelineBlockSize = static_cast<json::Number>(jsonDescription["pipelineBlockSize"]);
+    }
+
     return pipelineDescription;
 }
 
+PipelineLayout PipelineDescription::ReadLayout(std::string descriptionFileName)
+{
+    PipelineLayout pipelineLayout;
+
+    try
+    {
+        if (PipelineDescriptionBinary::IsBinaryFile(descriptionFileName))
+        {
+            return PipelineDescriptionBinary::LoadLayout(descriptionFileName);
+        }
+
+        std::ifstream jsonDescriptionStream(descriptionFileName);
+
+        if (jsonDescriptionStream.good() == false)
+        {
+            return pipelineLayout;
+        }
+
+        json::Object jsonDescription;
+        json::Reader::Read(jsonDescription, jsonDescriptionStream);
+
+        if (jsonDescription.Find("channels") != jsonDescription.End())
+        {
+            pipelineLayout.ChannelsCount = std::max(1, static_cast<int>(static_cast<json::Number>(jsonDescription["channels"])));
+        }
+
+        if (jsonDescription.Find("subBands") != jsonDescription.End())
+        {
+            pipelineLayout.SubBandsCount = static_cast<json::Array&>(jsonDescription["subBands"]).Size();
+        }
+
+        if (jsonDescription.Find("graph") != jsonDescription.End())
+        {
+            auto& graph = static_cast<json::Object&>(jsonDescription["graph"]);
+
+            if (graph.Find("nodes") != graph.End())
+            {
+                pipelineLayout.GraphOutputsCount = CountGraphOutputs(static_cast<json::Array&>(graph["nodes"]));
+            }
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Unable to read pipeline layout from " << descriptionFileName << ": " << e.what() << std::endl;
+    }
+
+    return pipelineLayout;
+}
+
 std::vector<PipelineBandDescription> PipelineDescription::ReadBandPipelines(json::Object& jsonDescription)
 {
     std::vector<PipelineBandDescription> subBandProcessings;
@@ -93,6 +246,106 @@ std::vector<PipelineBandDescription> PipelineDescription::ReadBandPipelines(json
     return subBandProcessings;
 }
 
+std::vector<PipelineNodeDescription> PipelineDescription::ReadGraphNodes(json::Array& nodeDescriptions)
+{
+    std::vector<PipelineNodeDescription> graphNodes;
+
+    std::vector<std::string> nodeTypeStrings = { "fir", "band", "mix", "output" };
+
+    for (auto nodeIterator = nodeDescriptions.Begin(); nodeIterator != nodeDescriptions.End(); nodeIterator++)
+    {
+        auto node = static_cast<json::Object>(*nodeIterator);
+
+        PipelineNodeDescription nodeDescription;
+
+        for (auto tokenIterator = node.Begin(); tokenIterator != node.End(); tokenIterator++)
+        {
+            auto& nodeMember = *tokenIterator;
+            auto name = String::toLower(nodeMember.name);
+
+            if (name == "name")
+            {
+                nodeDescription.Name = static_cast<json::String>(nodeMember.element);
+            }
+
+            if (name == "type")
+            {
+                std::string typeString = String::toLower(static_cast<json::String>(nodeMember.element));
+
+                for (size_t n = 0; n < nodeTypeStrings.size(); n++)
+                {
+                    if (nodeTypeStrings[n] == typeString)
+                    {
+                        nodeDescription.NodeType = static_cast<PipelineNodeTypes>(n);
+                        break;
+                    }
+                }
+            }
+
+            if (name == "input")
+            {
+                nodeDescription.Inputs.push_back(static_cast<json::String>(nodeMember.element));
+            }
+
+            if (name == "inputs")
+            {
+                const auto& inputs = static_cast<const json::Array&>(nodeMember.element);
+
+                for (auto inputIterator = inputs.Begin(); inputIterator != inputs.End(); inputIterator++)
+                {
+                    nodeDescription.Inputs.push_back(static_cast<const json::String&>(*inputIterator));
+                }
+            }
+
+            if (name == "initialsamplesbuffered")
+            {
+                nodeDescription.InitialSamplesBuffered = static_cast<json::Number>(nodeMember.element);
+            }
+
+            if (name == "correctiongaindb")
+            {
+                nodeDescription.CorrectionGain = Math::LogConversions::DecibelsToValue(static_cast<json::Number>(nodeMember.element));
+            }
+
+            if (name == "correctionfile")
+            {
+                auto correctionEnvelopeFile = static_cast<std::string>(static_cast<json::String>(nodeMember.element));
+
+                if (correctionEnvelopeFile.length() > 0)
+                {
+                    nodeDescription.CorrectionEnvelope = ReadCorrectionEnvelope(correctionEnvelopeFile);
+                }
+            }
+        }
+
+        if (nodeDescription.NodeType == PipelineNodeTypes::Band)
+        {
+            nodeDescription.Band = ReadSubBandDescription(node);
+        }
+
+        graphNodes.push_back(nodeDescription);
+    }
+
+    return graphNodes;
+}
+
+size_t PipelineDescription::CountGraphOutputs(json::Array& nodeDescriptions)
+{
+    size_t outputsCount = 0;
+
+    for (auto nodeIterator = nodeDescriptions.Begin(); nodeIterator != nodeDescriptions.End(); nodeIterator++)
+    {
+        auto node = static_cast<json::Object>(*nodeIterator);
+
+        if (node.Find("type") != node.End() && String::toLower(static_cast<json::String>(node["type"])) == "output")
+        {
+            outputsCount++;
+        }
+    }
+
+    return outputsCount;
+}
+
 PipelineBandDescription PipelineDescription::ReadSubBandDescription(json::Object subBand)
 {
     PipelineBandDescription bandDescription;
@@ -117,6 +370,21 @@ PipelineBandDescription PipelineDescription::ReadSubBandDescription(json::Object
         ProcessFlags(static_cast<json::String>(subBand["flags"]), bandDescription);
     }
 
+    if (subBand.Find("sampleType") != subBand.End())
+    {
+        std::vector<std::string> sampleTypeStrings = { "float", "double", "int32" };
+        std::string sampleTypeString = String::toLower(static_cast<json::String>(subBand["sampleType"]));
+
+        for (size_t n = 0; n < sampleTypeStrings.size(); n++)
+        {
+            if (sampleTypeStrings[n] == sampleTypeString)
+            {
+                bandDescription.SampleType = static_cast<SampleTypes>(n);
+                break;
+            }
+        }
+    }
+
     return bandDescription;
 }
 
@@ -174,6 +442,98 @@ Gain::AutoGainDescription PipelineDescription::ReadAutoGain(const json::Object&
     return autoGainDescription;
 }
 
+std::vector<float> PipelineDescription::ReadLoudnessChannels(json::Array& loudnessChannels)
+{
+    std::vector<float> channelWeights;
+
+    for (auto channelIterator = loudnessChannels.Begin(); channelIterator != loudnessChannels.End(); channelIterator++)
+    {
+        auto role = String::toLower(static_cast<json::String>(*channelIterator));
+
+        if (role == "front")
+        {
+            channelWeights.push_back(1.0f);
+        }
+        else if (role == "surround")
+        {
+            channelWeights.push_back(1.41f);
+        }
+        else if (role == "lfe")
+        {
+            channelWeights.push_back(0.0f);
+        }
+        else
+        {
+            throw std::invalid_argument("Unknown loudness channel \"" + role + "\", expected front, surround or lfe");
+        }
+    }
+
+    return channelWeights;
+}
+
+std::vector<SpectrumTapDescription> PipelineDescription::ReadSpectrumTaps(json::Array& spectrumTapDescriptions)
+{
+    std::vector<SpectrumTapDescription> spectrumTaps;
+
+    std::vector<std::string> windowTypeStrings = { "square", "hamming", "blackman" };
+
+    for (auto tapIterator = spectrumTapDescriptions.Begin(); tapIterator != spectrumTapDescriptions.End(); tapIterator++)
+    {
+        auto spectrumTap = static_cast<json::Object>(*tapIterator);
+
+        SpectrumTapDescription tapDescription;
+
+        for (auto tokenIterator = spectrumTap.Begin(); tokenIterator != spectrumTap.End(); tokenIterator++)
+        {
+            auto& tapMember = *tokenIterator;
+            auto name = String::toLower(tapMember.name);
+
+            if (name == "binding")
+            {
+                tapDescription.Binding = static_cast<json::String>(tapMember.element);
+            }
+
+            if (name == "fftsize")
+            {
+                tapDescription.FftSize = static_cast<json::Number>(tapMember.element);
+            }
+
+            if (name == "bandsperoctave")
+            {
+                tapDescription.BandsPerOctave = static_cast<json::Number>(tapMember.element);
+            }
+
+            if (name == "averagingms")
+            {
+                tapDescription.AveragingMs = static_cast<json::Number>(tapMember.element);
+            }
+
+            if (name == "window")
+            {
+                std::string windowString = String::toLower(static_cast<json::String>(tapMember.element));
+
+                for (size_t n = 0; n < windowTypeStrings.size(); n++)
+                {
+                    if (windowTypeStrings[n] == windowString)
+                    {
+                        tapDescription.Window = static_cast<Fir::WindowFunctionTypes>(n);
+                        break;
+                    }
+                }
+            }
+        }
+
+        if (tapDescription.FftSize < 256 || (tapDescription.FftSize & (tapDescription.FftSize - 1)) != 0)
+        {
+            throw std::invalid_argument("Spectrum tap \"" + tapDescription.Binding + "\" needs a power of two FFT size of at least 256");
+        }
+
+        spectrumTaps.push_back(tapDescription);
+    }
+
+    return spectrumTaps;
+}
+
 void PipelineDescription::ProcessFlags(std::string flags, PipelineBandDescription& pipelineBandDescription)
 {
     auto flagsLowerCase = String::toLower(flags);
@@ -225,6 +585,11 @@ std::vector<Dynamics::CompressorDescription> PipelineDescription::ReadCompressor
                 compressorDescription.IsUpward = static_cast<json::Boolean>(compressorMember.element);
             }
 
+            if (name == "arechannelslinked")
+            {
+                compressorDescription.AreChannelsLinked = static_cast<json::Boolean>(compressorMember.element);
+            }
+
             if (name == "aresidechainchannelsaveraged")
             {
                 compressorDescription.AreSidechainChannelsAveraged = static_cast<json::Boolean>(compressorMember.element);
@@ -8,35 +8,86 @@
 #include "FIR/EnvelopePoint.h"
 #include "IIR/IirFilterDescription.h"
 #include "Gain/AutoGainDescription.h"
+#include "Reflection/SpectrumTapDescription.h"
 
 #include "Configuration.h"
 
 namespace dePhonica {
 namespace Core {
 
+// Sample type a band processes in, the pipeline itself always runs in PCMTYPE
+enum class SampleTypes
+{
+    Float = 0,
+    Double,
+    Int32
+};
+
 struct PipelineBandDescription
 {
     bool IsInverted = false;
+    SampleTypes SampleType = SampleTypes::Float;
 
     std::vector<Iir::IirFilterDescription> IirFilters;
     std::vector<Dynamics::CompressorDescription> Compressors;
     Gain::AutoGainDescription AutoGain;
 };
 
+enum class PipelineNodeTypes
+{
+    // FIR envelope correction
+    Fir = 0,
+    // IIR filters, compressors and auto gain, same as a sub-band
+    Band,
+    // Sum of the inputs
+    Mix,
+    // Exposes the input as a pipeline output
+    Output
+};
+
+// Vertex of the processing graph, "input" refers to the pipeline input
+struct PipelineNodeDescription
+{
+    std::string Name;
+    PipelineNodeTypes NodeType = PipelineNodeTypes::Band;
+
+    std::vector<std::string> Inputs;
+
+    PipelineBandDescription Band;
+
+    size_t InitialSamplesBuffered = 0;
+    float CorrectionGain = 1.0;
+    std::vector<Fir::EnvelopePoint> CorrectionEnvelope;
+};
+
+// Part of the description that shapes plug-in ports
+struct PipelineLayout
+{
+    int ChannelsCount = 1;
+    size_t SubBandsCount = 0;
+    size_t GraphOutputsCount = 0;
+};
+
 struct PipelineDescription
 {
 private:
     static std::vector<Fir::EnvelopePoint> ReadCorrectionEnvelope(const std::string& fileName);
     static std::vector<PipelineBandDescription> ReadBandPipelines(json::Object& jsonDescription);
+    static std::vector<PipelineNodeDescription> ReadGraphNodes(json::Array& nodeDescriptions);
+    static size_t CountGraphOutputs(json::Array& nodeDescriptions);
 
     static PipelineBandDescription ReadSubBandDescription(json::Object subBand);
     static std::vector<Iir::IirFilterDescription> ReadIirFilters(json::Array& iirFilterDescriptions);
     static std::vector<Dynamics::CompressorDescription> ReadCompressors(json::Array& compressorDescriptions);
     static Gain::AutoGainDescription ReadAutoGain(const json::Object& autoGainJson);
+    static std::vector<SpectrumTapDescription> ReadSpectrumTaps(json::Array& spectrumTapDescriptions);
+    static std::vector<float> ReadLoudnessChannels(json::Array& loudnessChannels);
         
     static void ProcessFlags(std::string flags, PipelineBandDescription& pipelineBandDescription);
 
 public:
+    int ChannelsCount = 1;
+
     size_t InitialSamplesBuffered = 0;
 
     float CorrectionGain = 1.0;
@@ -46,11 +97,57 @@ public:
 
     std::vector<PipelineBandDescription> SubBandProcessings;
 
+    // With sub-bands as separate outputs every band gets a copy, measured after it as "postprocessed1" and so on.
+    // A master auto gain keeps a gain step per band there: a "postprocessed" binding and the gain step variable get the
+    // band number appended ("gain" is published as "gain1", "gain2"...), a "mixed" binding is rejected
     PipelineBandDescription MasterProcessing;
 
     int PeakMonitoringPeriodSeconds = 10;
 
+    // Bindings are measured every Nth block only, trading auto gain reaction time for processing time
+    size_t MeteringDecimation = 1;
+
+    // BS.1770 weight of every channel in loudness bindings: "front" 1.0 (left, right, center), "surround" 1.41 and
+    // "lfe" 0, which leaves it out; empty weighs all channels 1.0, which is only right for mono and stereo
+    std::vector<float> LoudnessChannelWeights;
+
+    // POSIX shared memory segment levels and variables are published to, e.g. "/dephonica-woofer"; empty disables it.
+    // Further instances of the same description publish to "<name>-<pid>-<n>", meterreader --list shows them all
+    std::string SharedMetersName;
+
+    // Band levels of reflection taps, analyzed on a background thread and published as variables
+    std::vector<SpectrumTapDescription> SpectrumTaps;
+
+    // Largest host block the buffers are sized for at activate, longer blocks still work but allocate
+    size_t MaxBlockSize = 4096;
+
+    // When set, replaces the fixed correction - pre-process - sub-bands - post-process topology
+    std::vector<PipelineNodeDescription> GraphNodes;
+    // Execution plan goes to stderr when the pipeline is built, the host owns stdout
+    bool IsGraphPlanPrinted = false;
+
+    // Last blocks are dumped as Chrome trace JSON to "<file>-<n>.json" when a call takes more than the fraction of
+    // its deadline; empty disables the recorder
+    std::string FlightRecorderFile;
+    float FlightRecorderDeadlineFraction = 0.8f;
+    size_t FlightRecorderBlocks = 1024;
+
+    // Host run() sizes and intervals, optionally with the input audio, are captured to this file for capturereplay;
+    // empty disables the capture. It stops after HostCaptureMaxSeconds of audio.
+    std::string HostCaptureFile;
+    bool IsHostAudioCaptured = false;
+    float HostCaptureMaxSeconds = 600;
+
+    // Runs correction, sub-bands and master on separate threads. Adds (stages + 1) * PipelineBlockSize plus the first
+    // host block of latency, stages are 3 or 2 with sub-band outputs; blocks late past that are replaced by silence
+    bool IsPipelined = false;
+    size_t PipelineBlockSize = 256;
+
+    // Takes JSON or a description compiled by configcompiler
     const static PipelineDescription FromFile(std::string descriptionFileName);
+
+    // Used to lay out plug-in ports before any instance exists
+    static PipelineLayout ReadLayout(std::string descriptionFileName);
 };
 
 } // namespace Core
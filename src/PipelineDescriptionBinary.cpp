@@ -0,0 +1,464 @@
+#include "PipelineDescriptionBinary.h"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace dePhonica {
+namespace Core {
+
+namespace {
+
+uint32_t PayloadChecksum(const char* payload, size_t payloadSize)
+{
+    // FNV-1a
+    uint32_t checksum = 2166136261u;
+
+    for (size_t n = 0; n < payloadSize; n++)
+    {
+        checksum = (checksum ^ static_cast<uint8_t>(payload[n])) * 16777619u;
+    }
+
+    return checksum;
+}
+
+// Scalars are stored with fixed widths: bool as 1 byte, enums and int as 4, size_t as 8, floats as they are.
+// Strings and vectors are prefixed by a 4 byte count.
+class BinaryWriter
+{
+private:
+    std::vector<char>& payload_;
+
+    template<typename Stored>
+    void Append(Stored value)
+    {
+        const char* valueBytes = reinterpret_cast<const char*>(&value);
+        payload_.insert(payload_.end(), valueBytes, valueBytes + sizeof(Stored));
+    }
+
+public:
+    explicit BinaryWriter(std::vector<char>& payload)
+        : payload_(payload)
+    {
+    }
+
+    template<typename T>
+    void operator()(const T& value)
+    {
+        if constexpr (std::is_same<T, bool>::value)
+        {
+            Append<uint8_t>(value ? 1 : 0);
+        }
+        else if constexpr (std::is_enum<T>::value || std::is_same<T, int>::value)
+        {
+            Append<int32_t>(static_cast<int32_t>(value));
+        }
+        else if constexpr (std::is_same<T, size_t>::value)
+        {
+            Append<uint64_t>(value);
+        }
+        else
+        {
+            static_assert(std::is_floating_point<T>::value, "Unsupported description field type");
+            Append<T>(value);
+        }
+    }
+
+    void String(const std::string& value)
+    {
+        Append<uint32_t>(static_cast<uint32_t>(value.size()));
+        payload_.insert(payload_.end(), value.begin(), value.end());
+    }
+
+    template<typename Item, typename TransferItem>
+    void Vector(const std::vector<Item>& items, TransferItem transferItem)
+    {
+        Append<uint32_t>(static_cast<uint32_t>(items.size()));
+
+        for (const auto& item : items)
+        {
+            transferItem(item);
+        }
+    }
+};
+
+class BinaryReader
+{
+private:
+    const char* position_;
+    const char* end_;
+
+    template<typename Stored>
+    Stored Take()
+    {
+        Stored value;
+        TakeBytes(&value, sizeof(Stored));
+
+        return value;
+    }
+
+    void TakeBytes(void* target, size_t bytesCount)
+    {
+        if (static_cast<size_t>(end_ - position_) < bytesCount)
+        {
+            throw std::invalid_argument("Compiled description is truncated");
+        }
+
+        memcpy(target, position_, bytesCount);
+        position_ += bytesCount;
+    }
+
+public:
+    BinaryReader(const char* payload, size_t payloadSize)
+        : position_(payload)
+        , end_(payload + payloadSize)
+    {
+    }
+
+    bool IsFinished() const { return position_ == end_; }
+
+    template<typename T>
+    void operator()(T& value)
+    {
+        if constexpr (std::is_same<T, bool>::value)
+        {
+            value = Take<uint8_t>() != 0;
+        }
+        else if constexpr (std::is_enum<T>::value || std::is_same<T, int>::value)
+        {
+            value = static_cast<T>(Take<int32_t>());
+        }
+        else if constexpr (std::is_same<T, size_t>::value)
+        {
+            value = static_cast<size_t>(Take<uint64_t>());
+        }
+        else
+        {
+            static_assert(std::is_floating_point<T>::value, "Unsupported description field type");
+            value = Take<T>();
+        }
+    }
+
+    void String(std::string& value)
+    {
+        uint32_t length = Take<uint32_t>();
+
+        if (static_cast<size_t>(end_ - position_) < length)
+        {
+            throw std::invalid_argument("Compiled description is truncated");
+        }
+
+        value.assign(position_, length);
+        position_ += length;
+    }
+
+    template<typename Item, typename TransferItem>
+    void Vector(std::vector<Item>& items, TransferItem transferItem)
+    {
+        uint32_t itemsCount = Take<uint32_t>();
+
+        // Every item takes at least a byte, which bounds the allocation for corrupted counts
+        if (static_cast<size_t>(end_ - position_) < itemsCount)
+        {
+            throw std::invalid_argument("Compiled description is truncated");
+        }
+
+        items.resize(itemsCount);
+
+        for (auto& item : items)
+        {
+            transferItem(item);
+        }
+    }
+};
+
+// Field order of the payload, shared by the writer and the reader; Description may be const for writing
+
+template<typename Archive, typename Description>
+void TransferEnvelope(Archive& archive, Description& envelopePoints)
+{
+    archive.Vector(envelopePoints, [&](auto& envelopePoint) {
+        archive(envelopePoint.Frequency);
+        archive(envelopePoint.Gain);
+        archive(envelopePoint.Phase);
+    });
+}
+
+template<typename Archive, typename Description>
+void TransferBand(Archive& archive, Description& bandDescription)
+{
+    archive(bandDescription.IsInverted);
+    archive(bandDescription.SampleType);
+
+    archive.Vector(bandDescription.IirFilters, [&](auto& iirFilter) {
+        archive(iirFilter.IsCrossover);
+        archive(iirFilter.FilterType);
+        archive(iirFilter.Order);
+        archive(iirFilter.CenterFrequency);
+        archive(iirFilter.BandWidth);
+        archive(iirFilter.GainDb);
+    });
+
+    archive.Vector(bandDescription.Compressors, [&](auto& compressor) {
+        archive(compressor.SideChainGainDb);
+        archive(compressor.MakeupGainDb);
+        archive(compressor.IsUpward);
+        archive(compressor.IsRmsDetector);
+        archive(compressor.AreSidechainChannelsAveraged);
+        archive(compressor.AreChannelsLinked);
+        archive(compressor.AttackMilliseconds);
+        archive(compressor.ReleaseMilliseconds);
+        archive(compressor.Knee);
+        archive(compressor.ThresholdDb);
+        archive(compressor.Ratio);
+    });
+
+    auto& autoGain = bandDescription.AutoGain;
+
+    archive(autoGain.IsBypassed);
+    archive(autoGain.IsMaster);
+    archive.String(autoGain.Binding);
+    archive.String(autoGain.GainStepVariableName);
+    archive(autoGain.GainIncreaseThresholdDb);
+    archive(autoGain.GainReduceThresholdDb);
+    archive(autoGain.GainStepValueDb);
+    archive(autoGain.MaxGainSteps);
+    archive(autoGain.GainIncreasePeriodMs);
+}
+
+template<typename Archive, typename Description>
+void TransferPipeline(Archive& archive, Description& pipelineDescription)
+{
+    archive(pipelineDescription.ChannelsCount);
+    archive(pipelineDescription.InitialSamplesBuffered);
+    archive(pipelineDescription.CorrectionGain);
+    TransferEnvelope(archive, pipelineDescription.CorrectionEnvelope);
+
+    TransferBand(archive, pipelineDescription.PreProcessing);
+    archive.Vector(pipelineDescription.SubBandProcessings, [&](auto& bandDescription) { TransferBand(archive, bandDescription); });
+    TransferBand(archive, pipelineDescription.MasterProcessing);
+
+    archive(pipelineDescription.PeakMonitoringPeriodSeconds);
+    archive(pipelineDescription.MeteringDecimation);
+    archive.Vector(pipelineDescription.LoudnessChannelWeights, [&](auto& channelWeight) { archive(channelWeight); });
+    archive.String(pipelineDescription.SharedMetersName);
+
+    archive.Vector(pipelineDescription.SpectrumTaps, [&](auto& spectrumTap) {
+        archive.String(spectrumTap.Binding);
+        archive(spectrumTap.FftSize);
+        archive(spectrumTap.BandsPerOctave);
+        archive(spectrumTap.AveragingMs);
+        archive(spectrumTap.Window);
+    });
+
+    archive(pipelineDescription.MaxBlockSize);
+
+    archive.Vector(pipelineDescription.GraphNodes, [&](auto& node) {
+        archive.String(node.Name);
+        archive(node.NodeType);
+        archive.Vector(node.Inputs, [&](auto& input) { archive.String(input); });
+        TransferBand(archive, node.Band);
+        archive(node.InitialSamplesBuffered);
+        archive(node.CorrectionGain);
+        TransferEnvelope(archive, node.CorrectionEnvelope);
+    });
+
+    archive(pipelineDescription.IsGraphPlanPrinted);
+    archive(pipelineDescription.IsPipelined);
+    archive(pipelineDescription.PipelineBlockSize);
+
+    archive.String(pipelineDescription.FlightRecorderFile);
+    archive(pipelineDescription.FlightRecorderDeadlineFraction);
+    archive(pipelineDescription.FlightRecorderBlocks);
+
+    archive.String(pipelineDescription.HostCaptureFile);
+    archive(pipelineDescription.IsHostAudioCaptured);
+    archive(pipelineDescription.HostCaptureMaxSeconds);
+}
+
+class MappedFile
+{
+private:
+    const char* data_;
+    size_t size_;
+
+public:
+    explicit MappedFile(const std::string& fileName)
+        : data_(nullptr)
+        , size_(0)
+    {
+        int fileDescriptor = open(fileName.c_str(), O_RDONLY);
+
+        if (fileDescriptor < 0)
+        {
+            throw std::invalid_argument("Unable to open compiled description " + fileName);
+        }
+
+        struct stat fileStatus;
+
+        if (fstat(fileDescriptor, &fileStatus) == 0 && fileStatus.st_size > 0)
+        {
+            void* mapping = mmap(nullptr, fileStatus.st_size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+
+            if (mapping != MAP_FAILED)
+            {
+                data_ = static_cast<const char*>(mapping);
+                size_ = fileStatus.st_size;
+            }
+        }
+
+        close(fileDescriptor);
+
+        if (data_ == nullptr)
+        {
+            throw std::invalid_argument("Unable to map compiled description " + fileName);
+        }
+    }
+
+    ~MappedFile()
+    {
+        munmap(const_cast<char*>(data_), size_);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* Data() const { return data_; }
+    size_t Size() const { return size_; }
+};
+
+PipelineBinaryHeader ReadHeader(const MappedFile& mappedFile, const std::string& fileName)
+{
+    PipelineBinaryHeader header;
+
+    if (mappedFile.Size() < sizeof(header))
+    {
+        throw std::invalid_argument(fileName + " is not a compiled pipeline description");
+    }
+
+    memcpy(&header, mappedFile.Data(), sizeof(header));
+
+    if (header.Magic != PIPELINE_BINARY_MAGIC)
+    {
+        throw std::invalid_argument(fileName + " is not a compiled pipeline description");
+    }
+
+    if (header.Version != PIPELINE_BINARY_VERSION || header.ByteOrder != PIPELINE_BINARY_BYTE_ORDER)
+    {
+        throw std::invalid_argument(fileName + " was compiled by another version or for another byte order, recompile it");
+    }
+
+    if (header.HeaderSize < sizeof(header) || header.HeaderSize + header.PayloadSize != mappedFile.Size())
+    {
+        throw std::invalid_argument(fileName + " is truncated");
+    }
+
+    return header;
+}
+
+} // namespace
+
+std::vector<char> PipelineDescriptionBinary::Compile(const PipelineDescription& pipelineDescription)
+{
+    std::vector<char> payload;
+    BinaryWriter binaryWriter(payload);
+
+    TransferPipeline(binaryWriter, pipelineDescription);
+
+    PipelineBinaryHeader header = {};
+    header.Magic = PIPELINE_BINARY_MAGIC;
+    header.Version = PIPELINE_BINARY_VERSION;
+    header.ByteOrder = PIPELINE_BINARY_BYTE_ORDER;
+    header.HeaderSize = sizeof(header);
+    header.PayloadSize = payload.size();
+    header.PayloadChecksum = PayloadChecksum(payload.data(), payload.size());
+
+    header.ChannelsCount = pipelineDescription.ChannelsCount;
+    header.SubBandsCount = static_cast<uint32_t>(pipelineDescription.SubBandProcessings.size());
+    header.GraphOutputsCount = 0;
+
+    for (const auto& node : pipelineDescription.GraphNodes)
+    {
+        header.GraphOutputsCount += node.NodeType == PipelineNodeTypes::Output ? 1 : 0;
+    }
+
+    std::vector<char> binaryDescription;
+    binaryDescription.resize(sizeof(header) + payload.size());
+
+    memcpy(binaryDescription.data(), &header, sizeof(header));
+    memcpy(binaryDescription.data() + sizeof(header), payload.data(), payload.size());
+
+    return binaryDescription;
+}
+
+void PipelineDescriptionBinary::WriteFile(const PipelineDescription& pipelineDescription, const std::string& binaryFileName)
+{
+    auto binaryDescription = Compile(pipelineDescription);
+
+    std::ofstream binaryStream(binaryFileName, std::ios::binary | std::ios::trunc);
+    binaryStream.write(binaryDescription.data(), binaryDescription.size());
+
+    if (binaryStream.good() == false)
+    {
+        throw std::invalid_argument("Unable to write compiled description " + binaryFileName);
+    }
+}
+
+bool PipelineDescriptionBinary::IsBinaryFile(const std::string& fileName)
+{
+    std::ifstream fileStream(fileName, std::ios::binary);
+
+    uint32_t magic = 0;
+    fileStream.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+
+    return fileStream.good() && magic == PIPELINE_BINARY_MAGIC;
+}
+
+PipelineDescription PipelineDescriptionBinary::Load(const std::string& binaryFileName)
+{
+    MappedFile mappedFile(binaryFileName);
+
+    auto header = ReadHeader(mappedFile, binaryFileName);
+
+    const char* payload = mappedFile.Data() + header.HeaderSize;
+
+    if (PayloadChecksum(payload, header.PayloadSize) != header.PayloadChecksum)
+    {
+        throw std::invalid_argument(binaryFileName + " is corrupted, checksum mismatch");
+    }
+
+    PipelineDescription pipelineDescription;
+    BinaryReader binaryReader(payload, header.PayloadSize);
+
+    TransferPipeline(binaryReader, pipelineDescription);
+
+    if (binaryReader.IsFinished() == false)
+    {
+        throw std::invalid_argument(binaryFileName + " has trailing data");
+    }
+
+    return pipelineDescription;
+}
+
+PipelineLayout PipelineDescriptionBinary::LoadLayout(const std::string& binaryFileName)
+{
+    MappedFile mappedFile(binaryFileName);
+
+    auto header = ReadHeader(mappedFile, binaryFileName);
+
+    PipelineLayout pipelineLayout;
+    pipelineLayout.ChannelsCount = header.ChannelsCount;
+    pipelineLayout.SubBandsCount = header.SubBandsCount;
+    pipelineLayout.GraphOutputsCount = header.GraphOutputsCount;
+
+    return pipelineLayout;
+}
+
+} // namespace Core
+} // namespace dePhonica
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "PipelineDescription.h"
+
+#include "Configuration.h"
+
+// "DPHB" in a little endian file
+#define PIPELINE_BINARY_MAGIC           0x42485044
+#define PIPELINE_BINARY_VERSION         5
+#define PIPELINE_BINARY_BYTE_ORDER      0x01020304
+
+namespace dePhonica {
+namespace Core {
+
+// Fixed header at the start of a compiled description, the layout is readable without touching the payload
+struct PipelineBinaryHeader
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t ByteOrder;
+    uint32_t HeaderSize;
+
+    uint64_t PayloadSize;
+    uint32_t PayloadChecksum;
+
+    int32_t ChannelsCount;
+    uint32_t SubBandsCount;
+    uint32_t GraphOutputsCount;
+};
+
+// Compiled pipeline description: validated once, defaults applied and the correction envelopes embedded,
+// loaded with a single mmap and a sequential read of fixed width fields. Files are native endian,
+// so compile on the same kind of machine that loads them.
+class PipelineDescriptionBinary
+{
+public:
+    static std::vector<char> Compile(const PipelineDescription& pipelineDescription);
+
+    static void WriteFile(const PipelineDescription& pipelineDescription, const std::string& binaryFileName);
+
+    // True when the file starts with the compiled description magic, whatever its version
+    static bool IsBinaryFile(const std::string& fileName);
+
+    static PipelineDescription Load(const std::string& binaryFileName);
+
+    static PipelineLayout LoadLayout(const std::string& binaryFileName);
+};
+
+} // namespace Core
+} // namespace dePhonica
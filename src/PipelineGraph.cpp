@@ -0,0 +1,500 @@
+#include "PipelineGraph.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <stdexcept>
+
+namespace dePhonica {
+namespace Core {
+
+const int PipelineGraph::PipelineInput;
+
+PipelineGraph::PipelineGraph(unsigned sampleRate,
+                             int channelsCount,
+                             const std::vector<PipelineNodeDescription>& nodeDescriptions,
+                             PipelineReflection& pipelineReflection)
+    : pipelineReflection_(pipelineReflection)
+    , inputSlot_(0)
+    , inputBuffer_(nullptr)
+    , outputBuffer_(&outputsBuffer_)
+    , mixBuffer_(0, channelsCount)
+    , outputsBuffer_(0, channelsCount)
+{
+    Compile(sampleRate, channelsCount, nodeDescriptions);
+    AssignBuffers(channelsCount);
+}
+
+void PipelineGraph::Compile(unsigned sampleRate, int channelsCount, const std::vector<PipelineNodeDescription>& nodeDescriptions)
+{
+    size_t nodesCount = nodeDescriptions.size();
+
+    std::map<std::string, size_t> nodeIndexes;
+
+    for (size_t n = 0; n < nodesCount; n++)
+    {
+        const auto& name = nodeDescriptions[n].Name;
+
+        if (name.empty() || name == "input")
+        {
+            throw std::invalid_argument("Graph node #" + std::to_string(n + 1) + " needs a name other than \"input\"");
+        }
+
+        if (nodeIndexes.find(name) != nodeIndexes.end())
+        {
+            throw std::invalid_argument("Graph node \"" + name + "\" is declared twice");
+        }
+
+        nodeIndexes[name] = n;
+    }
+
+    // Declaration indexes of the nodes every node feeds, inputs from other nodes are counted per node
+    std::vector<std::vector<size_t>> consumers(nodesCount);
+    std::vector<size_t> pendingInputs(nodesCount, 0);
+
+    for (size_t n = 0; n < nodesCount; n++)
+    {
+        const auto& nodeDescription = nodeDescriptions[n];
+        size_t inputsCount = nodeDescription.Inputs.size();
+
+        if (inputsCount == 0 || (inputsCount > 1 && nodeDescription.NodeType != PipelineNodeTypes::Mix))
+        {
+            throw std::invalid_argument("Graph node \"" + nodeDescription.Name + "\" has " + std::to_string(inputsCount)
+                                        + " inputs, only mix nodes take more than one");
+        }
+
+        for (const auto& inputName : nodeDescription.Inputs)
+        {
+            if (inputName == "input")
+            {
+                continue;
+            }
+
+            auto inputIterator = nodeIndexes.find(inputName);
+
+            if (inputIterator == nodeIndexes.end())
+            {
+                throw std::invalid_argument("Graph node \"" + nodeDescription.Name + "\" refers to unknown node \"" + inputName + "\"");
+            }
+
+            if (nodeDescriptions[inputIterator->second].NodeType == PipelineNodeTypes::Output)
+            {
+                throw std::invalid_argument("Output node \"" + inputName + "\" can not feed other nodes");
+            }
+
+            consumers[inputIterator->second].push_back(n);
+            pendingInputs[n]++;
+        }
+    }
+
+    inputSlot_ = pipelineReflection_.PeakLevelSlot("input");
+
+    // Kahn's algorithm, declaration order breaks the ties so the plan follows the description where possible
+    std::set<size_t> readyNodes;
+    std::vector<size_t> sortedNodes;
+
+    for (size_t n = 0; n < nodesCount; n++)
+    {
+        if (pendingInputs[n] == 0)
+        {
+            readyNodes.insert(n);
+        }
+    }
+
+    while (readyNodes.empty() == false)
+    {
+        size_t nodeIndex = *readyNodes.begin();
+        readyNodes.erase(readyNodes.begin());
+
+        sortedNodes.push_back(nodeIndex);
+
+        for (size_t consumer : consumers[nodeIndex])
+        {
+            if (--pendingInputs[consumer] == 0)
+            {
+                readyNodes.insert(consumer);
+            }
+        }
+    }
+
+    if (sortedNodes.size() < nodesCount)
+    {
+        throw std::invalid_argument("Graph has a cycle");
+    }
+
+    // Output nodes only name their sources, everything else gets scheduled
+    std::vector<int> scheduleIndexes(nodesCount, PipelineInput);
+
+    for (size_t nodeIndex : sortedNodes)
+    {
+        const auto& nodeDescription = nodeDescriptions[nodeIndex];
+
+        if (nodeDescription.NodeType == PipelineNodeTypes::Output)
+        {
+            continue;
+        }
+
+        Node node;
+        node.Description = &nodeDescription;
+
+        for (const auto& inputName : nodeDescription.Inputs)
+        {
+            node.Inputs.push_back(inputName == "input" ? PipelineInput : scheduleIndexes[nodeIndexes[inputName]]);
+        }
+
+        switch (nodeDescription.NodeType)
+        {
+        case PipelineNodeTypes::Fir:
+            node.Corrector = std::make_unique<Fir::FirCorrector>(sampleRate, channelsCount, nodeDescription.CorrectionEnvelope,
+                nodeDescription.CorrectionGain, nodeDescription.InitialSamplesBuffered);
+            break;
+
+        case PipelineNodeTypes::Band:
+            node.BandProcessor = PipelineBandProcessor::Create(sampleRate, channelsCount, nodeDescription.Band, pipelineReflection_,
+                nodeDescription.Name);
+            break;
+
+        case PipelineNodeTypes::Mix:
+            node.InputsAligner = std::make_unique<Buffers::StreamAligner<PCMTYPE>>(node.Inputs.size(), channelsCount);
+            break;
+
+        default:
+            break;
+        }
+
+        node.LevelSlot = pipelineReflection_.PeakLevelSlot(nodeDescription.Name);
+
+        scheduleIndexes[nodeIndex] = static_cast<int>(schedule_.size());
+        schedule_.push_back(std::move(node));
+    }
+
+    for (const auto& nodeDescription : nodeDescriptions)
+    {
+        if (nodeDescription.NodeType == PipelineNodeTypes::Output)
+        {
+            const auto& inputName = nodeDescription.Inputs[0];
+
+            outputSources_.push_back(inputName == "input" ? PipelineInput : scheduleIndexes[nodeIndexes[inputName]]);
+            outputNames_.push_back(nodeDescription.Name);
+        }
+    }
+
+    if (outputSources_.empty())
+    {
+        throw std::invalid_argument("Graph has no output nodes");
+    }
+
+    if (outputSources_.size() > 1)
+    {
+        outputsAligner_ = std::make_unique<Buffers::StreamAligner<PCMTYPE>>(outputSources_.size(), channelsCount);
+    }
+}
+
+void PipelineGraph::AssignBuffers(int channelsCount)
+{
+    size_t scheduleEnd = schedule_.size();
+
+    // Schedule index of the last node reading every node output, outputs of the graph stay alive till the end
+    std::vector<size_t> lastUses(scheduleEnd);
+
+    for (size_t t = 0; t < scheduleEnd; t++)
+    {
+        lastUses[t] = t;
+
+        for (int input : schedule_[t].Inputs)
+        {
+            if (input != PipelineInput)
+            {
+                lastUses[input] = std::max(lastUses[input], t);
+            }
+        }
+    }
+
+    for (int outputSource : outputSources_)
+    {
+        if (outputSource != PipelineInput)
+        {
+            lastUses[outputSource] = scheduleEnd;
+        }
+    }
+
+    std::vector<int> freeBuffers;
+    int buffersCount = 0;
+
+    for (size_t t = 0; t < scheduleEnd; t++)
+    {
+        auto& node = schedule_[t];
+        int firstInput = node.Inputs[0];
+
+        // The last reader of a buffer may overwrite it, unless it reads the same buffer once more for mixing
+        bool isFirstInputRepeated = std::count(node.Inputs.begin(), node.Inputs.end(), firstInput) > 1;
+
+        if (firstInput != PipelineInput && lastUses[firstInput] == t && isFirstInputRepeated == false)
+        {
+            node.BufferIndex = schedule_[firstInput].BufferIndex;
+            node.IsInPlace = true;
+        }
+        else if (freeBuffers.empty() == false)
+        {
+            node.BufferIndex = freeBuffers.back();
+            freeBuffers.pop_back();
+        }
+        else
+        {
+            node.BufferIndex = buffersCount++;
+        }
+
+        std::vector<int> releasedSources = node.Inputs;
+
+        if (lastUses[t] == t)
+        {
+            // Nobody reads this node, it is only run for metering and gain tracking
+            releasedSources.push_back(static_cast<int>(t));
+        }
+
+        for (int source : releasedSources)
+        {
+            if (source == PipelineInput || lastUses[source] != t)
+            {
+                continue;
+            }
+
+            int bufferIndex = schedule_[source].BufferIndex;
+
+            if ((bufferIndex != node.BufferIndex || source == static_cast<int>(t))
+                && std::find(freeBuffers.begin(), freeBuffers.end(), bufferIndex) == freeBuffers.end())
+            {
+                freeBuffers.push_back(bufferIndex);
+            }
+        }
+    }
+
+    for (int n = 0; n < buffersCount; n++)
+    {
+        buffers_.push_back(std::make_unique<Buffers::SingleBuffer<PCMTYPE>>(0, channelsCount));
+    }
+}
+
+std::string PipelineGraph::DescribePlan() const
+{
+    std::vector<std::string> nodeTypeStrings = { "fir", "band", "mix", "output" };
+
+    auto sourceName = [this](int source) { return source == PipelineInput ? std::string("input") : schedule_[source].Description->Name; };
+
+    std::string plan = "Pipeline graph: " + std::to_string(schedule_.size()) + " nodes, " + std::to_string(BuffersCount()) + " buffers\n";
+
+    for (size_t t = 0; t < schedule_.size(); t++)
+    {
+        const auto& node = schedule_[t];
+
+        plan += "  " + std::to_string(t) + ". " + node.Description->Name + " (" + nodeTypeStrings[static_cast<int>(node.Description->NodeType)]
+                + ") <- ";
+
+        for (size_t n = 0; n < node.Inputs.size(); n++)
+        {
+            plan += (n > 0 ? ", " : "") + sourceName(node.Inputs[n]);
+        }
+
+        plan += " => buffer " + std::to_string(node.BufferIndex) + (node.IsInPlace ? " (in place)" : "") + "\n";
+    }
+
+    for (size_t n = 0; n < outputSources_.size(); n++)
+    {
+        plan += "  output " + std::to_string(n + 1) + ". " + outputNames_[n] + " <- " + sourceName(outputSources_[n]) + "\n";
+    }
+
+    return plan;
+}
+
+void PipelineGraph::Reserve(size_t samplesCount)
+{
+    for (auto& buffer : buffers_)
+    {
+        buffer->Ensure(samplesCount);
+    }
+
+    mixBuffer_.Ensure(samplesCount);
+
+    for (auto& node : schedule_)
+    {
+        if (node.BandProcessor)
+        {
+            node.BandProcessor->Reserve(samplesCount);
+        }
+    }
+
+    if (outputSources_.size() > 1)
+    {
+        outputsBuffer_.Channels(mixBuffer_.Channels() * static_cast<int>(outputSources_.size()));
+        outputsBuffer_.Ensure(samplesCount);
+    }
+}
+
+void PipelineGraph::Push(const Buffers::SingleBuffer<PCMTYPE>& inputBuffer)
+{
+    inputBuffer_ = &inputBuffer;
+
+    pipelineReflection_.PushPeakLevel(inputSlot_, inputBuffer);
+
+    for (auto& node : schedule_)
+    {
+        ProcessNode(node);
+    }
+
+    CollectOutputs();
+}
+
+void PipelineGraph::ProcessNode(Node& node)
+{
+    auto& outputBuffer = *buffers_[node.BufferIndex];
+    const auto& inputBuffer = NodeOutput(node.Inputs[0]);
+
+    switch (node.Description->NodeType)
+    {
+    case PipelineNodeTypes::Fir:
+        node.Corrector->Process(inputBuffer, outputBuffer);
+        break;
+
+    case PipelineNodeTypes::Band:
+        if (node.IsInPlace == false)
+        {
+            outputBuffer.Copy(inputBuffer);
+        }
+
+        node.BandProcessor->Apply(outputBuffer);
+        break;
+
+    case PipelineNodeTypes::Mix:
+        ProcessMix(node, outputBuffer);
+        break;
+
+    default:
+        break;
+    }
+
+    pipelineReflection_.PushPeakLevel(node.LevelSlot, outputBuffer);
+}
+
+void PipelineGraph::ProcessMix(Node& node, Buffers::SingleBuffer<PCMTYPE>& outputBuffer)
+{
+    const auto& firstBuffer = NodeOutput(node.Inputs[0]);
+    size_t inputsCount = node.Inputs.size();
+
+    bool isAligned = node.InputsAligner->IsEmpty();
+
+    for (size_t n = 1; n < inputsCount && isAligned; n++)
+    {
+        isAligned = NodeOutput(node.Inputs[n]).DataLengthSamples() == firstBuffer.DataLengthSamples();
+    }
+
+    if (isAligned)
+    {
+        // Every branch delivered the same amount of samples, so there is nothing to line up
+        if (node.IsInPlace == false)
+        {
+            outputBuffer.Copy(firstBuffer);
+        }
+
+        for (size_t n = 1; n < inputsCount; n++)
+        {
+            outputBuffer.Mix(NodeOutput(node.Inputs[n]));
+        }
+
+        return;
+    }
+
+    for (size_t n = 0; n < inputsCount; n++)
+    {
+        node.InputsAligner->Push(n, NodeOutput(node.Inputs[n]));
+    }
+
+    size_t samplesCount = node.InputsAligner->AvailableSamples();
+
+    outputBuffer.SampleRate(firstBuffer.SampleRate());
+    node.InputsAligner->Pop(0, outputBuffer, 0, samplesCount);
+    outputBuffer.DataLengthSamples(samplesCount);
+
+    for (size_t n = 1; n < inputsCount; n++)
+    {
+        node.InputsAligner->Pop(n, mixBuffer_, 0, samplesCount);
+        mixBuffer_.DataLengthSamples(samplesCount);
+
+        outputBuffer.Mix(mixBuffer_);
+    }
+}
+
+void PipelineGraph::CollectOutputs()
+{
+    if (outputSources_.size() == 1)
+    {
+        outputBuffer_ = &NodeOutput(outputSources_[0]);
+        return;
+    }
+
+    int channelsCount = inputBuffer_->Channels();
+    size_t outputsCount = outputSources_.size();
+
+    outputsBuffer_.Channels(channelsCount * static_cast<int>(outputsCount));
+    outputsBuffer_.SampleRate(inputBuffer_->SampleRate());
+    outputBuffer_ = &outputsBuffer_;
+
+    bool isAligned = outputsAligner_->IsEmpty();
+
+    for (size_t n = 1; n < outputsCount && isAligned; n++)
+    {
+        isAligned = NodeOutput(outputSources_[n]).DataLengthSamples() == NodeOutput(outputSources_[0]).DataLengthSamples();
+    }
+
+    if (isAligned)
+    {
+        for (size_t n = 0; n < outputsCount; n++)
+        {
+            outputsBuffer_.CopyChannels(NodeOutput(outputSources_[n]), static_cast<int>(n) * channelsCount);
+        }
+
+        return;
+    }
+
+    for (size_t n = 0; n < outputsCount; n++)
+    {
+        outputsAligner_->Push(n, NodeOutput(outputSources_[n]));
+    }
+
+    size_t samplesCount = outputsAligner_->AvailableSamples();
+
+    for (size_t n = 0; n < outputsCount; n++)
+    {
+        outputsAligner_->Pop(n, outputsBuffer_, static_cast<int>(n) * channelsCount, samplesCount);
+    }
+
+    outputsBuffer_.DataLengthSamples(samplesCount);
+}
+
+void PipelineGraph::Flush()
+{
+    for (auto& node : schedule_)
+    {
+        if (node.Corrector)
+        {
+            node.Corrector->Flush();
+        }
+
+        if (node.BandProcessor)
+        {
+            node.BandProcessor->Flush();
+        }
+
+        if (node.InputsAligner)
+        {
+            node.InputsAligner->Flush();
+        }
+    }
+
+    if (outputsAligner_)
+    {
+        outputsAligner_->Flush();
+    }
+}
+
+} // namespace Core
+} // namespace dePhonica
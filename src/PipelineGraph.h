@@ -0,0 +1,99 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "PipelineDescription.h"
+#include "FIR/FirCorrector.h"
+#include "PipelineBandProcessor.h"
+#include "Buffers/SingleBuffer.h"
+#include "Buffers/StreamAligner.h"
+#include "Reflection/PipelineReflection.h"
+
+#include "Configuration.h"
+
+namespace dePhonica {
+namespace Core {
+
+// Processing graph compiled from the node descriptions at instantiate.
+// Nodes run in topological order; intermediate buffers are shared between nodes whose outputs are never alive
+// at the same time and a node processes in place when it is the last consumer of its input.
+class PipelineGraph
+{
+private:
+    // Input index referring to the pipeline input rather than to a node
+    static const int PipelineInput = -1;
+
+    struct Node
+    {
+        const PipelineNodeDescription* Description = nullptr;
+
+        // Schedule indexes of the input nodes
+        std::vector<int> Inputs;
+
+        ReflectionSlot LevelSlot = 0;
+
+        int BufferIndex = -1;
+        bool IsInPlace = false;
+
+        std::unique_ptr<Fir::FirCorrector> Corrector;
+        std::unique_ptr<PipelineBandProcessor> BandProcessor;
+        std::unique_ptr<Buffers::StreamAligner<PCMTYPE>> InputsAligner;
+    };
+
+    PipelineReflection& pipelineReflection_;
+    ReflectionSlot inputSlot_;
+
+    std::vector<Node> schedule_;
+    std::vector<std::unique_ptr<Buffers::SingleBuffer<PCMTYPE>>> buffers_;
+
+    // Schedule indexes feeding the output nodes, in the order of declaration
+    std::vector<int> outputSources_;
+    std::vector<std::string> outputNames_;
+
+    const Buffers::SingleBuffer<PCMTYPE>* inputBuffer_;
+    const Buffers::SingleBuffer<PCMTYPE>* outputBuffer_;
+
+    Buffers::SingleBuffer<PCMTYPE> mixBuffer_;
+    Buffers::SingleBuffer<PCMTYPE> outputsBuffer_;
+    std::unique_ptr<Buffers::StreamAligner<PCMTYPE>> outputsAligner_;
+
+    void Compile(unsigned sampleRate, int channelsCount, const std::vector<PipelineNodeDescription>& nodeDescriptions);
+    void AssignBuffers(int channelsCount);
+
+    const Buffers::SingleBuffer<PCMTYPE>& NodeOutput(int scheduleIndex) const
+    {
+        return scheduleIndex == PipelineInput ? *inputBuffer_ : *buffers_[schedule_[scheduleIndex].BufferIndex];
+    }
+
+    void ProcessNode(Node& node);
+    void ProcessMix(Node& node, Buffers::SingleBuffer<PCMTYPE>& outputBuffer);
+    void CollectOutputs();
+
+public:
+    // Throws std::invalid_argument when the graph is malformed
+    PipelineGraph(unsigned sampleRate,
+                  int channelsCount,
+                  const std::vector<PipelineNodeDescription>& nodeDescriptions,
+                  PipelineReflection& pipelineReflection);
+
+    void Push(const Buffers::SingleBuffer<PCMTYPE>& inputBuffer);
+
+    void Reserve(size_t samplesCount);
+
+    // Holds OutputsCount() groups of channels, one after another
+    const Buffers::SingleBuffer<PCMTYPE>& Pop() const { return *outputBuffer_; }
+
+    size_t OutputsCount() const { return outputSources_.size(); }
+
+    size_t BuffersCount() const { return buffers_.size(); }
+
+    // Node order and buffer assignments, one node per line
+    std::string DescribePlan() const;
+
+    void Flush();
+};
+
+} // namespace Core
+} // namespace dePhonica
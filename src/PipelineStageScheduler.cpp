@@ -0,0 +1,385 @@
+#include "PipelineStageScheduler.h"
+
+#include <algorithm>
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace dePhonica {
+namespace Core {
+
+static size_t StageSchedulerInitBufferSize = 65536 * 2;
+
+PipelineStageScheduler::PipelineStageScheduler(size_t blockSize,
+                                               size_t maxSamplesCount,
+                                               int inputChannelsCount,
+                                               int outputChannelsCount,
+                                               const std::vector<StageFunction>& stageFunctions)
+    : blockSize_(blockSize)
+    , completedQueue_(stageFunctions.size() + 2 + (maxSamplesCount + blockSize - 1) / blockSize)
+    , blocksInFlight_(0)
+    , isStopping_(false)
+    , stagePriority_(0)
+    , isFreewheeling_(false)
+    , latencySamples_(0)
+    , overrunsCount_(0)
+    , pushedSamples_(0)
+    , collectPosition_(0)
+    , resultPosition_(0)
+    , outputPosition_(0)
+    , heldBackSamples_(0)
+    , collectBuffers_(inputChannelsCount, Buffers::RingBuffer<PCMTYPE>(StageSchedulerInitBufferSize))
+    , resultBuffers_(outputChannelsCount, Buffers::RingBuffer<PCMTYPE>(StageSchedulerInitBufferSize))
+    , outputBuffer_(0, outputChannelsCount)
+{
+    // Blocks stay out from submission until output, that is the latency plus a host block
+    for (size_t n = 0; n < completedQueue_.Capacity(); n++)
+    {
+        blockPool_.push_back(std::make_unique<Block>(blockSize_, std::max(inputChannelsCount, outputChannelsCount)));
+        freeBlocks_.push_back(blockPool_.back().get());
+    }
+
+    for (const auto& stageFunction : stageFunctions)
+    {
+        auto stage = std::make_unique<Stage>();
+        stage->Process = stageFunction;
+        stage->InputQueue = std::make_unique<BlockQueue>(blockPool_.size());
+
+        stages_.push_back(std::move(stage));
+    }
+
+    for (size_t stageIndex = 0; stageIndex < stages_.size(); stageIndex++)
+    {
+        stages_[stageIndex]->Worker = std::thread(&PipelineStageScheduler::RunStage, this, stageIndex);
+    }
+
+    Flush();
+}
+
+PipelineStageScheduler::~PipelineStageScheduler()
+{
+    isStopping_ = true;
+
+    for (auto& stage : stages_)
+    {
+        stage->InputSignal.Post();
+    }
+
+    for (auto& stage : stages_)
+    {
+        stage->Worker.join();
+    }
+}
+
+void PipelineStageScheduler::RunStage(size_t stageIndex)
+{
+    auto& stage = *stages_[stageIndex];
+    int appliedPriority = 0;
+
+    while (true)
+    {
+        stage.InputSignal.Wait();
+
+        if (isStopping_)
+        {
+            return;
+        }
+
+        int stagePriority = stagePriority_.load(std::memory_order_relaxed);
+
+        if (stagePriority != appliedPriority)
+        {
+            appliedPriority = stagePriority;
+
+            // Without the rights to raise it the thread quietly stays at the default policy
+            sched_param schedulingParameters = {};
+            schedulingParameters.sched_priority = stagePriority;
+            pthread_setschedparam(pthread_self(), SCHED_FIFO, &schedulingParameters);
+        }
+
+        Block* block;
+        if (stage.InputQueue->TryPop(block) == false)
+        {
+            continue;
+        }
+
+        stage.Process(block->Buffer);
+
+        if (stageIndex + 1 < stages_.size())
+        {
+            auto& nextStage = *stages_[stageIndex + 1];
+            nextStage.InputQueue->TryPush(block);
+            nextStage.InputSignal.Post();
+        }
+        else
+        {
+            completedQueue_.TryPush(block);
+            completedSignal_.Post();
+        }
+    }
+}
+
+void PipelineStageScheduler::CheckHostPriority()
+{
+    int policy = sched_getscheduler(0);
+
+    if (policy != SCHED_FIFO && policy != SCHED_RR)
+    {
+        return;
+    }
+
+    sched_param schedulingParameters = {};
+
+    if (sched_getparam(0, &schedulingParameters) == 0)
+    {
+        // Just below the host so the stages never preempt the thread waiting for them
+        stagePriority_ = std::max(schedulingParameters.sched_priority - 1, sched_get_priority_min(SCHED_FIFO));
+    }
+}
+
+void PipelineStageScheduler::SubmitBlock(Block* block)
+{
+    blocksInFlight_++;
+
+    stages_[0]->InputQueue->TryPush(block);
+    stages_[0]->InputSignal.Post();
+}
+
+void PipelineStageScheduler::CollectBlocks()
+{
+    Block* block;
+
+    while (completedQueue_.TryPop(block))
+    {
+        // Keeps the count bounded, Drain tolerates the posts that are left over
+        completedSignal_.TryWait();
+
+        StoreResult(block);
+    }
+}
+
+void PipelineStageScheduler::WaitForBlock()
+{
+    completedSignal_.Wait();
+    CollectBlocks();
+}
+
+void PipelineStageScheduler::StoreResult(Block* block)
+{
+    size_t resultStart = block->Position - heldBackSamples_;
+    size_t resultEnd = resultPosition_ + resultBuffers_[0].DataLengthSamples();
+
+    // Input dropped after an overrun leaves a gap, whatever comes before it is past due
+    if (resultStart != resultEnd)
+    {
+        for (auto& resultBuffer : resultBuffers_)
+        {
+            resultBuffer.Flush();
+        }
+
+        resultPosition_ = resultStart;
+    }
+
+    for (size_t channel = 0; channel < resultBuffers_.size(); channel++)
+    {
+        resultBuffers_[channel].Push(block->Buffer.ChannelDataConst(channel), block->Buffer.DataLengthSamples());
+    }
+
+    // Stages holding samples back, like the FIR pre-buffering, shorten the stream from this block on
+    heldBackSamples_ += blockSize_ - block->Buffer.DataLengthSamples();
+
+    freeBlocks_.push_back(block);
+    blocksInFlight_--;
+}
+
+size_t PipelineStageScheduler::DueLength() const
+{
+    size_t dueEnd = outputPosition_ + latencySamples_ + heldBackSamples_;
+
+    return pushedSamples_ > dueEnd ? pushedSamples_ - dueEnd : 0;
+}
+
+void PipelineStageScheduler::PopResult(size_t resultLength)
+{
+    // Results that came back late have already been replaced by silence
+    if (resultPosition_ < outputPosition_)
+    {
+        size_t purgedLength = 0;
+
+        for (auto& resultBuffer : resultBuffers_)
+        {
+            purgedLength = resultBuffer.Purge(outputPosition_ - resultPosition_);
+        }
+
+        resultPosition_ += purgedLength;
+    }
+
+    size_t silenceLength = resultPosition_ > outputPosition_ ? std::min(resultPosition_ - outputPosition_, resultLength) : 0;
+    bool isAligned = resultPosition_ <= outputPosition_ + silenceLength;
+
+    outputBuffer_.Ensure(resultLength);
+
+    size_t poppedLength = 0;
+
+    for (size_t channel = 0; channel < resultBuffers_.size(); channel++)
+    {
+        auto outputData = outputBuffer_.ChannelData(channel);
+
+        std::fill(outputData, outputData + silenceLength, PCMTYPE());
+
+        if (isAligned)
+        {
+            poppedLength = resultBuffers_[channel].Pop(outputData + silenceLength, resultLength - silenceLength);
+        }
+        else
+        {
+            std::fill(outputData + silenceLength, outputData + resultLength, PCMTYPE());
+        }
+    }
+
+    if (silenceLength + poppedLength < resultLength)
+    {
+        overrunsCount_++;
+    }
+
+    resultPosition_ += poppedLength;
+    outputPosition_ += resultLength;
+}
+
+void PipelineStageScheduler::ReserveRings(size_t samplesCount)
+{
+    // Both rings stay below the latency plus a couple of host blocks, older samples are dropped as past due
+    for (auto& collectBuffer : collectBuffers_)
+    {
+        collectBuffer.Reserve(blockSize_ * (stages_.size() + 2) + samplesCount * 3);
+    }
+
+    for (auto& resultBuffer : resultBuffers_)
+    {
+        resultBuffer.Reserve(blockSize_ * (stages_.size() + 2) + samplesCount * 3);
+    }
+}
+
+void PipelineStageScheduler::Push(const Buffers::SingleBuffer<PCMTYPE>& inputBuffer)
+{
+    size_t samplesCount = inputBuffer.DataLengthSamples();
+
+    if (pushedSamples_ == 0)
+    {
+        CheckHostPriority();
+
+        // A block completes at most a block after its last sample arrives, then takes a block period per stage.
+        // Host blocks are cut at other boundaries, so the first one adds its length on top
+        latencySamples_ = blockSize_ * (stages_.size() + 1) + samplesCount;
+    }
+
+    ReserveRings(samplesCount);
+
+    for (size_t channel = 0; channel < collectBuffers_.size(); channel++)
+    {
+        collectBuffers_[channel].Push(inputBuffer.ChannelDataConst(channel), samplesCount);
+    }
+
+    pushedSamples_ += samplesCount;
+
+    CollectBlocks();
+
+    // Input kept back by an overrun is past due once its output has been replaced by silence
+    if (collectPosition_ < outputPosition_ + heldBackSamples_)
+    {
+        size_t purgedLength = 0;
+
+        for (auto& collectBuffer : collectBuffers_)
+        {
+            purgedLength = collectBuffer.Purge(outputPosition_ + heldBackSamples_ - collectPosition_);
+        }
+
+        collectPosition_ += purgedLength;
+    }
+
+    while (collectBuffers_[0].DataLengthSamples() >= blockSize_)
+    {
+        // Stages are behind, the samples wait for the next call rather than the caller for the stages
+        if (freeBlocks_.empty() && isFreewheeling_)
+        {
+            WaitForBlock();
+            continue;
+        }
+
+        if (freeBlocks_.empty())
+        {
+            overrunsCount_++;
+            break;
+        }
+
+        auto block = freeBlocks_.back();
+        freeBlocks_.pop_back();
+
+        // Stages may have changed the channels count, restore it before refilling
+        block->Buffer.Channels(static_cast<int>(collectBuffers_.size()));
+        block->Buffer.Ensure(blockSize_);
+
+        for (size_t channel = 0; channel < collectBuffers_.size(); channel++)
+        {
+            collectBuffers_[channel].Pop(block->Buffer.ChannelData(channel), blockSize_);
+        }
+
+        block->Buffer.SampleRate(inputBuffer.SampleRate());
+        block->Buffer.DataLengthSamples(blockSize_);
+        block->Position = collectPosition_;
+
+        collectPosition_ += blockSize_;
+
+        SubmitBlock(block);
+    }
+
+    // Output is held back until the stream is a full latency old, then follows the input sample for sample
+    size_t resultLength = DueLength();
+
+    while (isFreewheeling_ && blocksInFlight_ > 0 &&
+           resultPosition_ + resultBuffers_[0].DataLengthSamples() < outputPosition_ + resultLength)
+    {
+        WaitForBlock();
+        resultLength = DueLength();
+    }
+
+    PopResult(resultLength);
+
+    outputBuffer_.SampleRate(inputBuffer.SampleRate());
+    outputBuffer_.DataLengthSamples(resultLength);
+}
+
+void PipelineStageScheduler::Drain()
+{
+    while (blocksInFlight_ > 0)
+    {
+        WaitForBlock();
+    }
+}
+
+void PipelineStageScheduler::Flush()
+{
+    Drain();
+
+    for (auto& collectBuffer : collectBuffers_)
+    {
+        collectBuffer.Flush();
+    }
+
+    for (auto& resultBuffer : resultBuffers_)
+    {
+        resultBuffer.Flush();
+    }
+
+    // Estimate until the first Push fixes it with the host block length
+    latencySamples_ = blockSize_ * (stages_.size() + 2);
+
+    pushedSamples_ = 0;
+    collectPosition_ = resultPosition_ = outputPosition_ = 0;
+    heldBackSamples_ = 0;
+
+    outputBuffer_.DataLengthSamples(0);
+}
+
+} // namespace Core
+} // namespace dePhonica
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "Buffers/SingleBuffer.h"
+#include "Buffers/RingBuffer.h"
+#include "Threading/BlockQueue.h"
+#include "Threading/Semaphore.h"
+
+#include "Configuration.h"
+
+namespace dePhonica {
+namespace Core {
+
+// Runs pipeline stages on dedicated threads, each stage working on its own block.
+// Incoming samples are cut into fixed blocks, passed from stage to stage through lock-free queues
+// and collected back on the caller thread, which never waits for them. Output is delayed by LatencySamples(),
+// a block that is not back in time is replaced by silence and counted as an overrun.
+class PipelineStageScheduler
+{
+public:
+    using StageFunction = std::function<void(Buffers::SingleBuffer<PCMTYPE>&)>;
+
+private:
+    struct Block
+    {
+        Buffers::SingleBuffer<PCMTYPE> Buffer;
+        // Stream position of the first sample, since the last Flush
+        size_t Position;
+
+        Block(size_t blockSize, int channelsCount)
+            : Buffer(blockSize, channelsCount)
+            , Position(0)
+        {
+        }
+    };
+
+    using BlockQueue = Threading::BlockQueue<Block*>;
+
+    struct Stage
+    {
+        StageFunction Process;
+
+        std::unique_ptr<BlockQueue> InputQueue;
+        Threading::Semaphore InputSignal;
+
+        std::thread Worker;
+    };
+
+    size_t blockSize_;
+
+    std::vector<std::unique_ptr<Stage>> stages_;
+
+    std::vector<std::unique_ptr<Block>> blockPool_;
+    std::vector<Block*> freeBlocks_;
+
+    BlockQueue completedQueue_;
+    // Only waited on by Drain, the caller thread polls completedQueue_
+    Threading::Semaphore completedSignal_;
+
+    size_t blocksInFlight_;
+    std::atomic<bool> isStopping_;
+
+    // SCHED_FIFO priority for the stage threads, 0 keeps them at the default policy
+    std::atomic<int> stagePriority_;
+
+    bool isFreewheeling_;
+
+    size_t latencySamples_;
+    size_t overrunsCount_;
+
+    // Stream positions since the last Flush: samples pushed, first sample of each ring and next sample to output.
+    // The result ring and the output count stream samples after what the stages held back
+    size_t pushedSamples_;
+    size_t collectPosition_, resultPosition_, outputPosition_;
+    // Samples the stages kept back, blocks never come out longer than they went in
+    size_t heldBackSamples_;
+
+    std::vector<Buffers::RingBuffer<PCMTYPE>> collectBuffers_, resultBuffers_;
+    Buffers::SingleBuffer<PCMTYPE> outputBuffer_;
+
+    void RunStage(size_t stageIndex);
+    void SubmitBlock(Block* block);
+    // Takes the blocks the last stage has finished, never waits
+    void CollectBlocks();
+    // Blocks until the last stage finishes a block, never called on the audio thread but when freewheeling
+    void WaitForBlock();
+    void StoreResult(Block* block);
+    // Output samples a full latency old, less what the stages held back
+    size_t DueLength() const;
+    void PopResult(size_t resultLength);
+
+    // Runs on the host audio thread, the stages follow its priority
+    void CheckHostPriority();
+
+    // Only allocates for blocks longer than any seen before
+    void ReserveRings(size_t samplesCount);
+
+public:
+    // Stages may turn blocks of inputChannelsCount channels into blocks of outputChannelsCount channels,
+    // enough blocks are allocated for host blocks of up to maxSamplesCount
+    PipelineStageScheduler(size_t blockSize,
+                           size_t maxSamplesCount,
+                           int inputChannelsCount,
+                           int outputChannelsCount,
+                           const std::vector<StageFunction>& stageFunctions);
+    ~PipelineStageScheduler();
+
+    void Push(const Buffers::SingleBuffer<PCMTYPE>& inputBuffer);
+
+    const Buffers::SingleBuffer<PCMTYPE>& Pop() const
+    {
+        return outputBuffer_;
+    }
+
+    // Samples per block handed to the stages
+    size_t BlockSize() const { return blockSize_; }
+
+    void Reserve(size_t samplesCount)
+    {
+        ReserveRings(samplesCount);
+        outputBuffer_.Ensure(samplesCount);
+    }
+
+    // Offline renders wait for the stages instead of replacing late blocks by silence, never set on an audio thread
+    void Freewheel(bool isFreewheeling)
+    {
+        isFreewheeling_ = isFreewheeling;
+    }
+
+    // Waits for the blocks in flight; stages are idle when it returns
+    void Drain();
+
+    void Flush();
+
+    // One block per stage, one being collected and the host block, fixed at the first Push after a Flush
+    size_t LatencySamples() const
+    {
+        return latencySamples_;
+    }
+
+    // Blocks that could not be submitted for lack of a free one plus outputs that were not back in time
+    size_t OverrunsCount() const
+    {
+        return overrunsCount_;
+    }
+};
+
+} // namespace Core
+} // namespace dePhonica
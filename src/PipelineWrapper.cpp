@@ -3,60 +3,106 @@
 namespace dePhonica {
 namespace Core {
 
-PipelineWrapper::PipelineWrapper(unsigned int sampleRate, const std::string& configFileJson)
-    : pipelineDescription_(PipelineDescription::FromFile(configFileJson))
-    , pipeline_(sampleRate, pipelineDescription_)
-    , isInitBuffer_(true)
+PipelineWrapper::PipelineWrapper(unsigned int sampleRate, const std::string& configFileJson, PipelineOutputs outputs)
+    : PipelineWrapper(sampleRate, PipelineDescription::FromFile(configFileJson), outputs)
 {
 }
 
-void PipelineWrapper::Process(size_t samplesCount)
+PipelineWrapper::PipelineWrapper(unsigned int sampleRate, const PipelineDescription& pipelineDescription, PipelineOutputs outputs)
+    : pipelineDescription_(pipelineDescription)
+    , pipeline_(sampleRate, pipelineDescription_, outputs)
+    , portLayout_(pipelineDescription_.ChannelsCount, static_cast<int>(pipeline_.OutputsCount()))
+    , portDataLocation(portLayout_.PortsCount(), nullptr)
+    , inputBuffer_(0, pipelineDescription_.ChannelsCount)
+    , isInitBuffer_(true)
 {
-    inputBuffer_.Copy(portDataLocation[(int)PipelineWrapperPorts::Input], samplesCount);
+    inputBuffer_.SampleRate(sampleRate);
+
+    if (pipelineDescription_.FlightRecorderFile.empty() == false)
+    {
+        flightRecorder_ = std::make_unique<FlightRecorder>(sampleRate, pipelineDescription_.FlightRecorderFile,
+            pipelineDescription_.FlightRecorderDeadlineFraction, pipelineDescription_.FlightRecorderBlocks, pipeline_.Reflection(),
+            pipeline_.Counters());
+    }
 
-    /*
-    const auto& dataConst = inputBuffer_.BufferDataConst();
-    for (size_t n = 0; n < samplesCount; n++)
+    if (pipelineDescription_.HostCaptureFile.empty() == false)
     {
-        if (dataConst[n] != portDataLocation[(int)PipelineWrapperPorts::Input][n])
+        hostCapture_ = std::make_unique<HostCaptureWriter>(pipelineDescription_.HostCaptureFile, sampleRate,
+            pipelineDescription_.ChannelsCount, pipelineDescription_.IsHostAudioCaptured, pipelineDescription_.HostCaptureMaxSeconds);
+
+        if (hostCapture_->IsOpen() == false)
         {
-            printf("Not equal data: %f and %f\n",
-                dataConst[n], portDataLocation[(int)PipelineWrapperPorts::Input][n]);
+            hostCapture_.reset();
         }
-    }*/
+    }
+}
+
+void PipelineWrapper::Process(size_t samplesCount)
+{
+    auto start = flightRecorder_ ? FlightRecorder::Clock::now() : FlightRecorder::Clock::time_point();
+
+    for (int channel = 0; channel < portLayout_.Channels(); channel++)
+    {
+        inputBuffer_.CopyChannel(channel, portDataLocation[portLayout_.PortIndex(PipelineWrapperPorts::Input, channel)], samplesCount);
+    }
+
+    inputBuffer_.DataLengthSamples(samplesCount);
+
+    if (hostCapture_)
+    {
+        hostCapture_->PushRun(inputBuffer_);
+    }
 
     pipeline_.Push(inputBuffer_);
 
     auto& resultBuffer = pipeline_.Pop();
-    auto resultData = resultBuffer.BufferDataConst().data();
     auto resultSamplesCount = resultBuffer.DataLengthSamples();
 
-    auto outputDataLocation = portDataLocation[(int)PipelineWrapperPorts::Output];
-
-    if (resultSamplesCount < samplesCount)
+    for (int outputChannel = 0; outputChannel < portLayout_.Outputs() * portLayout_.Channels(); outputChannel++)
     {
-        memset(outputDataLocation, 0, samplesCount * sizeof(PCMTYPE));
+        int channel = outputChannel % portLayout_.Channels();
+        int output = outputChannel / portLayout_.Channels();
 
-        auto diffSamples = samplesCount - resultSamplesCount;
+        auto resultData = resultBuffer.ChannelDataConst(outputChannel);
+        auto outputDataLocation = portDataLocation[portLayout_.PortIndex(PipelineWrapperPorts::Output, channel, output)];
 
-        if (isInitBuffer_)
+        if (resultSamplesCount < samplesCount)
         {
-            memcpy(&outputDataLocation[diffSamples], resultData, resultSamplesCount * sizeof(PCMTYPE));
+            memset(outputDataLocation, 0, samplesCount * sizeof(PCMTYPE));
+
+            auto diffSamples = samplesCount - resultSamplesCount;
+
+            if (isInitBuffer_)
+            {
+                memcpy(&outputDataLocation[diffSamples], resultData, resultSamplesCount * sizeof(PCMTYPE));
+            }
+            else
+            {
+                memcpy(outputDataLocation, resultData, resultSamplesCount * sizeof(PCMTYPE));
+            }
         }
         else
         {
             memcpy(outputDataLocation, resultData, resultSamplesCount * sizeof(PCMTYPE));
         }
     }
-    else
-    {
-        memcpy(outputDataLocation, resultData, resultSamplesCount * sizeof(PCMTYPE));
-    }
 
     if (isInitBuffer_ && resultSamplesCount > 0)
     {
         isInitBuffer_ = false;
     }
+
+    auto latencyLocation = portDataLocation[portLayout_.PortIndex(PipelineWrapperPorts::Latency)];
+
+    if (latencyLocation != nullptr)
+    {
+        *latencyLocation = static_cast<LADSPA_Data>(pipeline_.LatencySamples());
+    }
+
+    if (flightRecorder_)
+    {
+        flightRecorder_->Push(start, FlightRecorder::Clock::now(), samplesCount);
+    }
 }
 
 } // namespace Core
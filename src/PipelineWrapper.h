@@ -1,9 +1,13 @@
 #pragma once
 
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "Ladspa/src/ladspa.h"
 #include "Pipeline.h"
+#include "Reflection/FlightRecorder.h"
+#include "Reflection/HostCapture.h"
 
 namespace dePhonica {
 namespace Core {
@@ -11,9 +15,59 @@ namespace Core {
 enum class PipelineWrapperPorts
 {
     Input = 0,
-    Output
+    Output,
+    Latency
+};
+
+// Ports go as one input per channel, then every output with one port per channel, then the latency report
+class PipelineWrapperPortLayout
+{
+private:
+    int channelsCount_;
+    int outputsCount_;
+
+public:
+    PipelineWrapperPortLayout(int channelsCount, int outputsCount = 1)
+        : channelsCount_(channelsCount)
+        , outputsCount_(outputsCount)
+    {
+    }
+
+    int Channels() const { return channelsCount_; }
+
+    int Outputs() const { return outputsCount_; }
+
+    unsigned long PortsCount() const { return channelsCount_ * (outputsCount_ + 1) + 1; }
+
+    unsigned long PortIndex(PipelineWrapperPorts port, int channel = 0, int output = 0) const
+    {
+        switch (port)
+        {
+        case PipelineWrapperPorts::Input:
+            return channel;
+
+        case PipelineWrapperPorts::Output:
+            return channelsCount_ * (output + 1) + channel;
+
+        default:
+            return channelsCount_ * (outputsCount_ + 1);
+        }
+    }
+
+    PipelineWrapperPorts PortType(unsigned long portIndex) const
+    {
+        if (portIndex < static_cast<unsigned long>(channelsCount_))
+        {
+            return PipelineWrapperPorts::Input;
+        }
+
+        return portIndex < PortIndex(PipelineWrapperPorts::Latency) ? PipelineWrapperPorts::Output : PipelineWrapperPorts::Latency;
+    }
+
+    int PortChannel(unsigned long portIndex) const { return static_cast<int>(portIndex % channelsCount_); }
+
+    int PortOutput(unsigned long portIndex) const { return static_cast<int>(portIndex / channelsCount_) - 1; }
 };
-const int PipelineWrapperPortsCount = 2;
 
 class PipelineWrapper
 {
@@ -21,25 +75,52 @@ private:
     PipelineDescription pipelineDescription_;
     Pipeline pipeline_;
 
-    LADSPA_Data* portDataLocation[PipelineWrapperPortsCount];
+    PipelineWrapperPortLayout portLayout_;
+    std::vector<LADSPA_Data*> portDataLocation;
 
     Buffers::SingleBuffer<PCMTYPE> inputBuffer_;
 
     bool isInitBuffer_;
 
+    // Only when the description names a flight recorder file
+    std::unique_ptr<FlightRecorder> flightRecorder_;
+    std::unique_ptr<HostCaptureWriter> hostCapture_;
+
 public:
-    PipelineWrapper(unsigned int sampleRate, const std::string& configFileJson);
+    PipelineWrapper(unsigned int sampleRate, const std::string& configFileJson, PipelineOutputs outputs = PipelineOutputs::Mixed);
 
-    void SetPortDataLocation(PipelineWrapperPorts port, LADSPA_Data* dataLocation) { portDataLocation[(int)port] = dataLocation; }
+    // For tools that adjust the description before the pipeline is built
+    PipelineWrapper(unsigned int sampleRate, const PipelineDescription& pipelineDescription,
+                    PipelineOutputs outputs = PipelineOutputs::Mixed);
+
+    const PipelineWrapperPortLayout& PortLayout() const { return portLayout_; }
+
+    StageCounters& Counters() { return pipeline_.Counters(); }
+
+    void SetPortDataLocation(unsigned long port, LADSPA_Data* dataLocation)
+    {
+        if (port < portDataLocation.size())
+        {
+            portDataLocation[port] = dataLocation;
+        }
+    }
 
     void Flush()
     {
+        if (hostCapture_)
+        {
+            hostCapture_->PushActivate();
+        }
+
         isInitBuffer_ = true;
         pipeline_.Flush();
+
+        inputBuffer_.Ensure(pipelineDescription_.MaxBlockSize);
+        pipeline_.Reserve(pipelineDescription_.MaxBlockSize);
     }
 
     void Process(size_t samplesCount);
 };
 
 } // namespace Core
-} // namespace dePhonica
\ No newline at end of file
+} // namespace dePhonica
@@ -0,0 +1,245 @@
+#include "FlightRecorder.h"
+#include "PipelineReflection.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace dePhonica {
+namespace Core {
+
+static const char* StageNames[] = { "push", "correction", "preprocessing", "mix", "master", "reflection" };
+
+static std::string JsonEscaped(const std::string& text)
+{
+    std::string escaped;
+
+    for (char character : text)
+    {
+        if (character == '"' || character == '\\')
+        {
+            escaped += '\\';
+        }
+
+        escaped += character;
+    }
+
+    return escaped;
+}
+
+FlightRecorder::FlightRecorder(unsigned sampleRate,
+                               const std::string& filePrefix,
+                               double deadlineFraction,
+                               size_t blocksCount,
+                               PipelineReflection& pipelineReflection,
+                               StageCounters& stageCounters)
+    : sampleRate_(sampleRate)
+    , deadlineFraction_(deadlineFraction)
+    , filePrefix_(filePrefix)
+    , pipelineReflection_(pipelineReflection)
+    , stageCounters_(stageCounters)
+    , records_(new Record[std::max<size_t>(blocksCount, 1)])
+    , recordsCount_(std::max<size_t>(blocksCount, 1))
+    , writeIndex_(0)
+    , origin_(Clock::now())
+    , isDumpPending_(false)
+    , missIndex_(0)
+    , dumpRequestsCount_(0)
+    , dumpsCount_(0)
+    , isStopping_(false)
+{
+    // Compressor and auto gain state, spectrum bands would only crowd the trace
+    auto variableNames = pipelineReflection_.VariableNames();
+
+    for (size_t slot = 0; slot < variableNames.size() && variableSlots_.size() < MAX_RECORDED_VARIABLES; slot++)
+    {
+        if (variableNames[slot].find(".spectrum.") == std::string::npos)
+        {
+            variableSlots_.push_back(slot);
+            variableNames_.push_back(variableNames[slot]);
+        }
+    }
+
+    worker_ = std::thread(&FlightRecorder::Run, this);
+}
+
+FlightRecorder::~FlightRecorder()
+{
+    isStopping_ = true;
+    dumpSignal_.Post();
+    worker_.join();
+}
+
+void FlightRecorder::Push(Clock::time_point start, Clock::time_point end, size_t samplesCount)
+{
+    // The ring holds still until the blocks up to the miss are dumped
+    if (isDumpPending_.load(std::memory_order_acquire))
+    {
+        stageCounters_.TakeCallTicks(skippedTicks_);
+        return;
+    }
+
+    uint64_t index = writeIndex_.load(std::memory_order_relaxed);
+    auto& record = records_[index % recordsCount_];
+
+    record.Sequence.store(index * 2 + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    auto& data = record.Data;
+
+    data.StartNs = std::chrono::duration_cast<std::chrono::nanoseconds>(start - origin_).count();
+    data.DurationNs = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    data.SamplesCount = samplesCount;
+
+    stageCounters_.TakeCallTicks(data.Ticks);
+
+    for (size_t variableIndex = 0; variableIndex < variableSlots_.size(); variableIndex++)
+    {
+        data.Variables[variableIndex] = pipelineReflection_.PeekVariable(variableSlots_[variableIndex]);
+    }
+
+    record.Sequence.store(index * 2 + 2, std::memory_order_release);
+    writeIndex_.store(index + 1, std::memory_order_release);
+
+    double deadlineNs = samplesCount * 1e9 / sampleRate_;
+
+    if (data.DurationNs > deadlineFraction_ * deadlineNs && dumpRequestsCount_ < MAX_FLIGHT_RECORDER_DUMPS)
+    {
+        dumpRequestsCount_++;
+        missIndex_.store(index, std::memory_order_relaxed);
+        isDumpPending_.store(true, std::memory_order_release);
+        dumpSignal_.Post();
+    }
+}
+
+void FlightRecorder::Run()
+{
+    double microsecondsPerTick = 0;
+
+    while (true)
+    {
+        dumpSignal_.Wait();
+
+        if (isStopping_)
+        {
+            break;
+        }
+
+        // Calibrated on the first dump, it takes a few milliseconds
+        if (IsStageCounted && microsecondsPerTick == 0)
+        {
+            microsecondsPerTick = 1e6 / StageCounters::TicksPerSecond();
+        }
+
+        Dump(missIndex_.load(std::memory_order_relaxed), microsecondsPerTick);
+        isDumpPending_.store(false, std::memory_order_release);
+    }
+}
+
+void FlightRecorder::Dump(uint64_t missIndex, double microsecondsPerTick)
+{
+    // Copied out first, the ring is frozen meanwhile but a record may still be in flight
+    uint64_t endIndex = writeIndex_.load(std::memory_order_acquire);
+    uint64_t beginIndex = endIndex > recordsCount_ ? endIndex - recordsCount_ : 0;
+
+    std::vector<std::pair<uint64_t, RecordData>> records;
+    records.reserve(endIndex - beginIndex);
+
+    for (uint64_t index = beginIndex; index < endIndex; index++)
+    {
+        const auto& record = records_[index % recordsCount_];
+
+        uint64_t sequence = record.Sequence.load(std::memory_order_acquire);
+        RecordData data = record.Data;
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        // Overwritten meanwhile
+        if (sequence != index * 2 + 2 || record.Sequence.load(std::memory_order_relaxed) != sequence)
+        {
+            continue;
+        }
+
+        records.emplace_back(index, data);
+    }
+
+    std::string fileName = filePrefix_ + "-" + std::to_string(++dumpsCount_) + ".json";
+    std::string temporaryFileName = fileName + ".tmp";
+
+    FILE* traceFile = fopen(temporaryFileName.c_str(), "w");
+
+    if (traceFile == nullptr)
+    {
+        return;
+    }
+
+    fprintf(traceFile, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(traceFile, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"dePhonica\"}},\n");
+    fprintf(traceFile, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"blocks\"}},\n");
+    fprintf(traceFile, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"stages, end to end\"}}");
+
+    for (const auto& indexedRecord : records)
+    {
+        const auto& data = indexedRecord.second;
+
+        double startUs = data.StartNs / 1e3;
+        double durationUs = data.DurationNs / 1e3;
+        double deadlineUs = data.SamplesCount * 1e6 / sampleRate_;
+
+        fprintf(traceFile, ",\n{\"name\":\"block\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f,"
+                           "\"args\":{\"index\":%llu,\"samples\":%zu,\"deadlineUs\":%.3f,\"load\":%.4f}}",
+                startUs, durationUs, static_cast<unsigned long long>(indexedRecord.first), data.SamplesCount, deadlineUs,
+                durationUs / deadlineUs);
+
+        fprintf(traceFile, ",\n{\"name\":\"load\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"load\":%.4f}}", startUs,
+                durationUs / deadlineUs);
+
+        // Stage order within a call is not kept, only their durations
+        double stageStartUs = startUs;
+
+        for (size_t stageIndex = static_cast<size_t>(PipelineStages::Correction); stageIndex < PIPELINE_STAGES_COUNT; stageIndex++)
+        {
+            if (data.Ticks[stageIndex] == 0)
+            {
+                continue;
+            }
+
+            std::string stageName = stageIndex < static_cast<size_t>(PipelineStages::Band)
+                                        ? StageNames[stageIndex]
+                                        : "band " + std::to_string(stageIndex - static_cast<size_t>(PipelineStages::Band) + 1);
+            double stageUs = data.Ticks[stageIndex] * microsecondsPerTick;
+
+            fprintf(traceFile, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":%.3f,\"dur\":%.3f}", stageName.c_str(),
+                    stageStartUs, stageUs);
+
+            stageStartUs += stageUs;
+        }
+
+        for (size_t variableIndex = 0; variableIndex < variableNames_.size(); variableIndex++)
+        {
+            fprintf(traceFile, ",\n{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"value\":%g}}",
+                    JsonEscaped(variableNames_[variableIndex]).c_str(), startUs, data.Variables[variableIndex]);
+        }
+
+        if (indexedRecord.first == missIndex)
+        {
+            fprintf(traceFile, ",\n{\"name\":\"deadline miss\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":1,\"ts\":%.3f}",
+                    startUs + durationUs);
+        }
+    }
+
+    fprintf(traceFile, "\n]}\n");
+
+    bool isWritten = ferror(traceFile) == 0;
+    isWritten = fclose(traceFile) == 0 && isWritten;
+
+    if (isWritten)
+    {
+        rename(temporaryFileName.c_str(), fileName.c_str());
+    }
+    else
+    {
+        remove(temporaryFileName.c_str());
+    }
+}
+
+} // namespace Core
+} // namespace dePhonica
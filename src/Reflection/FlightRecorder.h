@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "StageCounters.h"
+#include "Threading/Semaphore.h"
+#include "Configuration.h"
+
+// Variables past this one are not recorded
+#define MAX_RECORDED_VARIABLES      16
+// Dumps per recorder, so a unit that keeps missing does not fill the disk
+#define MAX_FLIGHT_RECORDER_DUMPS   16
+
+namespace dePhonica {
+namespace Core {
+
+class PipelineReflection;
+
+// Keeps the last blocks of a wrapper: call time, block size, per-stage ticks and the compressor and auto gain
+// variables. The audio thread writes a preallocated ring; when a call takes more than deadlineFraction of
+// samplesCount / sampleRate, a background thread dumps the ring as Chrome trace JSON (chrome://tracing, Perfetto).
+// Blocks are not recorded until the dump is written, so it ends with the block that missed.
+// Stage ticks are only there when built with PIPELINE_STAGE_COUNTERS.
+class FlightRecorder
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+private:
+    struct RecordData
+    {
+        int64_t StartNs;
+        int64_t DurationNs;
+        size_t SamplesCount;
+
+        StageTicks Ticks[PIPELINE_STAGES_COUNT];
+        float Variables[MAX_RECORDED_VARIABLES];
+    };
+
+    struct Record
+    {
+        // Twice the block index plus two once written, odd while being written
+        std::atomic<uint64_t> Sequence{1};
+        RecordData Data;
+    };
+
+    unsigned sampleRate_;
+    double deadlineFraction_;
+    std::string filePrefix_;
+
+    PipelineReflection& pipelineReflection_;
+    StageCounters& stageCounters_;
+
+    std::vector<size_t> variableSlots_;
+    std::vector<std::string> variableNames_;
+
+    std::unique_ptr<Record[]> records_;
+    size_t recordsCount_;
+    std::atomic<uint64_t> writeIndex_;
+
+    Clock::time_point origin_;
+
+    StageTicks skippedTicks_[PIPELINE_STAGES_COUNT];
+
+    // Set by the audio thread, cleared once the dump is written
+    std::atomic<bool> isDumpPending_;
+    std::atomic<uint64_t> missIndex_;
+    size_t dumpRequestsCount_;
+    size_t dumpsCount_;
+
+    std::atomic<bool> isStopping_;
+    Threading::Semaphore dumpSignal_;
+    std::thread worker_;
+
+    void Run();
+    void Dump(uint64_t missIndex, double microsecondsPerTick);
+
+public:
+    FlightRecorder(unsigned sampleRate,
+                   const std::string& filePrefix,
+                   double deadlineFraction,
+                   size_t blocksCount,
+                   PipelineReflection& pipelineReflection,
+                   StageCounters& stageCounters);
+    ~FlightRecorder();
+
+    // Audio thread side, call after every block; never allocates or locks
+    void Push(Clock::time_point start, Clock::time_point end, size_t samplesCount);
+};
+
+} // namespace Core
+} // namespace dePhonica
@@ -0,0 +1,250 @@
+#include "HostCapture.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#define HOST_CAPTURE_POLL_PERIOD_MS     20
+#define HOST_CAPTURE_RING_WORDS         65536
+
+namespace dePhonica {
+namespace Core {
+
+namespace {
+
+// Fills ring spans front to back, across the wrap
+class SpansWriter
+{
+private:
+    Buffers::RingSpans<uint32_t>& spans_;
+    size_t position_;
+
+public:
+    explicit SpansWriter(Buffers::RingSpans<uint32_t>& spans)
+        : spans_(spans)
+        , position_(0)
+    {
+    }
+
+    void Write(const void* data, size_t wordsCount)
+    {
+        const char* source = static_cast<const char*>(data);
+
+        if (position_ < spans_.FirstLength)
+        {
+            size_t firstWords = std::min(wordsCount, spans_.FirstLength - position_);
+            memcpy(spans_.First + position_, source, firstWords * sizeof(uint32_t));
+
+            position_ += firstWords;
+            source += firstWords * sizeof(uint32_t);
+            wordsCount -= firstWords;
+        }
+
+        if (wordsCount > 0)
+        {
+            memcpy(spans_.Second + (position_ - spans_.FirstLength), source, wordsCount * sizeof(uint32_t));
+            position_ += wordsCount;
+        }
+    }
+};
+
+} // namespace
+
+HostCaptureWriter::HostCaptureWriter(const std::string& fileName,
+                                     unsigned sampleRate,
+                                     int channelsCount,
+                                     bool isAudioCaptured,
+                                     double maxSeconds)
+    : captureFile_(fopen(fileName.c_str(), "wb"))
+    , header_()
+    , eventRing_(HOST_CAPTURE_RING_WORDS + (isAudioCaptured ? 2 * sampleRate * channelsCount : 0))
+    , isStarted_(false)
+    , capturedSamples_(0)
+    , maxCapturedSamples_(static_cast<size_t>(std::max(0.0, maxSeconds) * sampleRate))
+    , isStopping_(false)
+{
+    static_assert(sizeof(PCMTYPE) == sizeof(uint32_t), "Captured samples are stored as 32-bit words");
+
+    if (captureFile_ == nullptr)
+    {
+        return;
+    }
+
+    header_.Magic = HOST_CAPTURE_MAGIC;
+    header_.Version = HOST_CAPTURE_VERSION;
+    header_.ByteOrder = HOST_CAPTURE_BYTE_ORDER;
+    header_.HeaderSize = sizeof(header_);
+    header_.SampleRate = sampleRate;
+    header_.ChannelsCount = channelsCount;
+    header_.IsAudioCaptured = isAudioCaptured ? 1 : 0;
+
+    fwrite(&header_, sizeof(header_), 1, captureFile_);
+
+    worker_ = std::thread(&HostCaptureWriter::Run, this);
+}
+
+HostCaptureWriter::~HostCaptureWriter()
+{
+    if (captureFile_ == nullptr)
+    {
+        return;
+    }
+
+    isStopping_ = true;
+    worker_.join();
+
+    // Everything left in the ring, then the final counts
+    while (WriteAvailable() > 0)
+    {
+    }
+
+    fseek(captureFile_, 0, SEEK_SET);
+    fwrite(&header_, sizeof(header_), 1, captureFile_);
+    fclose(captureFile_);
+}
+
+void HostCaptureWriter::Run()
+{
+    while (isStopping_ == false)
+    {
+        if (WriteAvailable() == 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(HOST_CAPTURE_POLL_PERIOD_MS));
+        }
+    }
+}
+
+size_t HostCaptureWriter::WriteAvailable()
+{
+    auto spans = eventRing_.ReadSpans(eventRing_.Capacity());
+
+    fwrite(spans.First, sizeof(uint32_t), spans.FirstLength, captureFile_);
+    fwrite(spans.Second, sizeof(uint32_t), spans.SecondLength, captureFile_);
+
+    eventRing_.CommitRead(spans.Length());
+
+    return spans.Length();
+}
+
+bool HostCaptureWriter::PushEvent(uint32_t flagsAndSamples, const Buffers::SingleBuffer<PCMTYPE>* inputBuffer)
+{
+    auto now = Clock::now();
+    auto intervalUs = isStarted_ ? std::chrono::duration_cast<std::chrono::microseconds>(now - lastEventTime_).count() : 0;
+
+    lastEventTime_ = now;
+    isStarted_ = true;
+
+    size_t samplesCount = flagsAndSamples & HOST_CAPTURE_SAMPLES_MASK;
+    size_t audioWords = inputBuffer != nullptr ? samplesCount * inputBuffer->Channels() : 0;
+
+    auto spans = eventRing_.WriteSpans(2 + audioWords);
+
+    // A block that does not fit with its audio is still worth its size and timing
+    if (audioWords > 0 && spans.Length() < 2 + audioWords)
+    {
+        header_.DroppedAudioCallsCount++;
+        audioWords = 0;
+    }
+
+    if (spans.Length() < 2)
+    {
+        header_.DroppedCallsCount++;
+        return false;
+    }
+
+    uint32_t words[2] = { flagsAndSamples | (audioWords > 0 ? HOST_CAPTURE_AUDIO : 0),
+                          static_cast<uint32_t>(std::min<int64_t>(intervalUs, UINT32_MAX)) };
+
+    SpansWriter spansWriter(spans);
+    spansWriter.Write(words, 2);
+
+    if (audioWords > 0)
+    {
+        for (int channel = 0; channel < inputBuffer->Channels(); channel++)
+        {
+            spansWriter.Write(inputBuffer->ChannelDataConst(channel), samplesCount);
+        }
+    }
+
+    eventRing_.CommitWrite(2 + audioWords);
+
+    return true;
+}
+
+void HostCaptureWriter::PushActivate()
+{
+    if (captureFile_ != nullptr && capturedSamples_ < maxCapturedSamples_)
+    {
+        PushEvent(HOST_CAPTURE_ACTIVATE, nullptr);
+    }
+}
+
+void HostCaptureWriter::PushRun(const Buffers::SingleBuffer<PCMTYPE>& inputBuffer)
+{
+    if (captureFile_ == nullptr || capturedSamples_ >= maxCapturedSamples_)
+    {
+        return;
+    }
+
+    size_t samplesCount = std::min<size_t>(inputBuffer.DataLengthSamples(), HOST_CAPTURE_SAMPLES_MASK);
+
+    PushEvent(static_cast<uint32_t>(samplesCount), header_.IsAudioCaptured ? &inputBuffer : nullptr);
+    capturedSamples_ += samplesCount;
+}
+
+HostCaptureReader::HostCaptureReader(const std::string& fileName)
+{
+    FILE* captureFile = fopen(fileName.c_str(), "rb");
+
+    if (captureFile == nullptr)
+    {
+        throw std::invalid_argument("Unable to open host capture " + fileName);
+    }
+
+    bool isHeaderRead = fread(&header_, sizeof(header_), 1, captureFile) == 1;
+
+    if (isHeaderRead == false || header_.Magic != HOST_CAPTURE_MAGIC)
+    {
+        fclose(captureFile);
+        throw std::invalid_argument(fileName + " is not a host capture");
+    }
+
+    if (header_.Version != HOST_CAPTURE_VERSION || header_.ByteOrder != HOST_CAPTURE_BYTE_ORDER || header_.ChannelsCount < 1)
+    {
+        fclose(captureFile);
+        throw std::invalid_argument(fileName + " was captured by another version or with another byte order");
+    }
+
+    fseek(captureFile, 0, SEEK_END);
+    long fileSize = ftell(captureFile);
+
+    words_.resize(std::max<long>(0, fileSize - static_cast<long>(header_.HeaderSize)) / sizeof(uint32_t));
+
+    fseek(captureFile, header_.HeaderSize, SEEK_SET);
+    words_.resize(fread(words_.data(), sizeof(uint32_t), words_.size(), captureFile));
+
+    fclose(captureFile);
+
+    // A capture cut short by a crash ends with the last whole event
+    for (size_t position = 0; position + 2 <= words_.size();)
+    {
+        HostCaptureEvent event;
+        event.IsActivate = (words_[position] & HOST_CAPTURE_ACTIVATE) != 0;
+        event.IsAudio = (words_[position] & HOST_CAPTURE_AUDIO) != 0;
+        event.SamplesCount = words_[position] & HOST_CAPTURE_SAMPLES_MASK;
+        event.IntervalUs = words_[position + 1];
+        event.AudioOffset = position + 2;
+
+        position += 2 + (event.IsAudio ? event.SamplesCount * header_.ChannelsCount : 0);
+
+        if (position > words_.size())
+        {
+            break;
+        }
+
+        events_.push_back(event);
+    }
+}
+
+} // namespace Core
+} // namespace dePhonica
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Buffers/RingBuffer.h"
+#include "Buffers/SingleBuffer.h"
+#include "Configuration.h"
+
+// "DPHC" in a little endian file
+#define HOST_CAPTURE_MAGIC          0x43485044
+#define HOST_CAPTURE_VERSION        1
+#define HOST_CAPTURE_BYTE_ORDER     0x01020304
+
+// Flags in the first word of an event, the rest of it is the samples count
+#define HOST_CAPTURE_ACTIVATE       0x80000000u
+#define HOST_CAPTURE_AUDIO          0x40000000u
+#define HOST_CAPTURE_SAMPLES_MASK   0x3fffffffu
+
+namespace dePhonica {
+namespace Core {
+
+// Header of a capture file. Events follow as 32-bit words: flags and samples count, then microseconds since the
+// previous event, then for HOST_CAPTURE_AUDIO the input samples of every channel one after another.
+// Dropped counts are filled in when the capture is closed. Files are native endian.
+struct HostCaptureHeader
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t ByteOrder;
+    uint32_t HeaderSize;
+
+    uint32_t SampleRate;
+    int32_t ChannelsCount;
+    uint32_t IsAudioCaptured;
+
+    // Calls missing from the file, and calls captured without their audio, because the writer fell behind
+    uint32_t DroppedCallsCount;
+    uint32_t DroppedAudioCallsCount;
+};
+
+// Captures the activate() and run() calls of a host. The audio thread only copies words into a single-producer
+// single-consumer ring, a background thread appends them to the file.
+class HostCaptureWriter
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+private:
+    FILE* captureFile_;
+    HostCaptureHeader header_;
+
+    Buffers::RingBuffer<uint32_t> eventRing_;
+
+    Clock::time_point lastEventTime_;
+    bool isStarted_;
+
+    size_t capturedSamples_, maxCapturedSamples_;
+
+    std::atomic<bool> isStopping_;
+    std::thread worker_;
+
+    void Run();
+    size_t WriteAvailable();
+
+    bool PushEvent(uint32_t flagsAndSamples, const Buffers::SingleBuffer<PCMTYPE>* inputBuffer);
+
+public:
+    HostCaptureWriter(const std::string& fileName, unsigned sampleRate, int channelsCount, bool isAudioCaptured, double maxSeconds);
+    ~HostCaptureWriter();
+
+    bool IsOpen() const { return captureFile_ != nullptr; }
+
+    // Audio thread side, neither allocates nor blocks; events that do not fit are dropped and counted
+    void PushActivate();
+    void PushRun(const Buffers::SingleBuffer<PCMTYPE>& inputBuffer);
+};
+
+struct HostCaptureEvent
+{
+    bool IsActivate;
+    size_t SamplesCount;
+    uint32_t IntervalUs;
+
+    // Word offset of the first channel samples, only meaningful with IsAudio
+    bool IsAudio;
+    size_t AudioOffset;
+};
+
+// Reads a whole capture, throws std::invalid_argument when the file is not one
+class HostCaptureReader
+{
+private:
+    HostCaptureHeader header_;
+
+    std::vector<uint32_t> words_;
+    std::vector<HostCaptureEvent> events_;
+
+public:
+    explicit HostCaptureReader(const std::string& fileName);
+
+    const HostCaptureHeader& Header() const { return header_; }
+
+    const std::vector<HostCaptureEvent>& Events() const { return events_; }
+
+    const float* ChannelSamples(const HostCaptureEvent& event, int channel) const
+    {
+        return reinterpret_cast<const float*>(words_.data() + event.AudioOffset + channel * event.SamplesCount);
+    }
+};
+
+} // namespace Core
+} // namespace dePhonica
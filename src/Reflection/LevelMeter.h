@@ -0,0 +1,97 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
+#include "Configuration.h"
+
+// Samples at or above full scale count as clipped
+#define METER_CLIP_LEVEL 1.0f
+
+namespace dePhonica {
+namespace Core {
+
+struct SegmentLevels
+{
+    float Peak = 0;
+    double SquaresSum = 0;
+    size_t ClipsCount = 0;
+    size_t SamplesCount = 0;
+
+    SegmentLevels& operator+=(const SegmentLevels& segmentLevels)
+    {
+        Peak = std::max(Peak, segmentLevels.Peak);
+        SquaresSum += segmentLevels.SquaresSum;
+        ClipsCount += segmentLevels.ClipsCount;
+        SamplesCount += segmentLevels.SamplesCount;
+
+        return *this;
+    }
+
+    float Rms() const { return SamplesCount > 0 ? std::sqrt(SquaresSum / SamplesCount) : 0; }
+};
+
+class LevelMeter
+{
+public:
+    // Peak, sum of squares and clipped samples of a segment in a single pass
+    static SegmentLevels Measure(const PCMTYPE* samples, size_t samplesCount)
+    {
+        SegmentLevels segmentLevels;
+        segmentLevels.SamplesCount = samplesCount;
+
+        size_t n = 0;
+
+        float peak = 0;
+        float squaresSum = 0;
+        size_t clipsCount = 0;
+
+#ifdef __SSE__
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        const __m128 clipLevel = _mm_set1_ps(METER_CLIP_LEVEL);
+
+        __m128 peaks = _mm_setzero_ps();
+        __m128 squaresSums = _mm_setzero_ps();
+
+        for (; n + 4 <= samplesCount; n += 4)
+        {
+            __m128 sampleValues = _mm_andnot_ps(signMask, _mm_loadu_ps(samples + n));
+
+            peaks = _mm_max_ps(peaks, sampleValues);
+            squaresSums = _mm_add_ps(squaresSums, _mm_mul_ps(sampleValues, sampleValues));
+            clipsCount += __builtin_popcount(_mm_movemask_ps(_mm_cmpge_ps(sampleValues, clipLevel)));
+        }
+
+        float lanes[4];
+
+        _mm_storeu_ps(lanes, peaks);
+        peak = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+
+        _mm_storeu_ps(lanes, squaresSums);
+        squaresSum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+
+        for (; n < samplesCount; n++)
+        {
+            float sample = std::abs(samples[n]);
+
+            peak = std::max(peak, sample);
+            squaresSum += sample * sample;
+            clipsCount += sample >= METER_CLIP_LEVEL ? 1 : 0;
+        }
+
+        segmentLevels.Peak = peak;
+        segmentLevels.SquaresSum = squaresSum;
+        segmentLevels.ClipsCount = clipsCount;
+
+        return segmentLevels;
+    }
+};
+
+} // namespace Core
+} // namespace dePhonica
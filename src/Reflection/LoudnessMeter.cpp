@@ -0,0 +1,226 @@
+#include "LoudnessMeter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace dePhonica {
+namespace Core {
+
+static double EnergyToLoudness(double energy)
+{
+    return energy > 0 ? -0.691 + 10 * std::log10(energy) : -std::numeric_limits<double>::infinity();
+}
+
+static double LoudnessToEnergy(double loudness)
+{
+    return std::pow(10.0, (loudness + 0.691) / 10);
+}
+
+LoudnessMeter::LoudnessMeter(unsigned sampleRate, int channelsCount, const std::vector<float>& channelWeights)
+    : channelStates_(channelsCount)
+    , samplesPerStep_(std::max<size_t>(1, sampleRate * LOUDNESS_STEP_MS / 1000))
+    , stepSamplesCount_(0)
+    , stepSquaresSum_(0)
+    , stepEnergies_(LOUDNESS_SHORT_TERM_STEPS, 0.0)
+    , stepsCount_(0)
+    , gatedHistogram_(LOUDNESS_HISTOGRAM_BINS, 0)
+    , histogramEnergies_(LOUDNESS_HISTOGRAM_BINS)
+    , momentaryEnergy_(0)
+    , shortTermEnergy_(0)
+    , integratedEnergy_(0)
+{
+    // K-weighting pre-filter of BS.1770, high shelf then RLB high pass, designed for the actual sample rate
+    double shelfK = std::tan(M_PI * 1681.974450955533 / sampleRate);
+    double shelfQ = 0.7071752369554196;
+    double shelfVh = std::pow(10.0, 3.999843853973347 / 20);
+    double shelfVb = std::pow(shelfVh, 0.4996667741545416);
+    double shelfA0 = 1 + shelfK / shelfQ + shelfK * shelfK;
+
+    shelfCoefficients_.B0 = (shelfVh + shelfVb * shelfK / shelfQ + shelfK * shelfK) / shelfA0;
+    shelfCoefficients_.B1 = 2 * (shelfK * shelfK - shelfVh) / shelfA0;
+    shelfCoefficients_.B2 = (shelfVh - shelfVb * shelfK / shelfQ + shelfK * shelfK) / shelfA0;
+    shelfCoefficients_.A1 = 2 * (shelfK * shelfK - 1) / shelfA0;
+    shelfCoefficients_.A2 = (1 - shelfK / shelfQ + shelfK * shelfK) / shelfA0;
+
+    double highPassK = std::tan(M_PI * 38.13547087602444 / sampleRate);
+    double highPassQ = 0.5003270373238773;
+    double highPassA0 = 1 + highPassK / highPassQ + highPassK * highPassK;
+
+    highPassCoefficients_.B0 = 1;
+    highPassCoefficients_.B1 = -2;
+    highPassCoefficients_.B2 = 1;
+    highPassCoefficients_.A1 = 2 * (highPassK * highPassK - 1) / highPassA0;
+    highPassCoefficients_.A2 = (1 - highPassK / highPassQ + highPassK * highPassK) / highPassA0;
+
+    for (size_t channel = 0; channel < std::min(channelWeights.size(), channelStates_.size()); channel++)
+    {
+        channelStates_[channel].Weight = channelWeights[channel];
+    }
+
+    for (size_t bin = 0; bin < histogramEnergies_.size(); bin++)
+    {
+        histogramEnergies_[bin] = LoudnessToEnergy(LOUDNESS_ABSOLUTE_GATE_LUFS + (bin + 0.5) * LOUDNESS_HISTOGRAM_STEP_LU);
+    }
+}
+
+void LoudnessMeter::Push(const Buffers::SingleBuffer<PCMTYPE>& samplesBuffer)
+{
+    const size_t samplesCount = samplesBuffer.DataLengthSamples();
+    const int channelsCount = std::min(samplesBuffer.Channels(), static_cast<int>(channelStates_.size()));
+
+    const auto& shelf = shelfCoefficients_;
+    const auto& highPass = highPassCoefficients_;
+
+    size_t position = 0;
+
+    while (position < samplesCount)
+    {
+        size_t stepSamples = std::min(samplesCount - position, samplesPerStep_ - stepSamplesCount_);
+
+        for (int channel = 0; channel < channelsCount; channel++)
+        {
+            const PCMTYPE* dataSamples = samplesBuffer.ChannelDataConst(channel) + position;
+            auto& state = channelStates_[channel];
+
+            // Excluded channels such as LFE
+            if (state.Weight == 0)
+            {
+                continue;
+            }
+
+            double squaresSum = 0;
+
+            // Transposed direct form II
+            for (size_t n = 0; n < stepSamples; n++)
+            {
+                double sample = dataSamples[n];
+
+                double shelved = shelf.B0 * sample + state.Shelf[0];
+                state.Shelf[0] = shelf.B1 * sample - shelf.A1 * shelved + state.Shelf[1];
+                state.Shelf[1] = shelf.B2 * sample - shelf.A2 * shelved;
+
+                double weighted = highPass.B0 * shelved + state.HighPass[0];
+                state.HighPass[0] = highPass.B1 * shelved - highPass.A1 * weighted + state.HighPass[1];
+                state.HighPass[1] = highPass.B2 * shelved - highPass.A2 * weighted;
+
+                squaresSum += weighted * weighted;
+            }
+
+            stepSquaresSum_ += squaresSum * state.Weight;
+        }
+
+        position += stepSamples;
+        stepSamplesCount_ += stepSamples;
+
+        if (stepSamplesCount_ == samplesPerStep_)
+        {
+            CompleteStep();
+        }
+    }
+}
+
+double LoudnessMeter::WindowEnergy(size_t stepsInWindow) const
+{
+    double energySum = 0;
+
+    for (size_t step = stepsCount_ - stepsInWindow; step < stepsCount_; step++)
+    {
+        energySum += stepEnergies_[step % stepEnergies_.size()];
+    }
+
+    return energySum / stepsInWindow;
+}
+
+void LoudnessMeter::CompleteStep()
+{
+    stepEnergies_[stepsCount_ % stepEnergies_.size()] = stepSquaresSum_ / samplesPerStep_;
+    stepsCount_++;
+
+    stepSquaresSum_ = 0;
+    stepSamplesCount_ = 0;
+
+    if (stepsCount_ >= LOUDNESS_SHORT_TERM_STEPS)
+    {
+        shortTermEnergy_ = WindowEnergy(LOUDNESS_SHORT_TERM_STEPS);
+    }
+
+    if (stepsCount_ < LOUDNESS_MOMENTARY_STEPS)
+    {
+        return;
+    }
+
+    // Momentary windows overlap by 75% and are the gating blocks of the integrated loudness
+    momentaryEnergy_ = WindowEnergy(LOUDNESS_MOMENTARY_STEPS);
+
+    double blockLoudness = EnergyToLoudness(momentaryEnergy_);
+
+    if (blockLoudness >= LOUDNESS_ABSOLUTE_GATE_LUFS)
+    {
+        size_t bin = static_cast<size_t>((blockLoudness - LOUDNESS_ABSOLUTE_GATE_LUFS) / LOUDNESS_HISTOGRAM_STEP_LU);
+
+        gatedHistogram_[std::min(bin, gatedHistogram_.size() - 1)]++;
+
+        UpdateIntegrated();
+    }
+}
+
+void LoudnessMeter::UpdateIntegrated()
+{
+    double energySum = 0;
+    size_t blocksCount = 0;
+
+    for (size_t bin = 0; bin < gatedHistogram_.size(); bin++)
+    {
+        energySum += gatedHistogram_[bin] * histogramEnergies_[bin];
+        blocksCount += gatedHistogram_[bin];
+    }
+
+    double relativeGate = EnergyToLoudness(energySum / blocksCount) + LOUDNESS_RELATIVE_GATE_LU;
+
+    size_t firstBin = relativeGate > LOUDNESS_ABSOLUTE_GATE_LUFS
+        ? static_cast<size_t>(std::ceil((relativeGate - LOUDNESS_ABSOLUTE_GATE_LUFS) / LOUDNESS_HISTOGRAM_STEP_LU - 0.5))
+        : 0;
+
+    energySum = 0;
+    blocksCount = 0;
+
+    for (size_t bin = std::min(firstBin, gatedHistogram_.size() - 1); bin < gatedHistogram_.size(); bin++)
+    {
+        energySum += gatedHistogram_[bin] * histogramEnergies_[bin];
+        blocksCount += gatedHistogram_[bin];
+    }
+
+    integratedEnergy_ = blocksCount > 0 ? energySum / blocksCount : 0;
+}
+
+double LoudnessMeter::Loudness(LoudnessWindows loudnessWindow) const
+{
+    switch (loudnessWindow)
+    {
+    case LoudnessWindows::Momentary:
+        return EnergyToLoudness(momentaryEnergy_);
+
+    case LoudnessWindows::ShortTerm:
+        return EnergyToLoudness(shortTermEnergy_);
+
+    case LoudnessWindows::Integrated:
+        return EnergyToLoudness(integratedEnergy_);
+    }
+
+    return EnergyToLoudness(0);
+}
+
+void LoudnessMeter::Reset()
+{
+    stepSamplesCount_ = 0;
+    stepSquaresSum_ = 0;
+    stepsCount_ = 0;
+
+    std::fill(gatedHistogram_.begin(), gatedHistogram_.end(), 0);
+
+    momentaryEnergy_ = shortTermEnergy_ = integratedEnergy_ = 0;
+}
+
+} // namespace Core
+} // namespace dePhonica
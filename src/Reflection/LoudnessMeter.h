@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Buffers/SingleBuffer.h"
+#include "Configuration.h"
+
+// ITU-R BS.1770 / EBU R128 windows, in 100 ms steps
+#define LOUDNESS_STEP_MS                100
+#define LOUDNESS_MOMENTARY_STEPS        4
+#define LOUDNESS_SHORT_TERM_STEPS       30
+
+#define LOUDNESS_ABSOLUTE_GATE_LUFS     (-70.0)
+#define LOUDNESS_RELATIVE_GATE_LU       (-10.0)
+
+// Gated blocks are kept as a histogram from the absolute gate up, in 0.1 LU bins
+#define LOUDNESS_HISTOGRAM_BINS         800
+#define LOUDNESS_HISTOGRAM_STEP_LU      0.1
+
+namespace dePhonica {
+namespace Core {
+
+enum class LoudnessWindows
+{
+    Momentary = 0,
+    ShortTerm,
+    Integrated
+};
+
+// K-weighted loudness of a multichannel stream: momentary (400 ms), short-term (3 s) and gated integrated.
+// Channels are summed with the BS.1770 weights given at construction, 1.0 for those left out.
+// Everything is sized at construction, pushing samples never allocates.
+class LoudnessMeter
+{
+private:
+    struct BiquadCoefficients
+    {
+        double B0, B1, B2, A1, A2;
+    };
+
+    struct ChannelState
+    {
+        double Shelf[2] = { 0, 0 };
+        double HighPass[2] = { 0, 0 };
+
+        double Weight = 1;
+    };
+
+    BiquadCoefficients shelfCoefficients_, highPassCoefficients_;
+    std::vector<ChannelState> channelStates_;
+
+    size_t samplesPerStep_;
+    size_t stepSamplesCount_;
+    double stepSquaresSum_;
+
+    // Mean square of the latest steps, summed over channels
+    std::vector<double> stepEnergies_;
+    size_t stepsCount_;
+
+    std::vector<uint32_t> gatedHistogram_;
+    std::vector<double> histogramEnergies_;
+
+    double momentaryEnergy_, shortTermEnergy_, integratedEnergy_;
+
+    double WindowEnergy(size_t stepsInWindow) const;
+
+    void CompleteStep();
+    void UpdateIntegrated();
+
+public:
+    LoudnessMeter(unsigned sampleRate, int channelsCount, const std::vector<float>& channelWeights = {});
+
+    void Push(const Buffers::SingleBuffer<PCMTYPE>& samplesBuffer);
+
+    // LUFS, or -infinity while the window is not filled yet
+    double Loudness(LoudnessWindows loudnessWindow) const;
+
+    // Restarts all the windows, the filters keep following the signal
+    void Reset();
+};
+
+} // namespace Core
+} // namespace dePhonica
@@ -1,10 +1,24 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <deque>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <string>
 
 #include "Buffers/SingleBuffer.h"
+#include "Buffers/SlidingMaximum.h"
+#include "LevelMeter.h"
+#include "LogConversions.h"
+#include "LoudnessMeter.h"
+#include "SharedMetersExport.h"
+#include "SpectrumAnalyzer.h"
+#include "SpectrumTapDescription.h"
+#include "StringHelpers.h"
 #include "Configuration.h"
 
 #define MEASURE_CHUNKS_COUNT 4
@@ -14,126 +28,433 @@ namespace Core {
 
 struct PeakLevelAccumulator
 {
-    float GetLevel() { return LevelHistory.size() > 0 ? *std::max_element(LevelHistory.begin(), LevelHistory.end()) : 0; }
+    explicit PeakLevelAccumulator(size_t historySeconds)
+        : LevelHistory(historySeconds)
+    {
+    }
+
+    float GetLevel() const { return LevelHistory.IsEmpty() ? 0 : LevelHistory.Maximum(); }
 
-    std::vector<float> LevelHistory;
+    // Loudest level of every second over the monitoring period
+    Buffers::SlidingMaximum<float> LevelHistory;
     size_t SamplesCount = 0;
+
+    // Blocks skipped by metering decimation still count towards the current second
+    size_t BlocksCount = 0;
+    size_t SkippedSamplesCount = 0;
+
+    // Only created when a loudness binding refers to this tap
+    std::unique_ptr<LoudnessMeter> Loudness;
+
+    // Only created when a spectrum tap listens to this binding
+    std::unique_ptr<SpectrumAnalyzer> Spectrum;
+};
+
+struct MeasuredLevels
+{
+    // Average of the chunk peaks of the loudest channel, the level auto gain thresholds are tuned for
+    float ChunksPeak;
+    SegmentLevels BlockLevels;
+};
+
+// Dense index of a binding or a variable, resolved from its name while the pipeline is built
+using ReflectionSlot = size_t;
+
+// A level auto gain can be bound to: "tap" follows peaks, "tap:momentary", "tap:shortTerm" and "tap:integrated" loudness
+struct LevelBinding
+{
+    ReflectionSlot Slot = 0;
+
+    bool IsLoudness = false;
+    LoudnessWindows Window = LoudnessWindows::Momentary;
 };
 
 class PipelineReflection
 {
 private:
     unsigned sampleRate_;
+    int channelsCount_;
     size_t peakMonitoringPeriodSeconds_;
+    size_t meteringDecimation_;
+    std::vector<float> loudnessChannelWeights_;
+
+    // Names are only looked up while building the pipeline, processing goes through slots
+    std::map<std::string, ReflectionSlot> peakLevelSlots_;
+    std::vector<PeakLevelAccumulator> peakLevels_;
+
+    // Atomic so background analyzers can publish without taking the lock
+    std::map<std::string, ReflectionSlot> variableSlots_;
+    std::deque<std::atomic<float>> variables_;
 
-    std::map<std::string, PeakLevelAccumulator> peakLevels_;
-    std::map<std::string, float> variables_;
+    bool isShared_;
+    std::mutex accessMutex_;
 
-    float MeasurePeaks(const Buffers::SingleBuffer<PCMTYPE>& samplesBuffer)
+    std::unique_ptr<SharedMetersExport> metersExport_;
+
+    // Only locks when the reflection is used by several pipeline stage threads
+    std::unique_lock<std::mutex> Lock()
     {
-        auto& dataSamples = samplesBuffer.BufferDataConst();
+        return isShared_ ? std::unique_lock<std::mutex>(accessMutex_) : std::unique_lock<std::mutex>();
+    }
 
+    static MeasuredLevels MeasureLevels(const Buffers::SingleBuffer<PCMTYPE>& samplesBuffer)
+    {
         size_t samplesInBuffer = samplesBuffer.DataLengthSamples();
         size_t samplesPerChunk = samplesInBuffer / MEASURE_CHUNKS_COUNT;
+        size_t chunkedSamples = samplesPerChunk * MEASURE_CHUNKS_COUNT;
 
-        size_t sampleIndex = 0;
-        float averageSample = 0;
+        MeasuredLevels measuredLevels;
+        float chunkPeaks[MEASURE_CHUNKS_COUNT] = {};
 
-        for (int chunk = 0; chunk < MEASURE_CHUNKS_COUNT; chunk++)
+        for (int channel = 0; channel < samplesBuffer.Channels(); channel++)
         {
-            float peakSample = 0;
+            const PCMTYPE* dataSamples = samplesBuffer.ChannelDataConst(channel);
 
-            for (size_t n = 0; n < samplesPerChunk && sampleIndex < samplesInBuffer; n++, sampleIndex++)
+            for (int chunk = 0; chunk < MEASURE_CHUNKS_COUNT; chunk++)
             {
-                auto sample = std::abs(dataSamples[sampleIndex]);
+                auto chunkLevels = LevelMeter::Measure(dataSamples + chunk * samplesPerChunk, samplesPerChunk);
 
-                if (sample > peakSample)
-                {
-                    peakSample = sample;
-                }
+                // Peak of the loudest channel
+                chunkPeaks[chunk] = std::max(chunkPeaks[chunk], chunkLevels.Peak);
+                measuredLevels.BlockLevels += chunkLevels;
             }
 
-            averageSample += peakSample;
+            // Samples past the last whole chunk only count for the block levels
+            measuredLevels.BlockLevels += LevelMeter::Measure(dataSamples + chunkedSamples, samplesInBuffer - chunkedSamples);
+        }
+
+        float averageSample = 0;
+
+        for (int chunk = 0; chunk < MEASURE_CHUNKS_COUNT; chunk++)
+        {
+            averageSample += chunkPeaks[chunk];
+        }
+
+        measuredLevels.ChunksPeak = averageSample / MEASURE_CHUNKS_COUNT;
+
+        return measuredLevels;
+    }
+
+    void AccumulatePeak(PeakLevelAccumulator& levelAccumulator, float currentPeak, size_t samplesCount)
+    {
+        auto& levelHistory = levelAccumulator.LevelHistory;
+
+        if (levelHistory.IsEmpty())
+        {
+            levelHistory.Push(currentPeak);
+            levelAccumulator.SamplesCount = samplesCount;
+            return;
+        }
+
+        levelAccumulator.SamplesCount += samplesCount;
+
+        if (levelAccumulator.SamplesCount >= sampleRate_)
+        {
+            levelAccumulator.SamplesCount = 0;
+            levelHistory.Push(currentPeak);
+        }
+        else
+        {
+            levelHistory.RaiseLast(currentPeak);
+        }
+    }
+
+    template<typename Slot>
+    static std::vector<std::string> NamesBySlot(const std::map<std::string, Slot>& slots)
+    {
+        std::vector<std::string> names(slots.size());
+
+        for (const auto& slot : slots)
+        {
+            names[slot.second] = slot.first;
         }
 
-        return averageSample / MEASURE_CHUNKS_COUNT;
+        return names;
     }
 
 public:
-    PipelineReflection(unsigned sampleRate, int peakMonitoringPeriodSeconds)
+    PipelineReflection(unsigned sampleRate, int channelsCount, int peakMonitoringPeriodSeconds, size_t meteringDecimation = 1,
+                       const std::vector<float>& loudnessChannelWeights = {})
         : sampleRate_(sampleRate)
+        , channelsCount_(channelsCount)
         , peakMonitoringPeriodSeconds_(peakMonitoringPeriodSeconds)
+        , meteringDecimation_(meteringDecimation > 0 ? meteringDecimation : 1)
+        , loudnessChannelWeights_(loudnessChannelWeights)
+        , isShared_(false)
     {
     }
 
-    void PushPeakLevel(const std::string bindingName, const Buffers::SingleBuffer<PCMTYPE>& samplesBuffer)
+    ~PipelineReflection()
     {
-        float currentPeak = MeasurePeaks(samplesBuffer);
+        // Analyzer threads publish variables, stop them while everything else is still alive
+        for (auto& levelAccumulator : peakLevels_)
+        {
+            levelAccumulator.Spectrum.reset();
+        }
+    }
+
+    void IsShared(bool isShared) { isShared_ = isShared; }
 
-        if (peakLevels_.find(bindingName) != peakLevels_.end())
+    // Publishes every binding and variable registered so far to a shared memory segment
+    void ExportMeters(const std::string& segmentName)
+    {
+        metersExport_ = std::make_unique<SharedMetersExport>(segmentName, sampleRate_, NamesBySlot(peakLevelSlots_),
+            NamesBySlot(variableSlots_));
+
+        if (metersExport_->IsOpen() == false)
         {
-            auto& levelAccumulator = peakLevels_[bindingName];
+            metersExport_.reset();
+        }
+    }
 
-            levelAccumulator.SamplesCount += samplesBuffer.DataLengthSamples();
+    void CountBlock(size_t samplesCount)
+    {
+        if (metersExport_)
+        {
+            metersExport_->PublishBlock(samplesCount);
+        }
+    }
 
-            if (levelAccumulator.SamplesCount >= sampleRate_)
-            {
-                levelAccumulator.SamplesCount = 0;
+    // Registers the binding on first use; slots must all be resolved before processing starts
+    ReflectionSlot PeakLevelSlot(const std::string& bindingName)
+    {
+        auto slotIterator = peakLevelSlots_.find(bindingName);
 
-                if (levelAccumulator.LevelHistory.size() >= peakMonitoringPeriodSeconds_)
-                {
-                    levelAccumulator.LevelHistory.erase(levelAccumulator.LevelHistory.begin());
-                }
+        if (slotIterator != peakLevelSlots_.end())
+        {
+            return slotIterator->second;
+        }
 
-                levelAccumulator.LevelHistory.push_back(currentPeak);
-            }
-            else
-            {
-                auto& levelHistory = levelAccumulator.LevelHistory;
-                size_t historySize = levelHistory.size();
+        ReflectionSlot slot = peakLevels_.size();
 
-                if (currentPeak > levelHistory[historySize - 1])
-                {
-                    levelHistory[historySize - 1] = currentPeak;
-                }
-            }
+        peakLevels_.emplace_back(peakMonitoringPeriodSeconds_);
+        peakLevelSlots_[bindingName] = slot;
+
+        return slot;
+    }
+
+    ReflectionSlot VariableSlot(const std::string& variableName)
+    {
+        auto slotIterator = variableSlots_.find(variableName);
+
+        if (slotIterator != variableSlots_.end())
+        {
+            return slotIterator->second;
+        }
+
+        ReflectionSlot slot = variables_.size();
+
+        variables_.emplace_back(0.0f);
+        variableSlots_[variableName] = slot;
+
+        return slot;
+    }
+
+    // Resolves an auto gain binding, loudness bindings attach a loudness meter to the tap
+    LevelBinding LevelBindingSlot(const std::string& bindingName)
+    {
+        LevelBinding levelBinding;
+
+        auto separatorPosition = bindingName.rfind(':');
+
+        if (separatorPosition == std::string::npos)
+        {
+            levelBinding.Slot = PeakLevelSlot(bindingName);
+            return levelBinding;
+        }
+
+        auto windowName = String::toLower(bindingName.substr(separatorPosition + 1));
+
+        if (windowName == "momentary")
+        {
+            levelBinding.Window = LoudnessWindows::Momentary;
+        }
+        else if (windowName == "shortterm")
+        {
+            levelBinding.Window = LoudnessWindows::ShortTerm;
+        }
+        else if (windowName == "integrated")
+        {
+            levelBinding.Window = LoudnessWindows::Integrated;
         }
         else
         {
-            PeakLevelAccumulator levelAccumulator;
-            levelAccumulator.LevelHistory.push_back(currentPeak);
-            levelAccumulator.SamplesCount = samplesBuffer.DataLengthSamples();
+            throw std::invalid_argument("Binding \"" + bindingName + "\" has unknown loudness window \"" + windowName + "\"");
+        }
+
+        levelBinding.IsLoudness = true;
+        levelBinding.Slot = PeakLevelSlot(bindingName.substr(0, separatorPosition));
+
+        auto& levelAccumulator = peakLevels_[levelBinding.Slot];
+
+        if (levelAccumulator.Loudness == nullptr)
+        {
+            levelAccumulator.Loudness = std::make_unique<LoudnessMeter>(sampleRate_, channelsCount_, loudnessChannelWeights_);
+        }
+
+        return levelBinding;
+    }
+
+    // Starts a background spectrum analyzer on a binding already registered by the pipeline
+    void AttachSpectrum(const SpectrumTapDescription& tapDescription)
+    {
+        auto slotIterator = peakLevelSlots_.find(tapDescription.Binding);
+
+        if (slotIterator == peakLevelSlots_.end())
+        {
+            throw std::invalid_argument("Spectrum tap binding \"" + tapDescription.Binding + "\" is not a reflection tap");
+        }
+
+        auto& levelAccumulator = peakLevels_[slotIterator->second];
+
+        if (levelAccumulator.Spectrum)
+        {
+            throw std::invalid_argument("Spectrum tap binding \"" + tapDescription.Binding + "\" is used twice");
+        }
+
+        levelAccumulator.Spectrum = std::make_unique<SpectrumAnalyzer>(sampleRate_, channelsCount_, tapDescription, *this);
+    }
+
+    void PushPeakLevel(ReflectionSlot slot, const Buffers::SingleBuffer<PCMTYPE>& samplesBuffer)
+    {
+        auto& levelAccumulator = peakLevels_[slot];
+
+        // Only copies the block to the analyzer ring, never blocks
+        if (levelAccumulator.Spectrum)
+        {
+            levelAccumulator.Spectrum->Push(samplesBuffer);
+        }
+
+        // Loudness filters need every block, decimation does not apply
+        if (levelAccumulator.Loudness)
+        {
+            auto lock = Lock();
+            levelAccumulator.Loudness->Push(samplesBuffer);
+        }
+
+        // Counters are only touched by the stage pushing this binding
+        if (levelAccumulator.BlocksCount++ % meteringDecimation_ != 0)
+        {
+            levelAccumulator.SkippedSamplesCount += samplesBuffer.DataLengthSamples();
+            return;
+        }
+
+        auto measuredLevels = MeasureLevels(samplesBuffer);
+
+        size_t samplesCount = levelAccumulator.SkippedSamplesCount + samplesBuffer.DataLengthSamples();
+        levelAccumulator.SkippedSamplesCount = 0;
+
+        auto lock = Lock();
+
+        AccumulatePeak(levelAccumulator, measuredLevels.ChunksPeak, samplesCount);
+
+        if (metersExport_)
+        {
+            auto& blockLevels = measuredLevels.BlockLevels;
 
-            peakLevels_[bindingName] = levelAccumulator;
+            metersExport_->PublishLevel(slot, blockLevels.Peak, blockLevels.Rms(), blockLevels.ClipsCount, levelAccumulator.GetLevel());
         }
     }
 
-    float GetPeakLevel(const std::string bindingName)
+    float GetPeakLevel(ReflectionSlot slot)
     {
-        auto filteredPeakValueIterator = peakLevels_.find(bindingName);
+        auto lock = Lock();
+        return peakLevels_[slot].GetLevel();
+    }
+
+    void FlushPeakLevel(ReflectionSlot slot)
+    {
+        auto lock = Lock();
+
+        auto& levelHistory = peakLevels_[slot].LevelHistory;
+
+        // Never measured yet
+        if (levelHistory.IsEmpty())
+        {
+            return;
+        }
 
-        return filteredPeakValueIterator != peakLevels_.end() ? (*filteredPeakValueIterator).second.GetLevel() : 0;
+        levelHistory.Clear();
+        levelHistory.Push(0);
     }
 
-    void FlushPeakLevel(const std::string bindingName)
+    // Linear level, loudness is returned as 10^(LUFS / 20) so dB thresholds read as LUFS; 0 while nothing was measured
+    float GetLevel(const LevelBinding& levelBinding)
     {
-        if (peakLevels_.find(bindingName) != peakLevels_.end())
+        if (levelBinding.IsLoudness == false)
         {
-            auto& levelAccumulator = peakLevels_[bindingName];
-            levelAccumulator.LevelHistory.clear();
-            levelAccumulator.LevelHistory.push_back(0);
+            return GetPeakLevel(levelBinding.Slot);
         }
+
+        auto lock = Lock();
+
+        double loudness = peakLevels_[levelBinding.Slot].Loudness->Loudness(levelBinding.Window);
+
+        return std::isinf(loudness) ? 0 : Math::LogConversions::DecibelsToValue(static_cast<float>(loudness));
+    }
+
+    // Peaks always are, loudness only once its window filled
+    bool IsLevelMeasured(const LevelBinding& levelBinding)
+    {
+        if (levelBinding.IsLoudness == false)
+        {
+            return true;
+        }
+
+        auto lock = Lock();
+        return std::isinf(peakLevels_[levelBinding.Slot].Loudness->Loudness(levelBinding.Window)) == false;
+    }
+
+    // Restarts the measurement after the bound gain changed
+    void FlushLevel(const LevelBinding& levelBinding)
+    {
+        if (levelBinding.IsLoudness == false)
+        {
+            FlushPeakLevel(levelBinding.Slot);
+            return;
+        }
+
+        auto lock = Lock();
+        peakLevels_[levelBinding.Slot].Loudness->Reset();
+    }
+
+    void SetVariable(ReflectionSlot slot, float value)
+    {
+        auto lock = Lock();
+        variables_[slot] = value;
+
+        if (metersExport_)
+        {
+            metersExport_->PublishVariable(slot, value);
+        }
+    }
+
+    // Lock free, for variables with a single writer such as the spectrum analyzers
+    void PublishVariable(ReflectionSlot slot, float value)
+    {
+        variables_[slot].store(value, std::memory_order_relaxed);
+
+        if (metersExport_)
+        {
+            metersExport_->PublishVariable(slot, value);
+        }
+    }
+
+    float GetVariable(ReflectionSlot slot)
+    {
+        auto lock = Lock();
+        return variables_[slot];
     }
 
-    void SetVariable(const std::string variableName, float value)
+    // Lock free, may be a block behind a writer on another stage thread
+    float PeekVariable(ReflectionSlot slot) const
     {
-        variables_[variableName] = value;
+        return variables_[slot].load(std::memory_order_relaxed);
     }
 
-    float GetVariable(const std::string variableName)
+    std::vector<std::string> VariableNames() const
     {
-        auto variableIterator = variables_.find(variableName);
-        return variableIterator != variables_.end() ? (*variableIterator).second : 0.0;
+        return NamesBySlot(variableSlots_);
     }
 };
 
@@ -0,0 +1,202 @@
+#include "SharedMetersExport.h"
+
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace dePhonica {
+namespace Core {
+
+// Suffixes are tried in turn by all the instances of the process
+static std::atomic<unsigned> SegmentSuffixesCount(0);
+static const unsigned SegmentSuffixAttempts = 16;
+
+template<typename Entry>
+static void InitEntry(Entry* entry, const std::string& name)
+{
+    new (entry) Entry();
+
+    strncpy(entry->Name, name.c_str(), SHARED_METERS_NAME_LENGTH - 1);
+    entry->Name[SHARED_METERS_NAME_LENGTH - 1] = '\0';
+}
+
+SharedMetersExport::SharedMetersExport(const std::string& segmentName,
+                                       unsigned sampleRate,
+                                       const std::vector<std::string>& levelNames,
+                                       const std::vector<std::string>& variableNames)
+    : segmentName_(segmentName)
+    , segmentDevice_(0)
+    , segmentInode_(0)
+    , mapping_(nullptr)
+    , mappingSize_(SharedMetersSize(levelNames.size(), variableNames.size()))
+    , header_(nullptr)
+    , levels_(nullptr)
+    , variables_(nullptr)
+{
+    int segmentDescriptor = CreateSegment(segmentName_);
+
+    for (unsigned attempt = 0; segmentDescriptor < 0 && errno == EEXIST && attempt < SegmentSuffixAttempts; attempt++)
+    {
+        segmentName_ = segmentName + "-" + std::to_string(getpid()) + "-" + std::to_string(SegmentSuffixesCount++);
+        segmentDescriptor = CreateSegment(segmentName_);
+    }
+
+    if (segmentDescriptor < 0)
+    {
+        std::cerr << "Unable to create shared meters segment " << segmentName_ << ": " << strerror(errno) << std::endl;
+        return;
+    }
+
+    if (segmentName_ != segmentName)
+    {
+        std::cerr << "Shared meters segment " << segmentName << " is in use, publishing to " << segmentName_ << std::endl;
+    }
+
+    struct stat segmentStat;
+
+    if (fstat(segmentDescriptor, &segmentStat) == 0)
+    {
+        segmentDevice_ = segmentStat.st_dev;
+        segmentInode_ = segmentStat.st_ino;
+    }
+
+    if (ftruncate(segmentDescriptor, mappingSize_) != 0)
+    {
+        std::cerr << "Unable to size shared meters segment " << segmentName_ << ": " << strerror(errno) << std::endl;
+        close(segmentDescriptor);
+        shm_unlink(segmentName_.c_str());
+        return;
+    }
+
+    void* mapping = mmap(nullptr, mappingSize_, PROT_READ | PROT_WRITE, MAP_SHARED, segmentDescriptor, 0);
+    close(segmentDescriptor);
+
+    if (mapping == MAP_FAILED)
+    {
+        std::cerr << "Unable to map shared meters segment " << segmentName_ << ": " << strerror(errno) << std::endl;
+        shm_unlink(segmentName_.c_str());
+        return;
+    }
+
+    mapping_ = mapping;
+
+    auto mappingBytes = static_cast<char*>(mapping_);
+    header_ = new (mappingBytes) SharedMetersHeader();
+    levels_ = reinterpret_cast<SharedLevelEntry*>(mappingBytes + sizeof(SharedMetersHeader));
+    variables_ = reinterpret_cast<SharedVariableEntry*>(mappingBytes + sizeof(SharedMetersHeader) + levelNames.size() * sizeof(SharedLevelEntry));
+
+    for (size_t slot = 0; slot < levelNames.size(); slot++)
+    {
+        InitEntry(&levels_[slot], levelNames[slot]);
+    }
+
+    for (size_t slot = 0; slot < variableNames.size(); slot++)
+    {
+        InitEntry(&variables_[slot], variableNames[slot]);
+    }
+
+    header_->Version = SHARED_METERS_VERSION;
+    header_->SampleRate = sampleRate;
+    header_->LevelsCount = static_cast<uint32_t>(levelNames.size());
+    header_->VariablesCount = static_cast<uint32_t>(variableNames.size());
+    header_->WriterPid = static_cast<uint32_t>(getpid());
+
+    // Readers check the magic last, so they never see a half initialized segment
+    std::atomic_thread_fence(std::memory_order_release);
+    header_->Magic = SHARED_METERS_MAGIC;
+}
+
+SharedMetersExport::~SharedMetersExport()
+{
+    if (mapping_ == nullptr)
+    {
+        return;
+    }
+
+    munmap(mapping_, mappingSize_);
+
+    // Only unlinks the segment created here
+    int segmentDescriptor = shm_open(segmentName_.c_str(), O_RDONLY, 0);
+
+    if (segmentDescriptor < 0)
+    {
+        return;
+    }
+
+    struct stat segmentStat;
+    bool isOwnSegment = fstat(segmentDescriptor, &segmentStat) == 0 &&
+                        segmentStat.st_dev == segmentDevice_ && segmentStat.st_ino == segmentInode_;
+    close(segmentDescriptor);
+
+    if (isOwnSegment)
+    {
+        shm_unlink(segmentName_.c_str());
+    }
+}
+
+int SharedMetersExport::CreateSegment(const std::string& segmentName)
+{
+    int segmentDescriptor = shm_open(segmentName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+
+    if (segmentDescriptor >= 0 || errno != EEXIST)
+    {
+        return segmentDescriptor;
+    }
+
+    if (IsSegmentStale(segmentName) == false)
+    {
+        errno = EEXIST;
+        return -1;
+    }
+
+    shm_unlink(segmentName.c_str());
+
+    return shm_open(segmentName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+}
+
+bool SharedMetersExport::IsSegmentStale(const std::string& segmentName)
+{
+    int segmentDescriptor = shm_open(segmentName.c_str(), O_RDONLY, 0);
+
+    if (segmentDescriptor < 0)
+    {
+        return false;
+    }
+
+    struct stat segmentStat;
+
+    if (fstat(segmentDescriptor, &segmentStat) != 0 || static_cast<size_t>(segmentStat.st_size) < sizeof(SharedMetersHeader))
+    {
+        close(segmentDescriptor);
+        return false;
+    }
+
+    void* mapping = mmap(nullptr, sizeof(SharedMetersHeader), PROT_READ, MAP_SHARED, segmentDescriptor, 0);
+    close(segmentDescriptor);
+
+    if (mapping == MAP_FAILED)
+    {
+        return false;
+    }
+
+    auto header = static_cast<const SharedMetersHeader*>(mapping);
+
+    // Segments of other versions or still being initialized are left alone
+    bool isStale = header->Magic == SHARED_METERS_MAGIC && header->Version == SHARED_METERS_VERSION && header->WriterPid != 0 &&
+                   kill(static_cast<pid_t>(header->WriterPid), 0) != 0 && errno == ESRCH;
+
+    munmap(mapping, sizeof(SharedMetersHeader));
+
+    return isStale;
+}
+
+} // namespace Core
+} // namespace dePhonica
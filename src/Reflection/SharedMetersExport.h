@@ -0,0 +1,93 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "SharedMetersLayout.h"
+
+namespace dePhonica {
+namespace Core {
+
+// Publishes reflection levels and variables into a POSIX shared memory segment.
+// Writes are plain stores guarded by per-entry sequence counters: no locks and no system calls after construction.
+// Segments are only ever created here, never shared: when the name is taken by a live process, as with hosts that
+// instantiate a plug-in once per channel, the instance publishes to "<name>-<pid>-<n>" instead.
+class SharedMetersExport
+{
+private:
+    std::string segmentName_;
+    // Identifies the segment created here, the name may have been reclaimed by someone else by destruction time
+    dev_t segmentDevice_;
+    ino_t segmentInode_;
+
+    void* mapping_;
+    size_t mappingSize_;
+
+    SharedMetersHeader* header_;
+    SharedLevelEntry* levels_;
+    SharedVariableEntry* variables_;
+
+    // Exclusive, a segment whose writer is gone is unlinked and created anew
+    static int CreateSegment(const std::string& segmentName);
+    static bool IsSegmentStale(const std::string& segmentName);
+
+    template<typename Entry>
+    static void BeginWrite(Entry& entry)
+    {
+        entry.Sequence.store(entry.Sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    template<typename Entry>
+    static void EndWrite(Entry& entry)
+    {
+        entry.Sequence.store(entry.Sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+public:
+    SharedMetersExport(const std::string& segmentName,
+                       unsigned sampleRate,
+                       const std::vector<std::string>& levelNames,
+                       const std::vector<std::string>& variableNames);
+    ~SharedMetersExport();
+
+    SharedMetersExport(const SharedMetersExport&) = delete;
+    SharedMetersExport& operator=(const SharedMetersExport&) = delete;
+
+    bool IsOpen() const { return header_ != nullptr; }
+
+    // Name actually published to, suffixed when the configured one was in use
+    const std::string& SegmentName() const { return segmentName_; }
+
+    void PublishLevel(size_t slot, float peak, float rms, size_t clipsCount, float heldPeak)
+    {
+        auto& entry = levels_[slot];
+
+        BeginWrite(entry);
+        entry.Peak.store(peak, std::memory_order_relaxed);
+        entry.Rms.store(rms, std::memory_order_relaxed);
+        entry.HeldPeak.store(heldPeak, std::memory_order_relaxed);
+        entry.ClipsCount.store(entry.ClipsCount.load(std::memory_order_relaxed) + clipsCount, std::memory_order_relaxed);
+        EndWrite(entry);
+    }
+
+    void PublishVariable(size_t slot, float value)
+    {
+        auto& entry = variables_[slot];
+
+        BeginWrite(entry);
+        entry.Value.store(value, std::memory_order_relaxed);
+        EndWrite(entry);
+    }
+
+    void PublishBlock(size_t samplesCount)
+    {
+        header_->BlocksCount.fetch_add(1, std::memory_order_relaxed);
+        header_->SamplesCount.fetch_add(samplesCount, std::memory_order_relaxed);
+    }
+};
+
+} // namespace Core
+} // namespace dePhonica
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#define SHARED_METERS_MAGIC         0x4d485044
+#define SHARED_METERS_VERSION       3
+#define SHARED_METERS_NAME_LENGTH   48
+
+namespace dePhonica {
+namespace Core {
+
+// Layout of the shared memory segment: the header, LevelsCount level entries, then VariablesCount variable entries.
+// Every entry carries its own sequence counter, odd while the writer updates it. Readers copy the values and retry
+// unless they saw the same even counter before and after the copy.
+
+struct SharedMetersHeader
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t SampleRate;
+    uint32_t LevelsCount;
+    uint32_t VariablesCount;
+    // Process publishing to the segment, tells segments left behind by a crashed host from live ones
+    uint32_t WriterPid;
+
+    std::atomic<uint64_t> BlocksCount;
+    std::atomic<uint64_t> SamplesCount;
+};
+
+struct SharedLevelEntry
+{
+    std::atomic<uint32_t> Sequence;
+    char Name[SHARED_METERS_NAME_LENGTH];
+
+    // Last block, linear
+    std::atomic<float> Peak;
+    std::atomic<float> Rms;
+    // Level auto gain controls see, held over the monitoring period
+    std::atomic<float> HeldPeak;
+    // Samples at or above full scale since the segment was created
+    std::atomic<uint64_t> ClipsCount;
+};
+
+struct SharedVariableEntry
+{
+    std::atomic<uint32_t> Sequence;
+    char Name[SHARED_METERS_NAME_LENGTH];
+
+    std::atomic<float> Value;
+};
+
+inline size_t SharedMetersSize(size_t levelsCount, size_t variablesCount)
+{
+    return sizeof(SharedMetersHeader) + levelsCount * sizeof(SharedLevelEntry) + variablesCount * sizeof(SharedVariableEntry);
+}
+
+} // namespace Core
+} // namespace dePhonica
@@ -0,0 +1,191 @@
+#include "SpectrumAnalyzer.h"
+#include "PipelineReflection.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include <pthread.h>
+
+#define SPECTRUM_LOWEST_BAND_HZ     20.0
+#define SPECTRUM_HIGHEST_BAND_HZ    20000.0
+#define SPECTRUM_POLL_PERIOD_MS     10
+
+namespace dePhonica {
+namespace Core {
+
+// At least a second, so host blocks fit while the analyzer thread sleeps
+static size_t RingSize(unsigned sampleRate, size_t fftSize)
+{
+    return std::max<size_t>(sampleRate, fftSize * 4);
+}
+
+SpectrumAnalyzer::SpectrumAnalyzer(unsigned sampleRate,
+                                   int channelsCount,
+                                   const SpectrumTapDescription& tapDescription,
+                                   PipelineReflection& pipelineReflection)
+    : pipelineReflection_(pipelineReflection)
+    , fftSize_(tapDescription.FftSize)
+    , hopSize_(tapDescription.FftSize / 2)
+    , channelRings_(channelsCount, Buffers::RingBuffer<PCMTYPE>(RingSize(sampleRate, tapDescription.FftSize)))
+    , droppedBlocksCount_(0)
+    , fftEngine_(tapDescription.FftSize)
+    , window_(tapDescription.Window, tapDescription.FftSize)
+    , frame_(tapDescription.FftSize)
+    , spectrum_(tapDescription.FftSize / 2 + 1)
+    , isStopping_(false)
+{
+    double windowSquaresSum = 0;
+
+    for (auto windowSample : window_.GetWindowData())
+    {
+        windowSquaresSum += windowSample * windowSample;
+    }
+
+    // A full scale sine sums up to fftSize * windowSquaresSum / 4 over the bins of its band
+    powerNormalization_ = 4.0 / (fftSize_ * windowSquaresSum * channelsCount);
+
+    double hopSeconds = static_cast<double>(hopSize_) / sampleRate;
+    averagingFactor_ = tapDescription.AveragingMs > 0 ? std::exp(-hopSeconds * 1000 / tapDescription.AveragingMs) : 0;
+
+    InitBands(sampleRate, tapDescription);
+
+    worker_ = std::thread(&SpectrumAnalyzer::Run, this);
+
+    // Analysis must never compete with the audio threads
+    sched_param schedulingParameters = {};
+    pthread_setschedparam(worker_.native_handle(), SCHED_IDLE, &schedulingParameters);
+}
+
+SpectrumAnalyzer::~SpectrumAnalyzer()
+{
+    isStopping_ = true;
+    worker_.join();
+}
+
+void SpectrumAnalyzer::InitBands(unsigned sampleRate, const SpectrumTapDescription& tapDescription)
+{
+    const int bandsPerOctave = std::max(1, tapDescription.BandsPerOctave);
+    const double binWidth = static_cast<double>(sampleRate) / fftSize_;
+    const double highestFrequency = std::min(SPECTRUM_HIGHEST_BAND_HZ, sampleRate * 0.45);
+    const double halfBandRatio = std::pow(2.0, 0.5 / bandsPerOctave);
+
+    // Centers are 1 kHz * 2^(k / N), the nominal ISO series for octaves and thirds
+    int firstBand = static_cast<int>(std::ceil(bandsPerOctave * std::log2(SPECTRUM_LOWEST_BAND_HZ / 1000)));
+    int lastBand = static_cast<int>(std::floor(bandsPerOctave * std::log2(highestFrequency / 1000)));
+
+    for (int bandIndex = firstBand; bandIndex <= lastBand; bandIndex++)
+    {
+        Band band;
+        band.CenterFrequency = 1000 * std::pow(2.0, static_cast<double>(bandIndex) / bandsPerOctave);
+        band.FirstBin = static_cast<size_t>(std::ceil(band.CenterFrequency / halfBandRatio / binWidth));
+        band.LastBin = std::min(static_cast<size_t>(std::ceil(band.CenterFrequency * halfBandRatio / binWidth)), spectrum_.size());
+        band.AveragePower = 0;
+
+        // Bands narrower than a bin use the closest bin
+        if (band.LastBin <= band.FirstBin)
+        {
+            band.FirstBin = std::min(static_cast<size_t>(std::round(band.CenterFrequency / binWidth)), spectrum_.size() - 1);
+            band.LastBin = band.FirstBin + 1;
+        }
+
+        char frequencyLabel[32];
+        snprintf(frequencyLabel, sizeof(frequencyLabel), band.CenterFrequency < 100 ? "%.1fHz" : "%.0fHz", band.CenterFrequency);
+
+        band.VariableSlot = pipelineReflection_.VariableSlot(tapDescription.Binding + ".spectrum." + frequencyLabel);
+
+        bands_.push_back(band);
+    }
+
+    framePowers_.resize(bands_.size());
+}
+
+void SpectrumAnalyzer::Push(const Buffers::SingleBuffer<PCMTYPE>& samplesBuffer)
+{
+    const size_t samplesCount = samplesBuffer.DataLengthSamples();
+    const int channelsCount = std::min(samplesBuffer.Channels(), static_cast<int>(channelRings_.size()));
+
+    // The analyzer only ever frees space, so the check holds for the pushes below
+    for (int channel = 0; channel < channelsCount; channel++)
+    {
+        if (channelRings_[channel].FreeSpace() < samplesCount)
+        {
+            droppedBlocksCount_++;
+            return;
+        }
+    }
+
+    for (int channel = 0; channel < channelsCount; channel++)
+    {
+        channelRings_[channel].Push(samplesBuffer.ChannelDataConst(channel), samplesCount);
+    }
+}
+
+size_t SpectrumAnalyzer::AvailableSamples()
+{
+    size_t availableSamples = fftSize_;
+
+    for (auto& channelRing : channelRings_)
+    {
+        availableSamples = std::min(availableSamples, channelRing.ReadSpans(fftSize_).Length());
+    }
+
+    return availableSamples;
+}
+
+void SpectrumAnalyzer::Run()
+{
+    while (isStopping_ == false)
+    {
+        if (AvailableSamples() < fftSize_)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(SPECTRUM_POLL_PERIOD_MS));
+            continue;
+        }
+
+        AnalyzeFrame();
+
+        // Frames overlap by half
+        for (auto& channelRing : channelRings_)
+        {
+            channelRing.CommitRead(hopSize_);
+        }
+    }
+}
+
+void SpectrumAnalyzer::AnalyzeFrame()
+{
+    std::fill(framePowers_.begin(), framePowers_.end(), 0.0);
+
+    for (auto& channelRing : channelRings_)
+    {
+        // Read in place, the frame stays in the ring until the hop is committed
+        auto frameSpans = channelRing.ReadSpans(fftSize_);
+
+        std::copy(frameSpans.First, frameSpans.First + frameSpans.FirstLength, frame_.begin());
+        std::copy(frameSpans.Second, frameSpans.Second + frameSpans.SecondLength, frame_.begin() + frameSpans.FirstLength);
+
+        window_.Apply(frame_);
+        fftEngine_.ExecuteR2C(frame_, spectrum_);
+
+        for (size_t bandIndex = 0; bandIndex < bands_.size(); bandIndex++)
+        {
+            for (size_t bin = bands_[bandIndex].FirstBin; bin < bands_[bandIndex].LastBin; bin++)
+            {
+                framePowers_[bandIndex] += std::norm(spectrum_[bin]);
+            }
+        }
+    }
+
+    for (size_t bandIndex = 0; bandIndex < bands_.size(); bandIndex++)
+    {
+        auto& band = bands_[bandIndex];
+
+        band.AveragePower = band.AveragePower * averagingFactor_ + framePowers_[bandIndex] * powerNormalization_ * (1 - averagingFactor_);
+
+        pipelineReflection_.PublishVariable(band.VariableSlot, 10 * std::log10(band.AveragePower + 1e-20));
+    }
+}
+
+} // namespace Core
+} // namespace dePhonica
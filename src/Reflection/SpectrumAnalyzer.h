@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <complex>
+#include <thread>
+#include <vector>
+
+#include "Buffers/RingBuffer.h"
+#include "Buffers/SingleBuffer.h"
+#include "FIR/FftEngineFftw.h"
+#include "FIR/WindowFunctions.h"
+#include "SpectrumTapDescription.h"
+#include "Configuration.h"
+
+namespace dePhonica {
+namespace Core {
+
+class PipelineReflection;
+
+// Averaged 1/N octave band levels of a reflection tap, published as "<binding>.spectrum.<center>Hz" variables in dB
+// relative to a full scale sine. The audio thread only copies blocks into a single-producer single-consumer ring,
+// frames are windowed and transformed on a background thread with idle priority.
+class SpectrumAnalyzer
+{
+private:
+    struct Band
+    {
+        double CenterFrequency;
+        size_t FirstBin, LastBin;
+
+        size_t VariableSlot;
+        double AveragePower;
+    };
+
+    PipelineReflection& pipelineReflection_;
+
+    size_t fftSize_, hopSize_;
+
+    // A block is pushed to every channel ring or to none of them
+    std::vector<Buffers::RingBuffer<PCMTYPE>> channelRings_;
+    size_t droppedBlocksCount_;
+
+    Fir::FftEngine fftEngine_;
+    Fir::WindowFunctions window_;
+
+    std::vector<PCMTYPE> frame_;
+    std::vector<std::complex<PCMTYPE>> spectrum_;
+    std::vector<double> framePowers_;
+
+    std::vector<Band> bands_;
+    double powerNormalization_, averagingFactor_;
+
+    std::atomic<bool> isStopping_;
+    std::thread worker_;
+
+    void InitBands(unsigned sampleRate, const SpectrumTapDescription& tapDescription);
+
+    void Run();
+    size_t AvailableSamples();
+    void AnalyzeFrame();
+
+public:
+    SpectrumAnalyzer(unsigned sampleRate, int channelsCount, const SpectrumTapDescription& tapDescription,
+        PipelineReflection& pipelineReflection);
+    ~SpectrumAnalyzer();
+
+    // Audio thread side, blocks that do not fit are dropped
+    void Push(const Buffers::SingleBuffer<PCMTYPE>& samplesBuffer);
+
+    size_t DroppedBlocksCount() const { return droppedBlocksCount_; }
+};
+
+} // namespace Core
+} // namespace dePhonica
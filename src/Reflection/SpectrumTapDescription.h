@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+
+#include "FIR/WindowFunctionTypes.h"
+#include "Configuration.h"
+
+namespace dePhonica {
+namespace Core {
+
+struct SpectrumTapDescription
+{
+    // Reflection tap the analyzer listens to, e.g. "input", "mixed", "postprocessed" or a graph node
+    std::string Binding;
+
+    size_t FftSize = 8192;
+    int BandsPerOctave = 3;
+
+    // Time constant of the exponential averaging of band powers
+    float AveragingMs = 500;
+
+    Fir::WindowFunctionTypes Window = Fir::WindowFunctionTypes::Blackman;
+};
+
+} // namespace Core
+} // namespace dePhonica
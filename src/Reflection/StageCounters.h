@@ -0,0 +1,223 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "Configuration.h"
+
+// Sub-bands past this one are not counted
+#define MAX_COUNTED_BANDS 16
+
+namespace dePhonica {
+namespace Core {
+
+enum class PipelineStages
+{
+    // The whole Push, only hands the block over in the pipelined mode
+    Push = 0,
+    Correction,
+    PreProcessing,
+    // Band copies and mixing
+    Mix,
+    Master,
+    // Peak metering, recorded once per correction, bands and master pass
+    Reflection,
+    // Sub-band processors, one counter each from here on
+    Band
+};
+
+#define PIPELINE_STAGES_COUNT (static_cast<size_t>(PipelineStages::Band) + MAX_COUNTED_BANDS)
+
+// Time stamp counter on x86, virtual counter on ARM, monotonic nanoseconds elsewhere
+using StageTicks = uint64_t;
+
+inline StageTicks ReadStageTicks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    StageTicks ticks;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<StageTicks>(now.tv_sec) * 1000000000 + now.tv_nsec;
+#endif
+}
+
+struct StageStatistics
+{
+    uint64_t Count = 0;
+    StageTicks MinTicks = 0;
+    double AverageTicks = 0;
+    StageTicks MaxTicks = 0;
+};
+
+// Min/avg/max ticks per pipeline stage. Stages may record from several threads in the pipelined mode,
+// readers take a snapshot without locking; count and total of a snapshot may be one record apart.
+// Everything compiles to nothing unless IsStageCounted.
+class StageCounters
+{
+private:
+    struct StageCounter
+    {
+        std::atomic<uint64_t> Count{0};
+        std::atomic<StageTicks> TotalTicks{0};
+        std::atomic<StageTicks> MinTicks{UINT64_MAX};
+        std::atomic<StageTicks> MaxTicks{0};
+    };
+
+    std::array<StageCounter, PIPELINE_STAGES_COUNT> counters_;
+
+    // Ticks since the last TakeCallTicks, for the flight recorder
+    std::array<std::atomic<StageTicks>, PIPELINE_STAGES_COUNT> callTicks_{};
+
+    static size_t StageIndex(PipelineStages stage, size_t bandIndex)
+    {
+        return static_cast<size_t>(stage) + (stage == PipelineStages::Band ? bandIndex : 0);
+    }
+
+public:
+    StageTicks Mark() const
+    {
+        if constexpr (IsStageCounted)
+        {
+            return ReadStageTicks();
+        }
+
+        return 0;
+    }
+
+    void Record(PipelineStages stage, StageTicks ticks, size_t bandIndex = 0)
+    {
+        if constexpr (IsStageCounted)
+        {
+            size_t stageIndex = StageIndex(stage, bandIndex);
+
+            if (stageIndex >= PIPELINE_STAGES_COUNT)
+            {
+                return;
+            }
+
+            auto& counter = counters_[stageIndex];
+
+            counter.Count.fetch_add(1, std::memory_order_relaxed);
+            counter.TotalTicks.fetch_add(ticks, std::memory_order_relaxed);
+            callTicks_[stageIndex].fetch_add(ticks, std::memory_order_relaxed);
+
+            StageTicks minTicks = counter.MinTicks.load(std::memory_order_relaxed);
+
+            while (ticks < minTicks && counter.MinTicks.compare_exchange_weak(minTicks, ticks, std::memory_order_relaxed) == false)
+            {
+            }
+
+            StageTicks maxTicks = counter.MaxTicks.load(std::memory_order_relaxed);
+
+            while (ticks > maxTicks && counter.MaxTicks.compare_exchange_weak(maxTicks, ticks, std::memory_order_relaxed) == false)
+            {
+            }
+        }
+    }
+
+    // Records the time since mark and returns the new mark, so back to back stages take one read each
+    StageTicks Lap(PipelineStages stage, StageTicks mark, size_t bandIndex = 0)
+    {
+        if constexpr (IsStageCounted)
+        {
+            StageTicks now = ReadStageTicks();
+            Record(stage, now - mark, bandIndex);
+
+            return now;
+        }
+
+        return 0;
+    }
+
+    // Adds the time since mark to a stage recorded later on, for stages spread over a loop
+    StageTicks Lap(StageTicks& accumulatedTicks, StageTicks mark) const
+    {
+        if constexpr (IsStageCounted)
+        {
+            StageTicks now = ReadStageTicks();
+            accumulatedTicks += now - mark;
+
+            return now;
+        }
+
+        return 0;
+    }
+
+    StageStatistics Statistics(PipelineStages stage, size_t bandIndex = 0) const
+    {
+        StageStatistics statistics;
+        size_t stageIndex = StageIndex(stage, bandIndex);
+
+        if (stageIndex >= PIPELINE_STAGES_COUNT)
+        {
+            return statistics;
+        }
+
+        const auto& counter = counters_[stageIndex];
+
+        statistics.Count = counter.Count.load(std::memory_order_relaxed);
+
+        if (statistics.Count > 0)
+        {
+            statistics.MinTicks = counter.MinTicks.load(std::memory_order_relaxed);
+            statistics.AverageTicks = static_cast<double>(counter.TotalTicks.load(std::memory_order_relaxed)) / statistics.Count;
+            statistics.MaxTicks = counter.MaxTicks.load(std::memory_order_relaxed);
+        }
+
+        return statistics;
+    }
+
+    // Moves the ticks recorded since the previous call into stageTicks, PIPELINE_STAGES_COUNT of them
+    void TakeCallTicks(StageTicks* stageTicks)
+    {
+        for (size_t stageIndex = 0; stageIndex < PIPELINE_STAGES_COUNT; stageIndex++)
+        {
+            stageTicks[stageIndex] = IsStageCounted ? callTicks_[stageIndex].exchange(0, std::memory_order_relaxed) : 0;
+        }
+    }
+
+    // Not synchronized with the recording, call while the pipeline is idle
+    void Reset()
+    {
+        for (auto& counter : counters_)
+        {
+            counter.Count.store(0, std::memory_order_relaxed);
+            counter.TotalTicks.store(0, std::memory_order_relaxed);
+            counter.MinTicks.store(UINT64_MAX, std::memory_order_relaxed);
+            counter.MaxTicks.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    // Measured against the steady clock for a few milliseconds, keep it off the audio thread
+    static double TicksPerSecond()
+    {
+        using Clock = std::chrono::steady_clock;
+
+        auto start = Clock::now();
+        StageTicks startTicks = ReadStageTicks();
+
+        while (Clock::now() - start < std::chrono::milliseconds(20))
+        {
+        }
+
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        return (ReadStageTicks() - startTicks) / seconds;
+    }
+};
+
+} // namespace Core
+} // namespace dePhonica
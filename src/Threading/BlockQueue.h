@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+namespace dePhonica {
+namespace Threading {
+
+// Bounded single producer / single consumer queue. Never locks and never allocates after construction.
+template<typename T>
+class BlockQueue
+{
+private:
+    std::vector<T> items_;
+    size_t indexMask_;
+
+    alignas(64) std::atomic<size_t> headIndex_;
+    alignas(64) std::atomic<size_t> tailIndex_;
+
+    static size_t RoundToPowerOfTwo(size_t value)
+    {
+        size_t result = 1;
+
+        while (result < value)
+        {
+            result <<= 1;
+        }
+
+        return result;
+    }
+
+public:
+    explicit BlockQueue(size_t capacity)
+        : items_(RoundToPowerOfTwo(capacity))
+        , indexMask_(items_.size() - 1)
+        , headIndex_(0)
+        , tailIndex_(0)
+    {
+    }
+
+    bool TryPush(const T& item)
+    {
+        size_t tailIndex = tailIndex_.load(std::memory_order_relaxed);
+
+        if (tailIndex - headIndex_.load(std::memory_order_acquire) >= items_.size())
+        {
+            return false;
+        }
+
+        items_[tailIndex & indexMask_] = item;
+        tailIndex_.store(tailIndex + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    bool TryPop(T& item)
+    {
+        size_t headIndex = headIndex_.load(std::memory_order_relaxed);
+
+        if (headIndex == tailIndex_.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        item = items_[headIndex & indexMask_];
+        headIndex_.store(headIndex + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    size_t Size() const { return tailIndex_.load(std::memory_order_acquire) - headIndex_.load(std::memory_order_acquire); }
+
+    size_t Capacity() const { return items_.size(); }
+};
+
+} // namespace Threading
+} // namespace dePhonica
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <errno.h>
+#include <semaphore.h>
+
+namespace dePhonica {
+namespace Threading {
+
+class Semaphore
+{
+private:
+    sem_t semaphore_;
+
+public:
+    Semaphore() { sem_init(&semaphore_, 0, 0); }
+    ~Semaphore() { sem_destroy(&semaphore_); }
+
+    Semaphore(const Semaphore&) = delete;
+    Semaphore& operator=(const Semaphore&) = delete;
+
+    // sem_post is async-signal-safe and does not block, so it may be called from the audio thread
+    void Post() { sem_post(&semaphore_); }
+
+    // Never blocks, consumes a pending post if there is one
+    bool TryWait() { return sem_trywait(&semaphore_) == 0; }
+
+    void Wait()
+    {
+        while (sem_wait(&semaphore_) != 0 && errno == EINTR)
+        {
+        }
+    }
+};
+
+} // namespace Threading
+} // namespace dePhonica
@@ -0,0 +1,754 @@
+// Offline batch renderer.
+//
+// Renders WAV or raw files through a pipeline description without a plug-in host. Every file gets a Pipeline of its own,
+// files are spread over worker threads, inputs and outputs are memory mapped and the pipeline is pushed in large blocks.
+// WAV inputs may hold 16, 24 or 32 bit integer or 32 bit float samples, raw inputs are interleaved 32 bit float with
+// the channels count of the description. Outputs are 32 bit float in the format of the input, with every pipeline output
+// after the other as extra channels, and have the length of the input: the initial FIR buffering is skipped instead of
+// being padded with silence like in the plug-in. Meters export, spectrum taps and the pipelined mode are turned off.
+//
+// With -s long files are split in segments rendered in parallel instead. Every segment starts rendering the pre-roll (-p)
+// ahead of its start to warm up filters, compressors and auto gain, and runs on over the crossfade (-x) into the next one.
+// States never match a sequential render exactly, -d renders the file sequentially as well and reports the largest
+// difference, to pick a pre-roll with a known error.
+//
+// Usage: batchrender [-j jobs] [-b block size] [-r raw sample rate] [-s segment seconds [-p pre-roll seconds] [-x crossfade ms] [-d]]
+//                    <description> <output directory> <input files...>
+//
+// Build: g++ -std=c++17 -O2 BatchRender.cpp $(ls ../*.cpp ../*/*.cpp ../IIR/spcc/*.cpp | grep -v -e LadspaWrapper -e FftEngineKiss -e Tools/)
+//        -I.. -I../FIR -I../IIR ../../lib/x64/libfftw3f.a -o batchrender -lpthread -lrt
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Pipeline.h"
+#include "PipelineDescription.h"
+
+using namespace dePhonica;
+using namespace dePhonica::Core;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+#define WAVE_HEADER_SIZE        44
+#define WAVE_FORMAT_PCM         1
+#define WAVE_FORMAT_FLOAT       3
+#define WAVE_FORMAT_EXTENSIBLE  0xFFFE
+
+enum class SampleFormats
+{
+    Int16 = 0,
+    Int24,
+    Int32,
+    Float32
+};
+
+struct AudioLayout
+{
+    bool IsWave = false;
+    SampleFormats SampleFormat = SampleFormats::Float32;
+    int ChannelsCount = 1;
+    unsigned SampleRate = 48000;
+
+    size_t DataOffset = 0;
+    size_t FramesCount = 0;
+
+    size_t FrameSize() const
+    {
+        static const size_t sampleSizes[] = { 2, 3, 4, 4 };
+        return sampleSizes[static_cast<int>(SampleFormat)] * ChannelsCount;
+    }
+};
+
+// Whole file mapping, read only for inputs, created with its final size for outputs
+class MappedFile
+{
+private:
+    uint8_t* data_;
+    size_t size_;
+
+    void Map(int fileDescriptor, size_t size, int protection, const std::string& fileName)
+    {
+        if (size > 0)
+        {
+            void* mapping = mmap(nullptr, size, protection, MAP_SHARED, fileDescriptor, 0);
+
+            if (mapping != MAP_FAILED)
+            {
+                data_ = static_cast<uint8_t*>(mapping);
+                size_ = size;
+            }
+        }
+
+        close(fileDescriptor);
+
+        if (size > 0 && data_ == nullptr)
+        {
+            throw std::runtime_error("Unable to map " + fileName);
+        }
+    }
+
+public:
+    explicit MappedFile(const std::string& fileName)
+        : data_(nullptr)
+        , size_(0)
+    {
+        int fileDescriptor = open(fileName.c_str(), O_RDONLY);
+        struct stat fileStatus;
+
+        if (fileDescriptor < 0 || fstat(fileDescriptor, &fileStatus) != 0)
+        {
+            throw std::runtime_error("Unable to open " + fileName);
+        }
+
+        Map(fileDescriptor, fileStatus.st_size, PROT_READ, fileName);
+
+        if (data_ != nullptr)
+        {
+            madvise(data_, size_, MADV_SEQUENTIAL);
+        }
+    }
+
+    MappedFile(const std::string& fileName, size_t size)
+        : data_(nullptr)
+        , size_(0)
+    {
+        int fileDescriptor = open(fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+        if (fileDescriptor < 0 || ftruncate(fileDescriptor, size) != 0)
+        {
+            throw std::runtime_error("Unable to create " + fileName);
+        }
+
+        Map(fileDescriptor, size, PROT_READ | PROT_WRITE, fileName);
+    }
+
+    ~MappedFile()
+    {
+        if (data_ != nullptr)
+        {
+            munmap(data_, size_);
+        }
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* Data() const { return data_; }
+    uint8_t* Data() { return data_; }
+    size_t Size() const { return size_; }
+};
+
+template<typename T>
+T ReadValue(const uint8_t* data)
+{
+    T value;
+    memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+template<typename T>
+void WriteValue(uint8_t* data, T value)
+{
+    memcpy(data, &value, sizeof(T));
+}
+
+AudioLayout ReadWaveLayout(const MappedFile& inputFile, const std::string& fileName)
+{
+    const uint8_t* data = inputFile.Data();
+    const size_t size = inputFile.Size();
+
+    AudioLayout layout;
+    layout.IsWave = true;
+
+    bool isFormatRead = false;
+    size_t chunkOffset = 12;
+
+    while (chunkOffset + 8 <= size)
+    {
+        const uint8_t* chunk = data + chunkOffset;
+        size_t chunkSize = ReadValue<uint32_t>(chunk + 4);
+        size_t chunkDataOffset = chunkOffset + 8;
+
+        if (memcmp(chunk, "fmt ", 4) == 0 && chunkSize >= 16 && chunkDataOffset + chunkSize <= size)
+        {
+            int formatTag = ReadValue<uint16_t>(chunk + 8);
+            int bitsPerSample = ReadValue<uint16_t>(chunk + 22);
+
+            // Extensible formats keep the actual tag at the start of the sub-format GUID
+            if (formatTag == WAVE_FORMAT_EXTENSIBLE && chunkSize >= 26)
+            {
+                formatTag = ReadValue<uint16_t>(chunk + 32);
+            }
+
+            layout.ChannelsCount = ReadValue<uint16_t>(chunk + 10);
+            layout.SampleRate = ReadValue<uint32_t>(chunk + 12);
+
+            if (formatTag == WAVE_FORMAT_PCM && bitsPerSample == 16)
+            {
+                layout.SampleFormat = SampleFormats::Int16;
+            }
+            else if (formatTag == WAVE_FORMAT_PCM && bitsPerSample == 24)
+            {
+                layout.SampleFormat = SampleFormats::Int24;
+            }
+            else if (formatTag == WAVE_FORMAT_PCM && bitsPerSample == 32)
+            {
+                layout.SampleFormat = SampleFormats::Int32;
+            }
+            else if (formatTag == WAVE_FORMAT_FLOAT && bitsPerSample == 32)
+            {
+                layout.SampleFormat = SampleFormats::Float32;
+            }
+            else
+            {
+                throw std::runtime_error(fileName + " has an unsupported sample format");
+            }
+
+            isFormatRead = true;
+        }
+
+        if (memcmp(chunk, "data", 4) == 0)
+        {
+            if (isFormatRead == false || layout.ChannelsCount < 1)
+            {
+                throw std::runtime_error(fileName + " has no format before the data");
+            }
+
+            // Recorders that were cut short leave the size unset, the data then runs to the end of the file
+            size_t dataSize = std::min(chunkSize, size - chunkDataOffset);
+
+            layout.DataOffset = chunkDataOffset;
+            layout.FramesCount = dataSize / layout.FrameSize();
+
+            return layout;
+        }
+
+        chunkOffset = chunkDataOffset + chunkSize + (chunkSize & 1);
+    }
+
+    throw std::runtime_error(fileName + " has no data");
+}
+
+AudioLayout ReadLayout(const MappedFile& inputFile, const std::string& fileName, int channelsCount, unsigned rawSampleRate)
+{
+    const uint8_t* data = inputFile.Data();
+
+    if (inputFile.Size() >= 12 && memcmp(data, "RIFF", 4) == 0 && memcmp(data + 8, "WAVE", 4) == 0)
+    {
+        return ReadWaveLayout(inputFile, fileName);
+    }
+
+    AudioLayout layout;
+    layout.ChannelsCount = channelsCount;
+    layout.SampleRate = rawSampleRate;
+    layout.FramesCount = inputFile.Size() / layout.FrameSize();
+
+    return layout;
+}
+
+// Deinterleaves framesCount frames starting at firstFrame into the buffer
+void ReadFrames(const uint8_t* data, const AudioLayout& layout, size_t firstFrame, size_t framesCount,
+                Buffers::SingleBuffer<PCMTYPE>& buffer)
+{
+    const size_t frameSize = layout.FrameSize();
+    const size_t sampleSize = frameSize / layout.ChannelsCount;
+
+    for (int channel = 0; channel < layout.ChannelsCount; channel++)
+    {
+        PCMTYPE* channelData = buffer.ChannelData(channel);
+        const uint8_t* sample = data + layout.DataOffset + firstFrame * frameSize + channel * sampleSize;
+
+        for (size_t n = 0; n < framesCount; n++, sample += frameSize)
+        {
+            switch (layout.SampleFormat)
+            {
+            case SampleFormats::Int16:
+                channelData[n] = ReadValue<int16_t>(sample) / 32768.0f;
+                break;
+
+            case SampleFormats::Int24:
+                channelData[n] = static_cast<int32_t>(static_cast<uint32_t>(sample[0]) << 8 | static_cast<uint32_t>(sample[1]) << 16 |
+                                                      static_cast<uint32_t>(sample[2]) << 24) / 2147483648.0f;
+                break;
+
+            case SampleFormats::Int32:
+                channelData[n] = ReadValue<int32_t>(sample) / 2147483648.0f;
+                break;
+
+            case SampleFormats::Float32:
+                channelData[n] = ReadValue<float>(sample);
+                break;
+            }
+        }
+    }
+
+    buffer.DataLengthSamples(framesCount);
+}
+
+void WriteWaveHeader(uint8_t* data, int channelsCount, unsigned sampleRate, size_t framesCount)
+{
+    const uint32_t dataSize = static_cast<uint32_t>(framesCount * channelsCount * sizeof(float));
+
+    memcpy(data, "RIFF", 4);
+    WriteValue<uint32_t>(data + 4, WAVE_HEADER_SIZE - 8 + dataSize);
+    memcpy(data + 8, "WAVEfmt ", 8);
+    WriteValue<uint32_t>(data + 16, 16);
+    WriteValue<uint16_t>(data + 20, WAVE_FORMAT_FLOAT);
+    WriteValue<uint16_t>(data + 22, channelsCount);
+    WriteValue<uint32_t>(data + 24, sampleRate);
+    WriteValue<uint32_t>(data + 28, sampleRate * channelsCount * sizeof(float));
+    WriteValue<uint16_t>(data + 32, channelsCount * sizeof(float));
+    WriteValue<uint16_t>(data + 34, 32);
+    memcpy(data + 36, "data", 4);
+    WriteValue<uint32_t>(data + 40, dataSize);
+}
+
+// Runs function(index) for every index below count on up to jobsCount threads, the first exception is passed on
+template<typename Function>
+void ParallelFor(size_t count, int jobsCount, Function function)
+{
+    std::atomic<size_t> nextIndex(0);
+    std::exception_ptr firstException;
+    std::mutex exceptionMutex;
+
+    auto worker = [&]() {
+        for (size_t index = nextIndex++; index < count; index = nextIndex++)
+        {
+            try
+            {
+                function(index);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> exceptionLock(exceptionMutex);
+
+                if (firstException == nullptr)
+                {
+                    firstException = std::current_exception();
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+
+    for (int job = 1; job < std::min(jobsCount, static_cast<int>(count)); job++)
+    {
+        workers.emplace_back(worker);
+    }
+
+    worker();
+
+    for (auto& workerThread : workers)
+    {
+        workerThread.join();
+    }
+
+    if (firstException != nullptr)
+    {
+        std::rethrow_exception(firstException);
+    }
+}
+
+// Pushes the input from firstFrame on through a fresh pipeline and writes framesCount output frames aligned with it,
+// interleaved with all the output channels. Input past the range keeps feeding the pipeline delay, past the end of file it is silence.
+void RenderFrames(Pipeline& pipeline, const MappedFile& inputFile, const AudioLayout& layout, size_t firstFrame, size_t framesCount,
+                  size_t blockSize, float* outputFrames)
+{
+    const int outputChannelsCount = layout.ChannelsCount * static_cast<int>(pipeline.OutputsCount());
+
+    Buffers::SingleBuffer<PCMTYPE> inputBuffer(blockSize, layout.ChannelsCount);
+    inputBuffer.SampleRate(layout.SampleRate);
+
+    size_t framesRead = firstFrame, framesWritten = 0, silenceFramesPushed = 0;
+
+    // Enough silence to push out any FIR delay, bounded for pipelines that never produce output
+    const size_t maxSilenceFrames = std::max(framesCount, static_cast<size_t>(layout.SampleRate) * 10) + blockSize;
+
+    while (framesWritten < framesCount && silenceFramesPushed < maxSilenceFrames)
+    {
+        size_t framesToRead = std::min(blockSize, layout.FramesCount - framesRead);
+
+        if (framesToRead > 0)
+        {
+            ReadFrames(inputFile.Data(), layout, framesRead, framesToRead, inputBuffer);
+            framesRead += framesToRead;
+        }
+        else
+        {
+            for (int channel = 0; channel < layout.ChannelsCount; channel++)
+            {
+                std::fill(inputBuffer.ChannelData(channel), inputBuffer.ChannelData(channel) + blockSize, 0.0f);
+            }
+
+            inputBuffer.DataLengthSamples(blockSize);
+            silenceFramesPushed += blockSize;
+        }
+
+        pipeline.Push(inputBuffer);
+
+        const auto& resultBuffer = pipeline.Pop();
+        size_t framesToWrite = std::min(resultBuffer.DataLengthSamples(), framesCount - framesWritten);
+
+        float* targetFrames = outputFrames + framesWritten * outputChannelsCount;
+
+        for (int channel = 0; channel < outputChannelsCount; channel++)
+        {
+            const PCMTYPE* resultData = resultBuffer.ChannelDataConst(channel);
+
+            for (size_t n = 0; n < framesToWrite; n++)
+            {
+                targetFrames[n * outputChannelsCount + channel] = resultData[n];
+            }
+        }
+
+        framesWritten += framesToWrite;
+    }
+}
+
+struct SegmentOptions
+{
+    // Zero renders every file in one piece
+    double SegmentSeconds = 0;
+    double PreRollSeconds = 1.0;
+    double CrossfadeMs = 10.0;
+
+    bool IsDeviationReported = false;
+};
+
+struct RenderResult
+{
+    size_t FramesCount = 0;
+    unsigned SampleRate = 0;
+    double Seconds = 0;
+
+    size_t SegmentsCount = 1;
+    double MaxDeviation = 0;
+    size_t MaxDeviationFrame = 0;
+};
+
+class BatchRenderer
+{
+private:
+    const PipelineDescription& pipelineDescription_;
+    const std::string outputDirectory_;
+    const size_t blockSize_;
+    const unsigned rawSampleRate_;
+    const SegmentOptions segmentOptions_;
+    const int jobsCount_;
+
+    RenderResult RenderFile(const std::string& inputFileName, const std::string& outputFileName) const;
+
+    // Splits the file in segments rendered on all the jobs, each one warmed up over the pre-roll ahead of it and crossfaded
+    // into the previous one over the crossfade after its start
+    void RenderSegments(const MappedFile& inputFile, const AudioLayout& layout, int outputChannelsCount, float* outputFrames,
+                        RenderResult& result) const;
+
+public:
+    BatchRenderer(const PipelineDescription& pipelineDescription, const std::string& outputDirectory, size_t blockSize,
+                  unsigned rawSampleRate, const SegmentOptions& segmentOptions, int jobsCount)
+        : pipelineDescription_(pipelineDescription)
+        , outputDirectory_(outputDirectory)
+        , blockSize_(blockSize)
+        , rawSampleRate_(rawSampleRate)
+        , segmentOptions_(segmentOptions)
+        , jobsCount_(jobsCount)
+    {
+    }
+
+    // Returns the number of files that failed
+    int Render(const std::vector<std::string>& inputFileNames) const;
+};
+
+RenderResult BatchRenderer::RenderFile(const std::string& inputFileName, const std::string& outputFileName) const
+{
+    auto start = Clock::now();
+
+    MappedFile inputFile(inputFileName);
+    AudioLayout layout = ReadLayout(inputFile, inputFileName, pipelineDescription_.ChannelsCount, rawSampleRate_);
+
+    if (layout.ChannelsCount != pipelineDescription_.ChannelsCount)
+    {
+        throw std::runtime_error(inputFileName + " has " + std::to_string(layout.ChannelsCount) + " channels, the description expects " +
+                                 std::to_string(pipelineDescription_.ChannelsCount));
+    }
+
+    auto pipeline = std::make_unique<Pipeline>(layout.SampleRate, pipelineDescription_);
+    pipeline->Reserve(blockSize_);
+
+    const int outputChannelsCount = layout.ChannelsCount * static_cast<int>(pipeline->OutputsCount());
+    const size_t headerSize = layout.IsWave ? WAVE_HEADER_SIZE : 0;
+
+    MappedFile outputFile(outputFileName, headerSize + layout.FramesCount * outputChannelsCount * sizeof(float));
+
+    if (layout.IsWave)
+    {
+        WriteWaveHeader(outputFile.Data(), outputChannelsCount, layout.SampleRate, layout.FramesCount);
+    }
+
+    float* outputFrames = reinterpret_cast<float*>(outputFile.Data() + headerSize);
+
+    RenderResult result;
+    result.FramesCount = layout.FramesCount;
+    result.SampleRate = layout.SampleRate;
+
+    if (segmentOptions_.SegmentSeconds > 0)
+    {
+        pipeline.reset();
+        RenderSegments(inputFile, layout, outputChannelsCount, outputFrames, result);
+    }
+    else
+    {
+        RenderFrames(*pipeline, inputFile, layout, 0, layout.FramesCount, blockSize_, outputFrames);
+    }
+
+    result.Seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    if (segmentOptions_.IsDeviationReported)
+    {
+        std::vector<float> sequentialFrames(layout.FramesCount * outputChannelsCount);
+
+        Pipeline sequentialPipeline(layout.SampleRate, pipelineDescription_);
+        sequentialPipeline.Reserve(blockSize_);
+
+        RenderFrames(sequentialPipeline, inputFile, layout, 0, layout.FramesCount, blockSize_, sequentialFrames.data());
+
+        for (size_t n = 0; n < sequentialFrames.size(); n++)
+        {
+            double deviation = std::fabs(static_cast<double>(outputFrames[n]) - sequentialFrames[n]);
+
+            if (deviation > result.MaxDeviation)
+            {
+                result.MaxDeviation = deviation;
+                result.MaxDeviationFrame = n / outputChannelsCount;
+            }
+        }
+    }
+
+    return result;
+}
+
+void BatchRenderer::RenderSegments(const MappedFile& inputFile, const AudioLayout& layout, int outputChannelsCount, float* outputFrames,
+                                   RenderResult& result) const
+{
+    const size_t segmentFrames = std::max<size_t>(static_cast<size_t>(segmentOptions_.SegmentSeconds * layout.SampleRate), 1);
+    const size_t preRollFrames = static_cast<size_t>(segmentOptions_.PreRollSeconds * layout.SampleRate);
+    const size_t crossfadeFrames = std::min(static_cast<size_t>(segmentOptions_.CrossfadeMs * layout.SampleRate / 1000), segmentFrames);
+
+    const size_t segmentsCount = std::max<size_t>(1, (layout.FramesCount + segmentFrames - 1) / segmentFrames);
+
+    // Segments write everything but the crossfades straight to the output, those are mixed once all the segments are done
+    std::vector<std::vector<float>> segmentHeads(segmentsCount), segmentTails(segmentsCount);
+
+    ParallelFor(segmentsCount, jobsCount_, [&](size_t segment) {
+        const size_t segmentStart = segment * segmentFrames;
+        const size_t segmentStop = std::min(segmentStart + segmentFrames, layout.FramesCount);
+        const size_t headFrames = segment > 0 ? std::min(crossfadeFrames, segmentStop - segmentStart) : 0;
+        const size_t tailFrames = std::min(crossfadeFrames, layout.FramesCount - segmentStop);
+
+        const size_t renderStart = segmentStart - std::min(segmentStart, preRollFrames);
+        const size_t renderFrames = segmentStop + tailFrames - renderStart;
+
+        std::vector<float> renderedFrames(renderFrames * outputChannelsCount);
+
+        Pipeline pipeline(layout.SampleRate, pipelineDescription_);
+        pipeline.Reserve(blockSize_);
+
+        RenderFrames(pipeline, inputFile, layout, renderStart, renderFrames, blockSize_, renderedFrames.data());
+
+        auto segmentFrame = [&](size_t frame) { return renderedFrames.begin() + (frame - renderStart) * outputChannelsCount; };
+
+        segmentHeads[segment].assign(segmentFrame(segmentStart), segmentFrame(segmentStart + headFrames));
+        segmentTails[segment].assign(segmentFrame(segmentStop), segmentFrame(segmentStop + tailFrames));
+
+        std::copy(segmentFrame(segmentStart + headFrames), segmentFrame(segmentStop), outputFrames + (segmentStart + headFrames) * outputChannelsCount);
+    });
+
+    // Linear crossfades, both sides render the same material and stay in phase
+    for (size_t segment = 1; segment < segmentsCount; segment++)
+    {
+        const auto& head = segmentHeads[segment];
+        const auto& tail = segmentTails[segment - 1];
+
+        const size_t fadeFrames = head.size() / outputChannelsCount;
+        float* fadeOutput = outputFrames + segment * segmentFrames * outputChannelsCount;
+
+        for (size_t n = 0; n < fadeFrames; n++)
+        {
+            float fadeIn = (n + 0.5f) / fadeFrames;
+
+            for (int channel = 0; channel < outputChannelsCount; channel++)
+            {
+                size_t index = n * outputChannelsCount + channel;
+                fadeOutput[index] = tail[index] + (head[index] - tail[index]) * fadeIn;
+            }
+        }
+    }
+
+    result.SegmentsCount = segmentsCount;
+}
+
+int BatchRenderer::Render(const std::vector<std::string>& inputFileNames) const
+{
+    std::atomic<int> failuresCount(0);
+    std::mutex reportMutex;
+
+    double audioSeconds = 0;
+    auto start = Clock::now();
+
+    // Segmented files use all the jobs by themselves
+    int fileJobsCount = segmentOptions_.SegmentSeconds > 0 ? 1 : jobsCount_;
+
+    ParallelFor(inputFileNames.size(), fileJobsCount, [&](size_t fileIndex) {
+        const std::string& inputFileName = inputFileNames[fileIndex];
+        std::string outputFileName = outputDirectory_ + "/" + inputFileName.substr(inputFileName.find_last_of('/') + 1);
+
+        struct stat inputStatus, outputStatus;
+
+        try
+        {
+            // The input stays mapped while the output is written
+            if (stat(inputFileName.c_str(), &inputStatus) == 0 && stat(outputFileName.c_str(), &outputStatus) == 0 &&
+                inputStatus.st_dev == outputStatus.st_dev && inputStatus.st_ino == outputStatus.st_ino)
+            {
+                throw std::runtime_error("output would overwrite " + inputFileName);
+            }
+
+            RenderResult result = RenderFile(inputFileName, outputFileName);
+            double fileSeconds = static_cast<double>(result.FramesCount) / result.SampleRate;
+
+            std::lock_guard<std::mutex> reportLock(reportMutex);
+
+            audioSeconds += fileSeconds;
+            printf("%s: %.1f s of audio in %.2f s, %.1fx real time", inputFileName.c_str(), fileSeconds, result.Seconds,
+                   fileSeconds / result.Seconds);
+
+            if (result.SegmentsCount > 1)
+            {
+                printf(", %zu segments", result.SegmentsCount);
+            }
+
+            if (segmentOptions_.IsDeviationReported)
+            {
+                printf(", max deviation from sequential %.3g (%.1f dBFS) at %.3f s", result.MaxDeviation,
+                       20 * std::log10(std::max(result.MaxDeviation, 1e-30)), static_cast<double>(result.MaxDeviationFrame) / result.SampleRate);
+            }
+
+            printf("\n");
+        }
+        catch (const std::exception& e)
+        {
+            std::lock_guard<std::mutex> reportLock(reportMutex);
+
+            fprintf(stderr, "%s: %s\n", inputFileName.c_str(), e.what());
+            failuresCount++;
+        }
+    });
+
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    printf("%zu files, %.1f s of audio in %.2f s on %d jobs, %.1fx real time\n", inputFileNames.size(), audioSeconds, seconds, jobsCount_,
+           audioSeconds / seconds);
+
+    return failuresCount;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    int jobsCount = std::max(1u, std::thread::hardware_concurrency());
+    size_t blockSize = 65536;
+    unsigned rawSampleRate = 48000;
+    SegmentOptions segmentOptions;
+
+    int option;
+
+    while ((option = getopt(argc, argv, "j:b:r:s:p:x:d")) != -1)
+    {
+        switch (option)
+        {
+        case 'j':
+            jobsCount = std::max(1, atoi(optarg));
+            break;
+
+        case 'b':
+            blockSize = std::max(1, atoi(optarg));
+            break;
+
+        case 'r':
+            rawSampleRate = std::max(1, atoi(optarg));
+            break;
+
+        case 's':
+            segmentOptions.SegmentSeconds = std::max(0.0, atof(optarg));
+            break;
+
+        case 'p':
+            segmentOptions.PreRollSeconds = std::max(0.0, atof(optarg));
+            break;
+
+        case 'x':
+            segmentOptions.CrossfadeMs = std::max(0.0, atof(optarg));
+            break;
+
+        case 'd':
+            segmentOptions.IsDeviationReported = true;
+            break;
+
+        default:
+            return 1;
+        }
+    }
+
+    if (argc - optind < 3)
+    {
+        fprintf(stderr, "Usage: %s [-j jobs] [-b block size] [-r raw sample rate] [-s segment seconds [-p pre-roll seconds] "
+                        "[-x crossfade ms] [-d]] <description> <output directory> <input files...>\n",
+                argv[0]);
+        return 1;
+    }
+
+    PipelineDescription pipelineDescription;
+
+    try
+    {
+        pipelineDescription = PipelineDescription::FromFile(argv[optind]);
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "Unable to read %s: %s\n", argv[optind], e.what());
+        return 1;
+    }
+
+    // Pipelines of all the jobs would fight over the shared meters, taps and stage threads are of no use offline
+    pipelineDescription.SharedMetersName.clear();
+    pipelineDescription.SpectrumTaps.clear();
+    pipelineDescription.IsPipelined = false;
+    pipelineDescription.IsGraphPlanPrinted = false;
+
+    std::vector<std::string> inputFileNames(argv + optind + 2, argv + argc);
+
+    BatchRenderer batchRenderer(pipelineDescription, argv[optind + 1], blockSize, rawSampleRate, segmentOptions, jobsCount);
+
+    return batchRenderer.Render(inputFileNames) > 0 ? 1 : 0;
+}
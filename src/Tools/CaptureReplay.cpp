@@ -0,0 +1,359 @@
+// Replays a host capture against a pipeline description.
+//
+// Captures come from the "hostCapture" description key: the sizes of every run(), the intervals between calls,
+// activate() calls and, with "isAudioCaptured", the input audio. The replay drives a PipelineWrapper with exactly
+// that sequence, so FIR pre-buffering and the first block padding behave as they did on the host, flushing it
+// wherever the host activated. Captures without audio get a deterministic test signal. With -p calls are paced by
+// the captured intervals rather than run back to back, which brings scheduling and cache effects of the host closer.
+// Reports call time and load percentiles against samplesCount / sampleRate and the slowest calls with their place
+// in the capture. Output can be written as raw interleaved float with -o.
+//
+// Usage: capturereplay [-p] [-w worst calls listed] [-o output.raw] <description> <capture>
+//
+// Build: g++ -std=c++17 -O2 CaptureReplay.cpp $(ls ../*.cpp ../*/*.cpp ../IIR/spcc/*.cpp | grep -v -e LadspaWrapper -e FftEngineKiss -e Tools/)
+//        -I.. -I../FIR -I../IIR ../../lib/x64/libfftw3f.a -o capturereplay -lpthread -lrt
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "PipelineWrapper.h"
+#include "Reflection/HostCapture.h"
+
+using namespace dePhonica::Core;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct ReplayOptions
+{
+    bool IsPaced = false;
+    size_t WorstCallsCount = 10;
+    std::string OutputFileName;
+};
+
+struct CallTiming
+{
+    size_t EventIndex;
+    size_t SamplesCount;
+    uint32_t IntervalUs;
+    double Microseconds;
+    double Load;
+};
+
+double Percentile(std::vector<double> values, double percentile)
+{
+    if (values.empty())
+    {
+        return 0;
+    }
+
+    size_t index = std::min(values.size() - 1, static_cast<size_t>(std::ceil(percentile / 100 * values.size())) - (percentile > 0 ? 1 : 0));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+
+    return values[index];
+}
+
+class CaptureReplayer
+{
+private:
+    const ReplayOptions& options_;
+    const HostCaptureReader& capture_;
+
+    PipelineWrapper pipelineWrapper_;
+
+    std::vector<std::vector<LADSPA_Data>> inputs_, outputs_;
+    LADSPA_Data latency_;
+
+    size_t signalPosition_;
+
+    // Ports are sized for the largest captured call
+    void BindPorts(size_t maxSamplesCount);
+    void FillInput(const HostCaptureEvent& event);
+
+public:
+    CaptureReplayer(const std::string& descriptionFileName, const HostCaptureReader& capture, const ReplayOptions& options);
+
+    std::vector<CallTiming> Replay(FILE* outputFile);
+};
+
+PipelineDescription ReplayDescription(const std::string& descriptionFileName)
+{
+    auto pipelineDescription = PipelineDescription::FromFile(descriptionFileName);
+
+    // The capture being replayed may well be the one the description names
+    pipelineDescription.HostCaptureFile.clear();
+
+    return pipelineDescription;
+}
+
+CaptureReplayer::CaptureReplayer(const std::string& descriptionFileName, const HostCaptureReader& capture, const ReplayOptions& options)
+    : options_(options)
+    , capture_(capture)
+    , pipelineWrapper_(capture.Header().SampleRate, ReplayDescription(descriptionFileName))
+    , latency_(0)
+    , signalPosition_(0)
+{
+    if (pipelineWrapper_.PortLayout().Channels() != capture.Header().ChannelsCount)
+    {
+        throw std::invalid_argument("The capture has " + std::to_string(capture.Header().ChannelsCount) + " channels, the description " +
+                                    std::to_string(pipelineWrapper_.PortLayout().Channels()));
+    }
+
+    size_t maxSamplesCount = 1;
+
+    for (const auto& event : capture_.Events())
+    {
+        maxSamplesCount = std::max(maxSamplesCount, event.SamplesCount);
+    }
+
+    BindPorts(maxSamplesCount);
+}
+
+void CaptureReplayer::BindPorts(size_t maxSamplesCount)
+{
+    const auto& portLayout = pipelineWrapper_.PortLayout();
+
+    inputs_.assign(portLayout.Channels(), std::vector<LADSPA_Data>(maxSamplesCount));
+    outputs_.assign(portLayout.Channels() * portLayout.Outputs(), std::vector<LADSPA_Data>(maxSamplesCount));
+
+    for (int channel = 0; channel < portLayout.Channels(); channel++)
+    {
+        pipelineWrapper_.SetPortDataLocation(portLayout.PortIndex(PipelineWrapperPorts::Input, channel), inputs_[channel].data());
+
+        for (int output = 0; output < portLayout.Outputs(); output++)
+        {
+            pipelineWrapper_.SetPortDataLocation(portLayout.PortIndex(PipelineWrapperPorts::Output, channel, output),
+                                                 outputs_[output * portLayout.Channels() + channel].data());
+        }
+    }
+
+    pipelineWrapper_.SetPortDataLocation(portLayout.PortIndex(PipelineWrapperPorts::Latency), &latency_);
+}
+
+void CaptureReplayer::FillInput(const HostCaptureEvent& event)
+{
+    for (size_t channel = 0; channel < inputs_.size(); channel++)
+    {
+        auto& input = inputs_[channel];
+
+        if (event.IsAudio)
+        {
+            std::copy_n(capture_.ChannelSamples(event, static_cast<int>(channel)), event.SamplesCount, input.begin());
+            continue;
+        }
+
+        for (size_t n = 0; n < event.SamplesCount; n++)
+        {
+            size_t position = signalPosition_ + n;
+            input[n] = 0.5f * std::sin(position * 0.01f) + 0.3f * std::sin(position * 0.5f) * (position % 96000 < 48000);
+        }
+    }
+
+    signalPosition_ += event.SamplesCount;
+}
+
+std::vector<CallTiming> CaptureReplayer::Replay(FILE* outputFile)
+{
+    const auto& events = capture_.Events();
+    const double sampleRate = capture_.Header().SampleRate;
+
+    std::vector<CallTiming> timings;
+    timings.reserve(events.size());
+
+    std::vector<LADSPA_Data> interleaved;
+
+    // Hosts activate before the first run, a capture started late may not show it
+    if (events.empty() || events.front().IsActivate == false)
+    {
+        pipelineWrapper_.Flush();
+    }
+
+    auto callTime = Clock::now();
+
+    for (size_t eventIndex = 0; eventIndex < events.size(); eventIndex++)
+    {
+        const auto& event = events[eventIndex];
+
+        if (options_.IsPaced)
+        {
+            callTime += std::chrono::microseconds(event.IntervalUs);
+            std::this_thread::sleep_until(callTime);
+        }
+
+        if (event.IsActivate)
+        {
+            pipelineWrapper_.Flush();
+            continue;
+        }
+
+        FillInput(event);
+
+        auto start = Clock::now();
+        pipelineWrapper_.Process(event.SamplesCount);
+        double microseconds = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+        timings.push_back({ eventIndex, event.SamplesCount, event.IntervalUs, microseconds,
+                            event.SamplesCount > 0 ? microseconds * sampleRate / (event.SamplesCount * 1e6) : 0 });
+
+        if (outputFile != nullptr)
+        {
+            size_t outputChannels = outputs_.size();
+            interleaved.resize(event.SamplesCount * outputChannels);
+
+            for (size_t n = 0; n < event.SamplesCount; n++)
+            {
+                for (size_t channel = 0; channel < outputChannels; channel++)
+                {
+                    interleaved[n * outputChannels + channel] = outputs_[channel][n];
+                }
+            }
+
+            fwrite(interleaved.data(), sizeof(LADSPA_Data), interleaved.size(), outputFile);
+        }
+    }
+
+    return timings;
+}
+
+void PrintReport(const HostCaptureReader& capture, std::vector<CallTiming> timings, const ReplayOptions& options)
+{
+    const auto& header = capture.Header();
+
+    size_t activatesCount = std::count_if(capture.Events().begin(), capture.Events().end(),
+                                          [](const HostCaptureEvent& event) { return event.IsActivate; });
+
+    printf("%zu calls and %zu activates at %u Hz, %u channels%s\n", timings.size(), activatesCount, header.SampleRate,
+           header.ChannelsCount, header.IsAudioCaptured ? ", captured audio" : ", test signal");
+
+    if (header.DroppedCallsCount > 0 || header.DroppedAudioCallsCount > 0)
+    {
+        printf("  capture dropped %u calls and the audio of %u more\n", header.DroppedCallsCount, header.DroppedAudioCallsCount);
+    }
+
+    if (timings.empty())
+    {
+        return;
+    }
+
+    std::vector<double> microseconds, loads, sizes, intervals;
+
+    for (const auto& timing : timings)
+    {
+        microseconds.push_back(timing.Microseconds);
+        loads.push_back(timing.Load);
+        sizes.push_back(static_cast<double>(timing.SamplesCount));
+        intervals.push_back(timing.IntervalUs);
+    }
+
+    size_t missesCount = std::count_if(loads.begin(), loads.end(), [](double load) { return load > 1.0; });
+
+    printf("  size      p1 %8.0f       p50 %8.0f       p99 %8.0f       max %8.0f\n", Percentile(sizes, 1), Percentile(sizes, 50),
+           Percentile(sizes, 99), Percentile(sizes, 100));
+    printf("  interval  p1 %8.0f us    p50 %8.0f us    p99 %8.0f us    max %8.0f us\n", Percentile(intervals, 1),
+           Percentile(intervals, 50), Percentile(intervals, 99), Percentile(intervals, 100));
+    printf("  time     p50 %8.1f us    p99 %8.1f us  p99.9 %8.1f us    max %8.1f us\n", Percentile(microseconds, 50),
+           Percentile(microseconds, 99), Percentile(microseconds, 99.9), Percentile(microseconds, 100));
+    printf("  load     p50 %8.2f %%     p99 %8.2f %%   p99.9 %8.2f %%     max %8.2f %%     misses %zu\n", Percentile(loads, 50) * 100,
+           Percentile(loads, 99) * 100, Percentile(loads, 99.9) * 100, Percentile(loads, 100) * 100, missesCount);
+
+    size_t worstCount = std::min(options.WorstCallsCount, timings.size());
+
+    if (worstCount == 0)
+    {
+        return;
+    }
+
+    std::partial_sort(timings.begin(), timings.begin() + worstCount, timings.end(),
+                      [](const CallTiming& left, const CallTiming& right) { return left.Load > right.Load; });
+
+    printf("  worst calls:\n");
+
+    for (size_t index = 0; index < worstCount; index++)
+    {
+        const auto& timing = timings[index];
+
+        printf("    event %8zu  %6zu samples  after %8u us  took %9.1f us  load %7.2f %%\n", timing.EventIndex, timing.SamplesCount,
+               timing.IntervalUs, timing.Microseconds, timing.Load * 100);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    ReplayOptions options;
+
+    int option;
+
+    while ((option = getopt(argc, argv, "pw:o:")) != -1)
+    {
+        switch (option)
+        {
+        case 'p':
+            options.IsPaced = true;
+            break;
+
+        case 'w':
+            options.WorstCallsCount = static_cast<size_t>(std::max(0, atoi(optarg)));
+            break;
+
+        case 'o':
+            options.OutputFileName = optarg;
+            break;
+
+        default:
+            return 1;
+        }
+    }
+
+    if (argc - optind != 2)
+    {
+        fprintf(stderr, "Usage: %s [-p] [-w worst calls listed] [-o output.raw] <description> <capture>\n", argv[0]);
+        return 1;
+    }
+
+    try
+    {
+        HostCaptureReader capture(argv[optind + 1]);
+        CaptureReplayer replayer(argv[optind], capture, options);
+
+        FILE* outputFile = nullptr;
+
+        if (options.OutputFileName.empty() == false)
+        {
+            outputFile = fopen(options.OutputFileName.c_str(), "wb");
+
+            if (outputFile == nullptr)
+            {
+                fprintf(stderr, "Unable to create %s\n", options.OutputFileName.c_str());
+                return 1;
+            }
+        }
+
+        auto timings = replayer.Replay(outputFile);
+
+        if (outputFile != nullptr)
+        {
+            fclose(outputFile);
+        }
+
+        PrintReport(capture, timings, options);
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "Unable to replay: %s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
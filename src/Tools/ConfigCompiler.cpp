@@ -0,0 +1,68 @@
+// Pipeline description compiler.
+//
+// Parses a JSON pipeline description once, with the correction envelope files it refers to, and writes the compiled
+// binary description the plug-in maps at instantiate instead of parsing JSON. The result is loaded back and compared
+// before the tool reports success. The plug-in picks "/etc/dephonica/<name>.dphb" over "<name>.json" when both exist.
+//
+// Usage: configcompiler <description.json> <description.dphb>
+//
+// Build: g++ -std=c++17 -O2 ConfigCompiler.cpp ../PipelineDescription.cpp ../PipelineDescriptionBinary.cpp -I.. -I../FIR -I../IIR -o configcompiler
+
+#include <cstdio>
+#include <exception>
+#include <string>
+
+#include "PipelineDescription.h"
+#include "PipelineDescriptionBinary.h"
+
+using namespace dePhonica::Core;
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: %s <description.json> <description.dphb>\n", argv[0]);
+        return 1;
+    }
+
+    std::string jsonFileName = argv[1];
+    std::string binaryFileName = argv[2];
+
+    try
+    {
+        if (PipelineDescriptionBinary::IsBinaryFile(jsonFileName))
+        {
+            fprintf(stderr, "%s is already compiled\n", jsonFileName.c_str());
+            return 1;
+        }
+
+        auto pipelineDescription = PipelineDescription::FromFile(jsonFileName);
+        auto binaryDescription = PipelineDescriptionBinary::Compile(pipelineDescription);
+
+        PipelineDescriptionBinary::WriteFile(pipelineDescription, binaryFileName);
+
+        // Every field must survive the trip through the file
+        auto loadedDescription = PipelineDescriptionBinary::Load(binaryFileName);
+
+        if (PipelineDescriptionBinary::Compile(loadedDescription) != binaryDescription)
+        {
+            fprintf(stderr, "%s does not load back to the same description\n", binaryFileName.c_str());
+            return 1;
+        }
+
+        printf("%s: %zu bytes, %d channels, %zu sub-bands, %zu graph nodes, %zu correction points\n",
+               binaryFileName.c_str(),
+               binaryDescription.size(),
+               pipelineDescription.ChannelsCount,
+               pipelineDescription.SubBandProcessings.size(),
+               pipelineDescription.GraphNodes.size(),
+               pipelineDescription.CorrectionEnvelope.size());
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "Unable to compile %s: %s\n", jsonFileName.c_str(), e.what());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,441 @@
+// Tail latency simulator for host block sizes.
+//
+// Drives PipelineWrapper::Process the way hosts do and times every call with the monotonic clock against its deadline,
+// samplesCount / sampleRate. Every description runs these block sequences:
+//   fixed      - the same size on every call, for each of the block sizes
+//   jittered   - sizes spread uniformly over +-50% of each block size
+//   irregular  - ALSA mmap style: wake-ups of about one period with timer jitter, split in two calls wherever the transfer
+//                wraps around a buffer of 3 periods and a few frames, which leaves odd sizes and short tail calls
+// For each sequence it prints call time and load (time over deadline) percentiles, misses and a histogram of the load.
+// Loads near or over 100% are xruns on a real host, which is what initialSamplesBuffered and kernel sizes trade against.
+// Sizes are capped at 4096, the block size the wrapper reserves for by default.
+// Built with -DPIPELINE_STAGE_COUNTERS it also breaks the time down per pipeline stage.
+//
+// Usage: deadlinesimulator [-t audio seconds per sequence] [-w warm-up seconds] [-s sample rate] [-p fifo priority]
+//                          [-b block sizes, comma separated] [-r seed] <descriptions...>
+//
+// Build: g++ -std=c++17 -O2 DeadlineSimulator.cpp $(ls ../*.cpp ../*/*.cpp ../IIR/spcc/*.cpp | grep -v -e LadspaWrapper -e FftEngineKiss -e Tools/)
+//        -I.. -I../FIR -I../IIR ../../lib/x64/libfftw3f.a -o deadlinesimulator -lpthread -lrt
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "PipelineWrapper.h"
+
+using namespace dePhonica::Core;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+#define MAX_HOST_BLOCK_SIZE     4096
+
+struct SimulatorOptions
+{
+    double SecondsPerSequence = 30;
+    double WarmUpSeconds = 0.25;
+    unsigned SampleRate = 48000;
+    int FifoPriority = 0;
+    unsigned Seed = 1;
+    std::vector<size_t> BlockSizes = { 16, 64, 256, 1024, 4096 };
+};
+
+enum class SequenceTypes
+{
+    Fixed = 0,
+    Jittered,
+    Irregular
+};
+
+const char* SequenceTypeNames[] = { "fixed", "jittered", "irregular" };
+
+// Block sizes a host would hand over for totalSamples of audio
+std::vector<size_t> MakeSequence(SequenceTypes sequenceType, size_t blockSize, size_t totalSamples, std::mt19937& random)
+{
+    std::vector<size_t> sequence;
+    size_t samplesCount = 0;
+
+    std::uniform_real_distribution<double> jitter(-0.5, 0.5);
+
+    // Mmap area and position for the irregular sequence
+    const size_t bufferSize = blockSize * 3 + 37;
+    size_t bufferPosition = 0;
+
+    while (samplesCount < totalSamples)
+    {
+        size_t firstNew = sequence.size();
+
+        switch (sequenceType)
+        {
+        case SequenceTypes::Fixed:
+            sequence.push_back(blockSize);
+            break;
+
+        case SequenceTypes::Jittered:
+            sequence.push_back(static_cast<size_t>(std::max(1.0, std::round(blockSize * (1.0 + jitter(random))))));
+            break;
+
+        case SequenceTypes::Irregular:
+        {
+            // Timer wake-ups land a little early or late and take whatever is there
+            size_t available = static_cast<size_t>(std::max(1.0, std::round(blockSize * (1.0 + 0.1 * jitter(random)))));
+            size_t untilWrap = bufferSize - bufferPosition;
+
+            if (available > untilWrap)
+            {
+                sequence.push_back(untilWrap);
+                sequence.push_back(available - untilWrap);
+            }
+            else
+            {
+                sequence.push_back(available);
+            }
+
+            bufferPosition = (bufferPosition + available) % bufferSize;
+            break;
+        }
+        }
+
+        while (sequence.back() > MAX_HOST_BLOCK_SIZE)
+        {
+            size_t remainder = sequence.back() - MAX_HOST_BLOCK_SIZE;
+            sequence.back() = MAX_HOST_BLOCK_SIZE;
+            sequence.push_back(remainder);
+        }
+
+        for (size_t index = firstNew; index < sequence.size(); index++)
+        {
+            samplesCount += sequence[index];
+        }
+    }
+
+    return sequence;
+}
+
+double Percentile(std::vector<double> values, double percentile)
+{
+    if (values.empty())
+    {
+        return 0;
+    }
+
+    size_t index = std::min(values.size() - 1, static_cast<size_t>(std::ceil(percentile / 100 * values.size())) - (percentile > 0 ? 1 : 0));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+
+    return values[index];
+}
+
+void PrintStages(const StageCounters& stageCounters)
+{
+    static const double microsecondsPerTick = 1e6 / StageCounters::TicksPerSecond();
+
+    const char* stageNames[] = { "push", "correction", "preprocessing", "mix", "master", "reflection" };
+
+    auto printStage = [&](const std::string& name, const StageStatistics& statistics) {
+        if (statistics.Count > 0)
+        {
+            printf("    %-14s min %9.1f us   avg %9.1f us   max %9.1f us   %llu records\n", name.c_str(),
+                   statistics.MinTicks * microsecondsPerTick, statistics.AverageTicks * microsecondsPerTick,
+                   statistics.MaxTicks * microsecondsPerTick, static_cast<unsigned long long>(statistics.Count));
+        }
+    };
+
+    for (size_t stage = 0; stage < static_cast<size_t>(PipelineStages::Band); stage++)
+    {
+        printStage(stageNames[stage], stageCounters.Statistics(static_cast<PipelineStages>(stage)));
+    }
+
+    for (size_t bandIndex = 0; bandIndex < MAX_COUNTED_BANDS; bandIndex++)
+    {
+        printStage("band " + std::to_string(bandIndex + 1), stageCounters.Statistics(PipelineStages::Band, bandIndex));
+    }
+}
+
+void PrintHistogram(const std::vector<double>& loads)
+{
+    // Load in percent of the deadline, the last bucket is everything that missed it
+    const double bucketLimits[] = { 1, 2, 5, 10, 20, 50, 80, 100 };
+    const char* bucketNames[] = { "    <1%", "   1-2%", "   2-5%", "  5-10%", " 10-20%", " 20-50%", " 50-80%", "80-100%", "  >100%" };
+    const size_t bucketsCount = sizeof(bucketNames) / sizeof(bucketNames[0]);
+
+    std::vector<size_t> counts(bucketsCount, 0);
+
+    for (double load : loads)
+    {
+        size_t bucket = 0;
+
+        while (bucket < bucketsCount - 1 && load * 100 >= bucketLimits[bucket])
+        {
+            bucket++;
+        }
+
+        counts[bucket]++;
+    }
+
+    size_t maxCount = *std::max_element(counts.begin(), counts.end());
+
+    for (size_t bucket = 0; bucket < bucketsCount; bucket++)
+    {
+        // Logarithmic bars, so single outliers stay visible next to the bulk
+        int barLength = counts[bucket] > 0 ? 1 + static_cast<int>(39 * std::log(static_cast<double>(counts[bucket])) /
+                                                                  std::log(static_cast<double>(std::max<size_t>(maxCount, 2))))
+                                           : 0;
+
+        printf("    %s | %-40s %zu\n", bucketNames[bucket], std::string(barLength, '#').c_str(), counts[bucket]);
+    }
+}
+
+class DeadlineSimulator
+{
+private:
+    const SimulatorOptions& options_;
+
+    PipelineWrapper pipelineWrapper_;
+
+    std::vector<std::vector<LADSPA_Data>> inputs_, outputs_;
+    LADSPA_Data latency_;
+
+    // Deterministic input, the phase carries on from call to call
+    size_t signalPosition_;
+    unsigned signalSeed_;
+
+    void FillInput(size_t samplesCount);
+
+public:
+    DeadlineSimulator(const std::string& descriptionFileName, const SimulatorOptions& options);
+
+    void RunSequence(const std::string& title, const std::vector<size_t>& sequence);
+};
+
+DeadlineSimulator::DeadlineSimulator(const std::string& descriptionFileName, const SimulatorOptions& options)
+    : options_(options)
+    , pipelineWrapper_(options.SampleRate, descriptionFileName)
+    , latency_(0)
+    , signalPosition_(0)
+    , signalSeed_(1)
+{
+    const auto& portLayout = pipelineWrapper_.PortLayout();
+
+    inputs_.assign(portLayout.Channels(), std::vector<LADSPA_Data>(MAX_HOST_BLOCK_SIZE));
+    outputs_.assign(portLayout.Channels() * portLayout.Outputs(), std::vector<LADSPA_Data>(MAX_HOST_BLOCK_SIZE));
+
+    for (int channel = 0; channel < portLayout.Channels(); channel++)
+    {
+        pipelineWrapper_.SetPortDataLocation(portLayout.PortIndex(PipelineWrapperPorts::Input, channel), inputs_[channel].data());
+
+        for (int output = 0; output < portLayout.Outputs(); output++)
+        {
+            pipelineWrapper_.SetPortDataLocation(portLayout.PortIndex(PipelineWrapperPorts::Output, channel, output),
+                                                 outputs_[output * portLayout.Channels() + channel].data());
+        }
+    }
+
+    pipelineWrapper_.SetPortDataLocation(portLayout.PortIndex(PipelineWrapperPorts::Latency), &latency_);
+}
+
+void DeadlineSimulator::FillInput(size_t samplesCount)
+{
+    for (size_t n = 0; n < samplesCount; n++, signalPosition_++)
+    {
+        signalSeed_ = signalSeed_ * 1103515245 + 12345;
+
+        float value = 0.5f * std::sin(signalPosition_ * 0.01f) + 0.3f * std::sin(signalPosition_ * 0.5f) * (signalPosition_ % 96000 < 48000) +
+                      ((signalSeed_ >> 16) & 0x7fff) / 32768.0f * 0.05f;
+
+        for (auto& input : inputs_)
+        {
+            input[n] = value;
+        }
+    }
+}
+
+void DeadlineSimulator::RunSequence(const std::string& title, const std::vector<size_t>& sequence)
+{
+    // Activate, as a host would before starting the stream
+    pipelineWrapper_.Flush();
+    pipelineWrapper_.Counters().Reset();
+
+    std::vector<double> times, loads;
+    times.reserve(sequence.size());
+    loads.reserve(sequence.size());
+
+    const size_t warmUpSamples = static_cast<size_t>(options_.WarmUpSeconds * options_.SampleRate);
+    size_t samplesProcessed = 0;
+
+    for (size_t samplesCount : sequence)
+    {
+        FillInput(samplesCount);
+
+        if (samplesProcessed < warmUpSamples && samplesProcessed + samplesCount >= warmUpSamples)
+        {
+            pipelineWrapper_.Counters().Reset();
+        }
+
+        auto start = Clock::now();
+        pipelineWrapper_.Process(samplesCount);
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        if (samplesProcessed >= warmUpSamples)
+        {
+            times.push_back(seconds * 1e6);
+            loads.push_back(seconds * options_.SampleRate / samplesCount);
+        }
+
+        samplesProcessed += samplesCount;
+    }
+
+    size_t missesCount = std::count_if(loads.begin(), loads.end(), [](double load) { return load > 1.0; });
+
+    size_t minSize = *std::min_element(sequence.begin(), sequence.end());
+    size_t maxSize = *std::max_element(sequence.begin(), sequence.end());
+
+    printf("  %s: %zu calls, blocks of %zu to %zu samples\n", title.c_str(), times.size(), minSize, maxSize);
+    printf("    time  p50 %9.1f us   p99 %9.1f us   p99.9 %9.1f us   max %9.1f us\n", Percentile(times, 50), Percentile(times, 99),
+           Percentile(times, 99.9), Percentile(times, 100));
+    printf("    load  p50 %9.2f %%    p99 %9.2f %%    p99.9 %9.2f %%    max %9.2f %%    misses %zu\n", Percentile(loads, 50) * 100,
+           Percentile(loads, 99) * 100, Percentile(loads, 99.9) * 100, Percentile(loads, 100) * 100, missesCount);
+
+    PrintHistogram(loads);
+
+    if constexpr (dePhonica::IsStageCounted)
+    {
+        PrintStages(pipelineWrapper_.Counters());
+    }
+}
+
+std::vector<size_t> ParseBlockSizes(const char* text)
+{
+    std::vector<size_t> blockSizes;
+
+    for (const char* position = text; *position != 0;)
+    {
+        char* end;
+        long blockSize = strtol(position, &end, 10);
+
+        if (end == position)
+        {
+            break;
+        }
+
+        if (blockSize > 0)
+        {
+            blockSizes.push_back(std::min<size_t>(blockSize, MAX_HOST_BLOCK_SIZE));
+        }
+
+        position = *end == ',' ? end + 1 : end;
+    }
+
+    return blockSizes;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    SimulatorOptions options;
+
+    int option;
+
+    while ((option = getopt(argc, argv, "t:w:s:p:b:r:")) != -1)
+    {
+        switch (option)
+        {
+        case 't':
+            options.SecondsPerSequence = std::max(0.1, atof(optarg));
+            break;
+
+        case 'w':
+            options.WarmUpSeconds = std::max(0.0, atof(optarg));
+            break;
+
+        case 's':
+            options.SampleRate = std::max(8000, atoi(optarg));
+            break;
+
+        case 'p':
+            options.FifoPriority = std::max(0, atoi(optarg));
+            break;
+
+        case 'b':
+            options.BlockSizes = ParseBlockSizes(optarg);
+            break;
+
+        case 'r':
+            options.Seed = static_cast<unsigned>(atol(optarg));
+            break;
+
+        default:
+            return 1;
+        }
+    }
+
+    if (optind >= argc || options.BlockSizes.empty())
+    {
+        fprintf(stderr, "Usage: %s [-t audio seconds per sequence] [-w warm-up seconds] [-s sample rate] [-p fifo priority] "
+                        "[-b block sizes, comma separated] [-r seed] <descriptions...>\n", argv[0]);
+        return 1;
+    }
+
+    // Host audio threads run locked in memory and, when allowed, with real-time priority
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    {
+        fprintf(stderr, "Unable to lock memory, page faults will show up in the tail\n");
+    }
+
+    if (options.FifoPriority > 0)
+    {
+        sched_param schedulingParameters;
+        schedulingParameters.sched_priority = options.FifoPriority;
+
+        if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &schedulingParameters) != 0)
+        {
+            fprintf(stderr, "Unable to switch to SCHED_FIFO %d, running with the default policy\n", options.FifoPriority);
+        }
+    }
+
+    std::mt19937 random(options.Seed);
+    const size_t totalSamples = static_cast<size_t>((options.SecondsPerSequence + options.WarmUpSeconds) * options.SampleRate);
+
+    for (int argument = optind; argument < argc; argument++)
+    {
+        try
+        {
+            DeadlineSimulator deadlineSimulator(argv[argument], options);
+
+            printf("%s at %u Hz\n", argv[argument], options.SampleRate);
+
+            for (size_t blockSize : options.BlockSizes)
+            {
+                for (int sequenceType = 0; sequenceType < 3; sequenceType++)
+                {
+                    auto sequence = MakeSequence(static_cast<SequenceTypes>(sequenceType), blockSize, totalSamples, random);
+
+                    char title[64];
+                    snprintf(title, sizeof(title), "%s %zu", SequenceTypeNames[sequenceType], blockSize);
+
+                    deadlineSimulator.RunSequence(title, sequence);
+                }
+            }
+        }
+        catch (const std::exception& e)
+        {
+            fprintf(stderr, "Unable to simulate %s: %s\n", argv[argument], e.what());
+            return 1;
+        }
+    }
+
+    return 0;
+}
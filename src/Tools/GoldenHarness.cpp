@@ -0,0 +1,842 @@
+// Golden reference and tolerance regression harness.
+//
+// "record" runs a deterministic in-tree test signal through every stage of the descriptions given, with the default
+// scalar float paths, and stores the outputs as golden files. "compare" runs the same signal through the variants of
+// those stages and checks them against the golden outputs: the whole pipeline in pipelined mode, every stage fed with
+// irregular host blocks, bands processed in double and, with -v, int32. A golden directory recorded by one build can be
+// compared by another, which is how SIMD and other optimized kernels are checked against the scalar build.
+// Auto gains step once per block on levels metered elsewhere in the pipeline, stages with one are skipped by the
+// irregular and pipelined variants. Compressor gain jumps where the detector crosses the knee, int32 quantization moves
+// some crossings by a sample, so int32 is not compared by default and wants a looser max abs error.
+// Stages are the FIR correction, the pre-processing, every sub-band and the master processing on their own, plus the
+// whole pipeline; graph descriptions only have the latter. Bands on their own meter their input as the "input" level,
+// auto gains bound to other pipeline levels see none.
+// Every comparison reports the max abs error, the SNR of the output against its error and the largest magnitude response
+// deviation over the bins within 60 dB of the spectrum peak, against per-stage tolerances that -T overrides as
+// "stage:max abs error:min SNR dB:max response dB", stage being correction, band or pipeline.
+// Exits with 2 when any comparison is out of tolerance.
+//
+// Usage: goldenharness record|compare [-d golden directory] [-s signal seconds] [-r sample rate] [-v variant,...]
+//                      [-T stage:maxabs:snr:response] <descriptions...>
+//
+// Build: g++ -std=c++17 -O2 GoldenHarness.cpp $(ls ../*.cpp ../*/*.cpp ../IIR/spcc/*.cpp | grep -v -e LadspaWrapper -e FftEngineKiss -e Tools/)
+//        -I.. -I../FIR -I../IIR ../../lib/x64/libfftw3f.a -o goldenharness -lpthread -lrt
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "Pipeline.h"
+#include "PipelineBandProcessor.h"
+#include "PipelineDescription.h"
+#include "FIR/FftEngineFftw.h"
+#include "FIR/FirCorrector.h"
+#include "FIR/WindowFunctions.h"
+#include "Reflection/PipelineReflection.h"
+
+// "DPHG" in a little endian file
+#define GOLDEN_MAGIC                0x47485044
+#define GOLDEN_VERSION              1
+
+#define GOLDEN_BLOCK_SIZE           256
+#define RESPONSE_FFT_SIZE           4096
+#define RESPONSE_FLOOR_DB           60
+
+using namespace dePhonica;
+
+namespace {
+
+// Host block sizes of the "irregular" variant, cycled through
+const std::vector<size_t> IrregularBlockSizes = { 1, 17, 256, 1000, 64, 4096, 3, 480 };
+
+const std::vector<std::string> AllVariants = { "reference", "pipelined", "irregular", "double", "int32" };
+const std::vector<std::string> DefaultVariants = { "reference", "pipelined", "irregular", "double" };
+
+struct Tolerance
+{
+    double MaxAbsError;
+    double MinSnrDb;
+    double MaxResponseDb;
+};
+
+struct HarnessOptions
+{
+    std::string GoldenDirectory = "golden";
+    double SignalSeconds = 8;
+    unsigned SampleRate = 48000;
+    std::vector<std::string> Variants = DefaultVariants;
+
+    // By stage kind, a variant that rounds differently stays far inside these, a broken kernel does not
+    std::map<std::string, Tolerance> Tolerances = {
+        { "correction", { 1e-4, 90, 0.01 } },
+        { "band", { 1e-3, 70, 0.05 } },
+        { "pipeline", { 1e-3, 70, 0.05 } },
+    };
+};
+
+struct GoldenHeader
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t SampleRate;
+    int32_t ChannelsCount;
+    uint64_t FramesCount;
+    float SignalSeconds;
+    uint32_t Reserved;
+};
+
+// Planar output of a stage run over the whole signal
+struct StageOutput
+{
+    int ChannelsCount = 0;
+    size_t FramesCount = 0;
+    std::vector<float> Samples;
+
+    const float* Channel(int channel) const { return Samples.data() + channel * FramesCount; }
+};
+
+// Log sweep over the audio band, a multitone in bursts that push compressors in and out, noise decorrelated per channel
+// and an impulse every second. The same on every machine, nothing but integer and double arithmetic goes into it.
+// Peaks stay 6 dB below full scale, int32 bands saturate there and filter overshoot would make that the only finding.
+Buffers::SingleBuffer<PCMTYPE> MakeTestSignal(unsigned sampleRate, int channelsCount, double seconds)
+{
+    const size_t framesCount = static_cast<size_t>(seconds * sampleRate);
+    const double startFrequency = 20, endFrequency = 0.45 * sampleRate;
+    const double sweepRate = std::log(endFrequency / startFrequency) / seconds;
+    const double toneFrequencies[] = { 41, 97, 233, 587, 1399, 3301, 7919 };
+
+    Buffers::SingleBuffer<PCMTYPE> signal(std::max<size_t>(framesCount, 1), channelsCount);
+
+    for (int channel = 0; channel < channelsCount; channel++)
+    {
+        uint32_t seed = 1 + channel;
+        auto channelData = signal.ChannelData(channel);
+
+        for (size_t n = 0; n < framesCount; n++)
+        {
+            seed = seed * 1103515245 + 12345;
+
+            double time = static_cast<double>(n) / sampleRate;
+            double sweep = 0.15 * std::sin(2 * M_PI * startFrequency * (std::exp(sweepRate * time) - 1) / sweepRate);
+
+            double multitone = 0;
+
+            for (double frequency : toneFrequencies)
+            {
+                multitone += std::sin(2 * M_PI * frequency * time + channel);
+            }
+
+            double burst = (n / (sampleRate / 4)) % 3 == 0 ? 0.04 : 0.005;
+            double noise = 0.02 * (((seed >> 16) & 0x7fff) / 16384.0 - 1.0);
+            double impulse = n % sampleRate == sampleRate / 2 ? 0.25 : 0;
+
+            channelData[n] = static_cast<PCMTYPE>(std::max(-0.5, std::min(0.5, sweep + burst * multitone + noise + impulse)));
+        }
+    }
+
+    signal.SampleRate(static_cast<float>(sampleRate));
+    signal.DataLengthSamples(framesCount);
+
+    return signal;
+}
+
+class StageRunner
+{
+public:
+    virtual ~StageRunner() = default;
+
+    // Output is valid until the next call
+    virtual const Buffers::SingleBuffer<PCMTYPE>& Process(const Buffers::SingleBuffer<PCMTYPE>& inputBuffer) = 0;
+};
+
+class CorrectionRunner : public StageRunner
+{
+private:
+    Fir::FirCorrector firCorrector_;
+    Buffers::SingleBuffer<PCMTYPE> outputBuffer_;
+
+public:
+    CorrectionRunner(unsigned sampleRate, const Core::PipelineDescription& pipelineDescription)
+        : firCorrector_(sampleRate, pipelineDescription.ChannelsCount, pipelineDescription.CorrectionEnvelope,
+                        pipelineDescription.CorrectionGain, pipelineDescription.InitialSamplesBuffered)
+        , outputBuffer_(0, pipelineDescription.ChannelsCount)
+    {
+    }
+
+    const Buffers::SingleBuffer<PCMTYPE>& Process(const Buffers::SingleBuffer<PCMTYPE>& inputBuffer) override
+    {
+        firCorrector_.Process(inputBuffer, outputBuffer_);
+        return outputBuffer_;
+    }
+};
+
+class BandRunner : public StageRunner
+{
+private:
+    Core::PipelineReflection pipelineReflection_;
+    Core::ReflectionSlot inputSlot_;
+
+    std::unique_ptr<Core::PipelineBandProcessor> bandProcessor_;
+    Buffers::SingleBuffer<PCMTYPE> processingBuffer_;
+
+public:
+    BandRunner(unsigned sampleRate,
+               const Core::PipelineDescription& pipelineDescription,
+               const Core::PipelineBandDescription& bandDescription,
+               const std::string& processorName)
+        : pipelineReflection_(sampleRate, pipelineDescription.ChannelsCount, pipelineDescription.PeakMonitoringPeriodSeconds,
+                              pipelineDescription.MeteringDecimation)
+        , inputSlot_(pipelineReflection_.PeakLevelSlot("input"))
+        , bandProcessor_(Core::PipelineBandProcessor::Create(sampleRate, pipelineDescription.ChannelsCount, bandDescription,
+                                                             pipelineReflection_, processorName))
+        , processingBuffer_(0, pipelineDescription.ChannelsCount)
+    {
+        bandProcessor_->Reserve(pipelineDescription.MaxBlockSize);
+    }
+
+    const Buffers::SingleBuffer<PCMTYPE>& Process(const Buffers::SingleBuffer<PCMTYPE>& inputBuffer) override
+    {
+        pipelineReflection_.PushPeakLevel(inputSlot_, inputBuffer);
+
+        for (int channel = 0; channel < inputBuffer.Channels(); channel++)
+        {
+            processingBuffer_.CopyChannel(channel, inputBuffer.ChannelDataConst(channel), inputBuffer.DataLengthSamples());
+        }
+
+        processingBuffer_.SampleRate(inputBuffer.SampleRate());
+        processingBuffer_.DataLengthSamples(inputBuffer.DataLengthSamples());
+
+        bandProcessor_->Apply(processingBuffer_);
+
+        return processingBuffer_;
+    }
+};
+
+class PipelineRunner : public StageRunner
+{
+private:
+    Core::Pipeline pipeline_;
+
+public:
+    PipelineRunner(unsigned sampleRate, const Core::PipelineDescription& pipelineDescription)
+        : pipeline_(sampleRate, pipelineDescription)
+    {
+        pipeline_.Reserve(pipelineDescription.MaxBlockSize);
+
+        // Blocks are pushed faster than real time, stages must not be dropped for being late
+        pipeline_.Freewheel(true);
+    }
+
+    const Buffers::SingleBuffer<PCMTYPE>& Process(const Buffers::SingleBuffer<PCMTYPE>& inputBuffer) override
+    {
+        pipeline_.Push(inputBuffer);
+        return pipeline_.Pop();
+    }
+};
+
+struct Stage
+{
+    std::string Name;
+    std::string Kind;
+    std::unique_ptr<StageRunner> Runner;
+};
+
+std::string DescriptionName(const std::string& descriptionFileName)
+{
+    std::string name = descriptionFileName.substr(descriptionFileName.find_last_of('/') + 1);
+    return name.substr(0, name.find_last_of('.'));
+}
+
+Core::PipelineDescription LoadDescription(const std::string& descriptionFileName)
+{
+    auto pipelineDescription = Core::PipelineDescription::FromFile(descriptionFileName);
+
+    // Nothing but the audio path, a plug-in running next to the harness keeps its meters
+    pipelineDescription.SharedMetersName.clear();
+    pipelineDescription.SpectrumTaps.clear();
+    pipelineDescription.FlightRecorderFile.clear();
+    pipelineDescription.HostCaptureFile.clear();
+    pipelineDescription.IsGraphPlanPrinted = false;
+    pipelineDescription.IsPipelined = false;
+
+    return pipelineDescription;
+}
+
+void SetSampleType(Core::PipelineDescription& pipelineDescription, Core::SampleTypes sampleType)
+{
+    pipelineDescription.PreProcessing.SampleType = sampleType;
+    pipelineDescription.MasterProcessing.SampleType = sampleType;
+
+    for (auto& bandDescription : pipelineDescription.SubBandProcessings)
+    {
+        bandDescription.SampleType = sampleType;
+    }
+
+    for (auto& nodeDescription : pipelineDescription.GraphNodes)
+    {
+        nodeDescription.Band.SampleType = sampleType;
+    }
+}
+
+Core::PipelineDescription VariantDescription(Core::PipelineDescription pipelineDescription, const std::string& variant)
+{
+    if (variant == "pipelined")
+    {
+        pipelineDescription.IsPipelined = true;
+    }
+    else if (variant == "double")
+    {
+        SetSampleType(pipelineDescription, Core::SampleTypes::Double);
+    }
+    else if (variant == "int32")
+    {
+        SetSampleType(pipelineDescription, Core::SampleTypes::Int32);
+    }
+    else if (variant != "reference" && variant != "irregular")
+    {
+        throw std::invalid_argument("Unknown variant " + variant);
+    }
+
+    return pipelineDescription;
+}
+
+// Any auto gain in the pipeline, it steps per block on levels metered by other stages
+bool IsBlockTimingDependent(const Core::PipelineDescription& pipelineDescription)
+{
+    bool isDependent = pipelineDescription.PreProcessing.AutoGain.IsBypassed == false ||
+                       pipelineDescription.MasterProcessing.AutoGain.IsBypassed == false;
+
+    for (const auto& bandDescription : pipelineDescription.SubBandProcessings)
+    {
+        isDependent = isDependent || bandDescription.AutoGain.IsBypassed == false;
+    }
+
+    for (const auto& nodeDescription : pipelineDescription.GraphNodes)
+    {
+        isDependent = isDependent || (nodeDescription.NodeType == Core::PipelineNodeTypes::Band && nodeDescription.Band.AutoGain.IsBypassed == false);
+    }
+
+    return isDependent;
+}
+
+// Stages the variant changes, the ones it cannot be compared on are left without a runner.
+// Processors refer into the description, it has to outlive them.
+std::vector<Stage> BuildStages(unsigned sampleRate, const Core::PipelineDescription& pipelineDescription, const std::string& variant)
+{
+    bool isPipelineOnly = variant == "pipelined" || pipelineDescription.GraphNodes.size() > 0;
+    bool isCorrectionChanged = variant == "reference" || variant == "irregular";
+    bool isBlockTimingChanged = variant == "irregular" || variant == "pipelined";
+
+    std::vector<Stage> stages;
+
+    auto addBand = [&](const std::string& bandName, const Core::PipelineBandDescription& bandDescription) {
+        bool isSkipped = isBlockTimingChanged && bandDescription.AutoGain.IsBypassed == false;
+
+        stages.push_back({ bandName, "band",
+                           isSkipped ? nullptr : std::make_unique<BandRunner>(sampleRate, pipelineDescription, bandDescription, bandName) });
+    };
+
+    if (isPipelineOnly == false)
+    {
+        if (isCorrectionChanged)
+        {
+            stages.push_back({ "correction", "correction", std::make_unique<CorrectionRunner>(sampleRate, pipelineDescription) });
+        }
+
+        addBand("preprocessing", pipelineDescription.PreProcessing);
+
+        for (size_t bandIndex = 0; bandIndex < pipelineDescription.SubBandProcessings.size(); bandIndex++)
+        {
+            addBand("subband" + std::to_string(bandIndex + 1), pipelineDescription.SubBandProcessings[bandIndex]);
+        }
+
+        addBand("master", pipelineDescription.MasterProcessing);
+    }
+
+    bool isPipelineSkipped = isBlockTimingChanged && IsBlockTimingDependent(pipelineDescription);
+
+    stages.push_back({ "pipeline", "pipeline", isPipelineSkipped ? nullptr : std::make_unique<PipelineRunner>(sampleRate, pipelineDescription) });
+
+    return stages;
+}
+
+// Feeds the signal in blocks of the sizes given, cycled through, then silence until the output is as long as the signal.
+// FIR pre-buffering and pipelined mode hold the output back rather than delaying it, so the output stream lines up
+// with the input whatever the block sizes.
+StageOutput Render(StageRunner& runner, const Buffers::SingleBuffer<PCMTYPE>& signal, const std::vector<size_t>& blockSizes)
+{
+    const size_t signalFrames = signal.DataLengthSamples();
+
+    std::vector<std::vector<float>> channels;
+    Buffers::SingleBuffer<PCMTYPE> inputBuffer(*std::max_element(blockSizes.begin(), blockSizes.end()), signal.Channels());
+
+    size_t position = 0;
+
+    // A stage that never catches up is given up on at twice the signal, the length check fails it
+    for (size_t blockIndex = 0; (channels.empty() || channels[0].size() < signalFrames) && position < 2 * signalFrames;
+         blockIndex++)
+    {
+        size_t blockSize = blockSizes[blockIndex % blockSizes.size()];
+        size_t signalSamples = position < signalFrames ? std::min(blockSize, signalFrames - position) : 0;
+
+        for (int channel = 0; channel < signal.Channels(); channel++)
+        {
+            auto channelData = inputBuffer.ChannelData(channel);
+
+            std::copy_n(signal.ChannelDataConst(channel) + position, signalSamples, channelData);
+            std::fill(channelData + signalSamples, channelData + blockSize, 0.0f);
+        }
+
+        inputBuffer.SampleRate(signal.SampleRate());
+        inputBuffer.DataLengthSamples(blockSize);
+
+        const auto& outputBuffer = runner.Process(inputBuffer);
+        position += blockSize;
+
+        // Held back blocks may not have the output channels laid out yet
+        if (outputBuffer.DataLengthSamples() == 0)
+        {
+            continue;
+        }
+
+        channels.resize(std::max<size_t>(channels.size(), outputBuffer.Channels()));
+
+        for (int channel = 0; channel < outputBuffer.Channels(); channel++)
+        {
+            auto channelData = outputBuffer.ChannelDataConst(channel);
+            channels[channel].insert(channels[channel].end(), channelData, channelData + outputBuffer.DataLengthSamples());
+        }
+    }
+
+    StageOutput output;
+    output.ChannelsCount = static_cast<int>(channels.size());
+    output.FramesCount = signalFrames;
+
+    for (const auto& channel : channels)
+    {
+        output.FramesCount = std::min(output.FramesCount, channel.size());
+    }
+
+    for (const auto& channel : channels)
+    {
+        output.Samples.insert(output.Samples.end(), channel.begin(), channel.begin() + output.FramesCount);
+    }
+
+    return output;
+}
+
+std::string GoldenFileName(const HarnessOptions& options, const std::string& descriptionName, const std::string& stageName)
+{
+    return options.GoldenDirectory + "/" + descriptionName + "." + stageName + ".golden";
+}
+
+void WriteGolden(const std::string& fileName, const HarnessOptions& options, const StageOutput& output)
+{
+    GoldenHeader header = { GOLDEN_MAGIC, GOLDEN_VERSION, options.SampleRate, output.ChannelsCount, output.FramesCount,
+                            static_cast<float>(options.SignalSeconds), 0 };
+
+    FILE* goldenFile = fopen(fileName.c_str(), "wb");
+
+    if (goldenFile == nullptr)
+    {
+        throw std::invalid_argument("Unable to create " + fileName);
+    }
+
+    bool isWritten = fwrite(&header, sizeof(header), 1, goldenFile) == 1 &&
+                     fwrite(output.Samples.data(), sizeof(float), output.Samples.size(), goldenFile) == output.Samples.size();
+    isWritten = fclose(goldenFile) == 0 && isWritten;
+
+    if (isWritten == false)
+    {
+        throw std::invalid_argument("Unable to write " + fileName);
+    }
+}
+
+StageOutput ReadGolden(const std::string& fileName, const HarnessOptions& options)
+{
+    FILE* goldenFile = fopen(fileName.c_str(), "rb");
+
+    if (goldenFile == nullptr)
+    {
+        throw std::invalid_argument("Unable to open " + fileName + ", record it first");
+    }
+
+    GoldenHeader header;
+    bool isHeaderRead = fread(&header, sizeof(header), 1, goldenFile) == 1;
+
+    if (isHeaderRead == false || header.Magic != GOLDEN_MAGIC || header.Version != GOLDEN_VERSION)
+    {
+        fclose(goldenFile);
+        throw std::invalid_argument(fileName + " is not a golden output of this version");
+    }
+
+    if (header.SampleRate != options.SampleRate || header.SignalSeconds != static_cast<float>(options.SignalSeconds))
+    {
+        fclose(goldenFile);
+        throw std::invalid_argument(fileName + " was recorded at " + std::to_string(header.SampleRate) + " Hz with " +
+                                    std::to_string(header.SignalSeconds) + " s of signal");
+    }
+
+    StageOutput output;
+    output.ChannelsCount = header.ChannelsCount;
+    output.FramesCount = header.FramesCount;
+    output.Samples.resize(output.ChannelsCount * output.FramesCount);
+
+    bool isRead = fread(output.Samples.data(), sizeof(float), output.Samples.size(), goldenFile) == output.Samples.size();
+    fclose(goldenFile);
+
+    if (isRead == false)
+    {
+        throw std::invalid_argument(fileName + " is truncated");
+    }
+
+    return output;
+}
+
+// Welch power spectrum summed over channels, Blackman windowed with half overlap
+std::vector<double> PowerSpectrum(const StageOutput& output, Fir::FftEngine& fftEngine, Fir::WindowFunctions& window)
+{
+    std::vector<PCMTYPE> frame(RESPONSE_FFT_SIZE);
+    std::vector<std::complex<PCMTYPE>> spectrum(fftEngine.GetComplexSize());
+    std::vector<double> power(spectrum.size());
+
+    for (int channel = 0; channel < output.ChannelsCount; channel++)
+    {
+        for (size_t start = 0; start + RESPONSE_FFT_SIZE <= output.FramesCount; start += RESPONSE_FFT_SIZE / 2)
+        {
+            std::copy_n(output.Channel(channel) + start, RESPONSE_FFT_SIZE, frame.begin());
+            window.Apply(frame);
+
+            fftEngine.ExecuteR2C(frame, spectrum);
+
+            for (size_t bin = 0; bin < spectrum.size(); bin++)
+            {
+                power[bin] += std::norm(spectrum[bin]);
+            }
+        }
+    }
+
+    return power;
+}
+
+struct Deviation
+{
+    bool IsBitExact;
+    double MaxAbsError;
+    double SnrDb;
+    double ResponseDb;
+};
+
+Deviation Measure(const StageOutput& golden, const StageOutput& output, Fir::FftEngine& fftEngine, Fir::WindowFunctions& window)
+{
+    Deviation deviation = { true, 0, INFINITY, 0 };
+
+    double signalEnergy = 0, errorEnergy = 0;
+
+    for (size_t index = 0; index < golden.Samples.size(); index++)
+    {
+        double error = static_cast<double>(output.Samples[index]) - golden.Samples[index];
+
+        deviation.IsBitExact = deviation.IsBitExact && output.Samples[index] == golden.Samples[index];
+        deviation.MaxAbsError = std::max(deviation.MaxAbsError, std::fabs(error));
+
+        signalEnergy += static_cast<double>(golden.Samples[index]) * golden.Samples[index];
+        errorEnergy += error * error;
+    }
+
+    if (errorEnergy > 0)
+    {
+        deviation.SnrDb = signalEnergy > 0 ? 10 * std::log10(signalEnergy / errorEnergy) : -INFINITY;
+    }
+
+    if (deviation.IsBitExact)
+    {
+        return deviation;
+    }
+
+    auto goldenPower = PowerSpectrum(golden, fftEngine, window);
+    auto outputPower = PowerSpectrum(output, fftEngine, window);
+
+    double floorPower = *std::max_element(goldenPower.begin(), goldenPower.end()) * std::pow(10.0, -RESPONSE_FLOOR_DB / 10.0);
+
+    for (size_t bin = 0; bin < goldenPower.size(); bin++)
+    {
+        if (goldenPower[bin] > floorPower && goldenPower[bin] > 0)
+        {
+            double responseDb = 10 * std::log10(std::max(outputPower[bin], 1e-30) / goldenPower[bin]);
+            deviation.ResponseDb = std::max(deviation.ResponseDb, std::fabs(responseDb));
+        }
+    }
+
+    return deviation;
+}
+
+class GoldenHarness
+{
+private:
+    const HarnessOptions& options_;
+
+    Buffers::SingleBuffer<PCMTYPE> signal_;
+    int signalChannels_;
+
+    Fir::FftEngine fftEngine_;
+    Fir::WindowFunctions window_;
+
+    size_t comparisonsCount_, failuresCount_;
+
+    const Buffers::SingleBuffer<PCMTYPE>& Signal(int channelsCount)
+    {
+        if (channelsCount != signalChannels_)
+        {
+            signal_ = MakeTestSignal(options_.SampleRate, channelsCount, options_.SignalSeconds);
+            signalChannels_ = channelsCount;
+        }
+
+        return signal_;
+    }
+
+    void Compare(FILE* output,
+                 const std::string& descriptionName,
+                 const Stage& stage,
+                 const std::string& variant,
+                 const Buffers::SingleBuffer<PCMTYPE>& signal);
+
+public:
+    explicit GoldenHarness(const HarnessOptions& options)
+        : options_(options)
+        , signalChannels_(0)
+        , fftEngine_(RESPONSE_FFT_SIZE)
+        , window_(Fir::WindowFunctionTypes::Blackman, RESPONSE_FFT_SIZE)
+        , comparisonsCount_(0)
+        , failuresCount_(0)
+    {
+    }
+
+    void Record(FILE* output, const std::string& descriptionFileName);
+    void Compare(FILE* output, const std::string& descriptionFileName);
+
+    size_t FailuresCount() const { return failuresCount_; }
+    size_t ComparisonsCount() const { return comparisonsCount_; }
+};
+
+void GoldenHarness::Record(FILE* output, const std::string& descriptionFileName)
+{
+    auto pipelineDescription = LoadDescription(descriptionFileName);
+    auto descriptionName = DescriptionName(descriptionFileName);
+    const auto& signal = Signal(pipelineDescription.ChannelsCount);
+
+    for (auto& stage : BuildStages(options_.SampleRate, pipelineDescription, "reference"))
+    {
+        auto stageOutput = Render(*stage.Runner, signal, { GOLDEN_BLOCK_SIZE });
+        auto fileName = GoldenFileName(options_, descriptionName, stage.Name);
+
+        WriteGolden(fileName, options_, stageOutput);
+
+        fprintf(output, "%-40s %d channels, %zu frames\n", fileName.c_str(), stageOutput.ChannelsCount, stageOutput.FramesCount);
+        fflush(output);
+    }
+}
+
+void GoldenHarness::Compare(FILE* output, const std::string& descriptionFileName)
+{
+    auto pipelineDescription = LoadDescription(descriptionFileName);
+    auto descriptionName = DescriptionName(descriptionFileName);
+    const auto& signal = Signal(pipelineDescription.ChannelsCount);
+
+    fprintf(output, "%s\n  %-16s %-10s %12s %10s %10s  %s\n", descriptionFileName.c_str(), "stage", "variant", "max abs", "snr dB",
+            "resp dB", "result");
+
+    for (const auto& variant : options_.Variants)
+    {
+        auto variantDescription = VariantDescription(pipelineDescription, variant);
+
+        for (const auto& stage : BuildStages(options_.SampleRate, variantDescription, variant))
+        {
+            Compare(output, descriptionName, stage, variant, signal);
+        }
+    }
+}
+
+void GoldenHarness::Compare(FILE* output,
+                            const std::string& descriptionName,
+                            const Stage& stage,
+                            const std::string& variant,
+                            const Buffers::SingleBuffer<PCMTYPE>& signal)
+{
+    if (stage.Runner == nullptr)
+    {
+        fprintf(output, "  %-16s %-10s skipped, auto gain depends on block timing\n", stage.Name.c_str(), variant.c_str());
+        return;
+    }
+
+    auto golden = ReadGolden(GoldenFileName(options_, descriptionName, stage.Name), options_);
+
+    auto stageOutput = Render(*stage.Runner, signal, variant == "irregular" ? IrregularBlockSizes : std::vector<size_t>{ GOLDEN_BLOCK_SIZE });
+
+    comparisonsCount_++;
+
+    if (stageOutput.ChannelsCount != golden.ChannelsCount || stageOutput.FramesCount != golden.FramesCount)
+    {
+        failuresCount_++;
+
+        fprintf(output, "  %-16s %-10s %d channels and %zu frames instead of %d and %zu  FAIL\n", stage.Name.c_str(), variant.c_str(),
+                stageOutput.ChannelsCount, stageOutput.FramesCount, golden.ChannelsCount, golden.FramesCount);
+        fflush(output);
+        return;
+    }
+
+    const auto& tolerance = options_.Tolerances.at(stage.Kind);
+    auto deviation = Measure(golden, stageOutput, fftEngine_, window_);
+
+    bool isPassed = deviation.IsBitExact || (deviation.MaxAbsError <= tolerance.MaxAbsError && deviation.SnrDb >= tolerance.MinSnrDb &&
+                                             deviation.ResponseDb <= tolerance.MaxResponseDb);
+
+    if (isPassed == false)
+    {
+        failuresCount_++;
+    }
+
+    fprintf(output, "  %-16s %-10s %12.3g %10.1f %10.4f  %s\n", stage.Name.c_str(), variant.c_str(), deviation.MaxAbsError,
+            deviation.SnrDb, deviation.ResponseDb, deviation.IsBitExact ? "bit-exact" : isPassed ? "ok" : "FAIL");
+    fflush(output);
+}
+
+std::vector<std::string> SplitList(const std::string& text, char separator)
+{
+    std::vector<std::string> items;
+    std::stringstream stream(text);
+    std::string item;
+
+    while (std::getline(stream, item, separator))
+    {
+        items.push_back(item);
+    }
+
+    return items;
+}
+
+bool ParseTolerance(const std::string& text, HarnessOptions& options)
+{
+    auto fields = SplitList(text, ':');
+
+    if (fields.size() != 4 || options.Tolerances.count(fields[0]) == 0)
+    {
+        return false;
+    }
+
+    options.Tolerances[fields[0]] = { atof(fields[1].c_str()), atof(fields[2].c_str()), atof(fields[3].c_str()) };
+
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    HarnessOptions options;
+
+    const char* usage = "Usage: %s record|compare [-d golden directory] [-s signal seconds] [-r sample rate] [-v variant,...] "
+                        "[-T stage:maxabs:snr:response] <descriptions...>\n";
+
+    int option;
+
+    while ((option = getopt(argc, argv, "d:s:r:v:T:")) != -1)
+    {
+        switch (option)
+        {
+        case 'd':
+            options.GoldenDirectory = optarg;
+            break;
+
+        case 's':
+            options.SignalSeconds = std::max(1.0, atof(optarg));
+            break;
+
+        case 'r':
+            options.SampleRate = std::max(8000, atoi(optarg));
+            break;
+
+        case 'v':
+            options.Variants = SplitList(optarg, ',');
+            break;
+
+        case 'T':
+            if (ParseTolerance(optarg, options) == false)
+            {
+                fprintf(stderr, "Tolerances are given as correction|band|pipeline:max abs error:min SNR dB:max response dB\n");
+                return 1;
+            }
+            break;
+
+        default:
+            fprintf(stderr, usage, argv[0]);
+            return 1;
+        }
+    }
+
+    if (argc - optind < 2 || (std::string(argv[optind]) != "record" && std::string(argv[optind]) != "compare"))
+    {
+        fprintf(stderr, usage, argv[0]);
+        return 1;
+    }
+
+    bool isRecording = std::string(argv[optind]) == "record";
+
+    for (const auto& variant : options.Variants)
+    {
+        if (std::find(AllVariants.begin(), AllVariants.end(), variant) == AllVariants.end())
+        {
+            fprintf(stderr, "Unknown variant %s\n", variant.c_str());
+            return 1;
+        }
+    }
+
+    // Descriptions and stages print their settings to stdout, only the report may go there
+    fflush(stdout);
+    FILE* reportOutput = fdopen(dup(STDOUT_FILENO), "w");
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+
+    GoldenHarness goldenHarness(options);
+
+    try
+    {
+        for (int argument = optind + 1; argument < argc; argument++)
+        {
+            if (isRecording)
+            {
+                goldenHarness.Record(reportOutput, argv[argument]);
+            }
+            else
+            {
+                goldenHarness.Compare(reportOutput, argv[argument]);
+            }
+        }
+    }
+    catch (const std::exception& e)
+    {
+        fflush(reportOutput);
+        fprintf(stderr, "Unable to %s: %s\n", argv[optind], e.what());
+        return 1;
+    }
+
+    if (isRecording == false)
+    {
+        fprintf(reportOutput, "%zu of %zu comparisons out of tolerance\n", goldenHarness.FailuresCount(), goldenHarness.ComparisonsCount());
+    }
+
+    fclose(reportOutput);
+
+    return goldenHarness.FailuresCount() > 0 ? 2 : 0;
+}
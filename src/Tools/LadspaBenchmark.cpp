@@ -0,0 +1,469 @@
+// LADSPA host benchmark, the plug-in seen through its ABI the way hosts see it.
+//
+// Loads the library like applyplugin does, with load.c of the LADSPA SDK, and times what a host goes through:
+// loading the library (our descriptors are built and the description layouts read right there), then for every
+// sample rate N instances with instantiate, the first activate (buffers are reserved there) and a repeated one,
+// run over block sizes with all instances run back to back in every period, as in a host callback, and cleanup.
+// Resident memory is sampled around every step, so the cost per instance and what cleanup leaves behind show up.
+// Control inputs get their defaults from default.c, as in applyplugin.
+//
+// Usage: ladspabenchmark [-n instances] [-r sample rates] [-b block sizes] [-t seconds per block size] <plugin.so> [label]
+//
+// Build: gcc -O2 -c -DDEFAULT_LADSPA_PATH=/usr/lib/ladspa ../Ladspa/src/load.c ../Ladspa/src/default.c
+//        g++ -std=c++17 -O2 LadspaBenchmark.cpp load.o default.o -I.. -o ladspabenchmark -ldl
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <dlfcn.h>
+#include <unistd.h>
+
+extern "C" {
+#include "Ladspa/src/utils.h"
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct BenchmarkOptions
+{
+    size_t InstancesCount = 4;
+    std::vector<size_t> SampleRates = { 44100, 48000, 96000 };
+    std::vector<size_t> BlockSizes = { 16, 64, 256, 1024, 4096 };
+    double SecondsPerBlockSize = 2;
+};
+
+double Milliseconds(Clock::time_point start, Clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// Resident set from /proc, in megabytes
+double ResidentMegabytes()
+{
+    FILE* statmFile = fopen("/proc/self/statm", "r");
+
+    if (statmFile == nullptr)
+    {
+        return 0;
+    }
+
+    unsigned long totalPages = 0, residentPages = 0;
+
+    if (fscanf(statmFile, "%lu %lu", &totalPages, &residentPages) != 2)
+    {
+        residentPages = 0;
+    }
+
+    fclose(statmFile);
+
+    return residentPages * static_cast<double>(sysconf(_SC_PAGESIZE)) / (1024 * 1024);
+}
+
+double Percentile(std::vector<double> values, double percentile)
+{
+    if (values.empty())
+    {
+        return 0;
+    }
+
+    size_t index = std::min(values.size() - 1, static_cast<size_t>(std::ceil(percentile / 100 * values.size())) - (percentile > 0 ? 1 : 0));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+
+    return values[index];
+}
+
+double Average(const std::vector<double>& values)
+{
+    double sum = 0;
+
+    for (double value : values)
+    {
+        sum += value;
+    }
+
+    return values.empty() ? 0 : sum / values.size();
+}
+
+std::vector<size_t> ParseList(const char* text)
+{
+    std::vector<size_t> values;
+
+    for (const char* position = text; *position != 0;)
+    {
+        char* end;
+        long value = strtol(position, &end, 10);
+
+        if (end == position)
+        {
+            break;
+        }
+
+        if (value > 0)
+        {
+            values.push_back(static_cast<size_t>(value));
+        }
+
+        position = *end == ',' ? end + 1 : end;
+    }
+
+    return values;
+}
+
+// Ports of one instance, audio buffers are sized for the largest block
+struct InstancePorts
+{
+    std::vector<std::vector<LADSPA_Data>> AudioBuffers;
+    std::vector<LADSPA_Data> ControlValues;
+};
+
+class DescriptorBenchmark
+{
+private:
+    const LADSPA_Descriptor* descriptor_;
+    const BenchmarkOptions& options_;
+
+    std::vector<LADSPA_Handle> instances_;
+    std::vector<InstancePorts> ports_;
+
+    unsigned noiseSeed_;
+
+    void ConnectPorts(size_t instanceIndex, unsigned long sampleRate, size_t maxBlockSize);
+    void FillInputs(size_t samplesCount);
+
+    void Instantiate(unsigned long sampleRate);
+    void Activate();
+    void Run(unsigned long sampleRate);
+    // Resident memory is compared with residentBefore, taken before the instances existed
+    void Cleanup(double residentBefore);
+
+public:
+    DescriptorBenchmark(const LADSPA_Descriptor* descriptor, const BenchmarkOptions& options)
+        : descriptor_(descriptor)
+        , options_(options)
+        , noiseSeed_(1)
+    {
+    }
+
+    bool Benchmark(unsigned long sampleRate);
+};
+
+void DescriptorBenchmark::ConnectPorts(size_t instanceIndex, unsigned long sampleRate, size_t maxBlockSize)
+{
+    auto& ports = ports_[instanceIndex];
+
+    ports.AudioBuffers.assign(descriptor_->PortCount, std::vector<LADSPA_Data>());
+    ports.ControlValues.assign(descriptor_->PortCount, 0);
+
+    for (unsigned long port = 0; port < descriptor_->PortCount; port++)
+    {
+        LADSPA_PortDescriptor portDescriptor = descriptor_->PortDescriptors[port];
+
+        if (LADSPA_IS_PORT_AUDIO(portDescriptor))
+        {
+            ports.AudioBuffers[port].assign(maxBlockSize, 0);
+            descriptor_->connect_port(instances_[instanceIndex], port, ports.AudioBuffers[port].data());
+            continue;
+        }
+
+        if (LADSPA_IS_PORT_INPUT(portDescriptor))
+        {
+            getLADSPADefault(&descriptor_->PortRangeHints[port], sampleRate, &ports.ControlValues[port]);
+        }
+
+        descriptor_->connect_port(instances_[instanceIndex], port, &ports.ControlValues[port]);
+    }
+}
+
+void DescriptorBenchmark::FillInputs(size_t samplesCount)
+{
+    for (auto& ports : ports_)
+    {
+        for (unsigned long port = 0; port < descriptor_->PortCount; port++)
+        {
+            LADSPA_PortDescriptor portDescriptor = descriptor_->PortDescriptors[port];
+
+            if (LADSPA_IS_PORT_AUDIO(portDescriptor) == false || LADSPA_IS_PORT_INPUT(portDescriptor) == false)
+            {
+                continue;
+            }
+
+            auto& buffer = ports.AudioBuffers[port];
+
+            for (size_t n = 0; n < samplesCount; n++)
+            {
+                noiseSeed_ = noiseSeed_ * 1103515245 + 12345;
+                buffer[n] = ((noiseSeed_ >> 16) & 0x7fff) / 32768.0f - 0.5f;
+            }
+        }
+    }
+}
+
+void DescriptorBenchmark::Instantiate(unsigned long sampleRate)
+{
+    std::vector<double> times;
+    double residentBefore = ResidentMegabytes();
+
+    for (size_t instanceIndex = 0; instanceIndex < options_.InstancesCount; instanceIndex++)
+    {
+        auto start = Clock::now();
+        LADSPA_Handle instance = descriptor_->instantiate(descriptor_, sampleRate);
+        times.push_back(Milliseconds(start, Clock::now()));
+
+        if (instance == nullptr)
+        {
+            break;
+        }
+
+        instances_.push_back(instance);
+    }
+
+    if (instances_.empty())
+    {
+        return;
+    }
+
+    double residentDelta = (ResidentMegabytes() - residentBefore) / instances_.size();
+
+    printf("    instantiate   avg %9.3f ms   max %9.3f ms                    rss %+8.2f MB per instance\n", Average(times),
+           Percentile(times, 100), residentDelta);
+}
+
+void DescriptorBenchmark::Activate()
+{
+    if (descriptor_->activate == nullptr)
+    {
+        return;
+    }
+
+    std::vector<double> firstTimes, againTimes;
+    double residentBefore = ResidentMegabytes();
+
+    for (auto instance : instances_)
+    {
+        auto start = Clock::now();
+        descriptor_->activate(instance);
+        firstTimes.push_back(Milliseconds(start, Clock::now()));
+    }
+
+    double residentDelta = (ResidentMegabytes() - residentBefore) / instances_.size();
+
+    // Hosts activate again after every stream restart
+    for (auto instance : instances_)
+    {
+        if (descriptor_->deactivate != nullptr)
+        {
+            descriptor_->deactivate(instance);
+        }
+
+        auto start = Clock::now();
+        descriptor_->activate(instance);
+        againTimes.push_back(Milliseconds(start, Clock::now()));
+    }
+
+    printf("    activate      avg %9.3f ms   max %9.3f ms   again %9.3f ms   rss %+8.2f MB per instance\n", Average(firstTimes),
+           Percentile(firstTimes, 100), Average(againTimes), residentDelta);
+}
+
+void DescriptorBenchmark::Run(unsigned long sampleRate)
+{
+    printf("    run    block      p50 us      p99 us      max us   ns/sample   period load p50 / max\n");
+
+    for (size_t blockSize : options_.BlockSizes)
+    {
+        size_t periodsCount = std::max<size_t>(1, static_cast<size_t>(options_.SecondsPerBlockSize * sampleRate / blockSize));
+
+        std::vector<double> callTimes, periodLoads;
+        callTimes.reserve(periodsCount * instances_.size());
+        periodLoads.reserve(periodsCount);
+
+        double deadlineUs = blockSize * 1e6 / sampleRate;
+        double totalUs = 0;
+
+        for (size_t period = 0; period < periodsCount; period++)
+        {
+            FillInputs(blockSize);
+
+            double periodUs = 0;
+
+            for (auto instance : instances_)
+            {
+                auto start = Clock::now();
+                descriptor_->run(instance, blockSize);
+                double callUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+                callTimes.push_back(callUs);
+                periodUs += callUs;
+            }
+
+            periodLoads.push_back(periodUs / deadlineUs);
+            totalUs += periodUs;
+        }
+
+        double nsPerSample = totalUs * 1e3 / (static_cast<double>(periodsCount) * blockSize * instances_.size());
+
+        printf("          %6zu  %10.1f  %10.1f  %10.1f  %10.2f   %8.2f %% / %.2f %%\n", blockSize, Percentile(callTimes, 50),
+               Percentile(callTimes, 99), Percentile(callTimes, 100), nsPerSample, Percentile(periodLoads, 50) * 100,
+               Percentile(periodLoads, 100) * 100);
+    }
+}
+
+void DescriptorBenchmark::Cleanup(double residentBefore)
+{
+    std::vector<double> times;
+
+    for (auto instance : instances_)
+    {
+        if (descriptor_->deactivate != nullptr)
+        {
+            descriptor_->deactivate(instance);
+        }
+
+        auto start = Clock::now();
+        descriptor_->cleanup(instance);
+        times.push_back(Milliseconds(start, Clock::now()));
+    }
+
+    instances_.clear();
+    ports_.clear();
+
+    printf("    cleanup       avg %9.3f ms   max %9.3f ms                    rss %+8.2f MB left\n", Average(times), Percentile(times, 100),
+           ResidentMegabytes() - residentBefore);
+}
+
+bool DescriptorBenchmark::Benchmark(unsigned long sampleRate)
+{
+    double residentBefore = ResidentMegabytes();
+
+    printf("  %lu Hz, %zu instances\n", sampleRate, options_.InstancesCount);
+
+    Instantiate(sampleRate);
+
+    if (instances_.size() < options_.InstancesCount)
+    {
+        printf("    instantiate failed after %zu instances\n", instances_.size());
+        Cleanup(residentBefore);
+
+        return false;
+    }
+
+    size_t maxBlockSize = *std::max_element(options_.BlockSizes.begin(), options_.BlockSizes.end());
+    ports_.resize(instances_.size());
+
+    for (size_t instanceIndex = 0; instanceIndex < instances_.size(); instanceIndex++)
+    {
+        ConnectPorts(instanceIndex, sampleRate, maxBlockSize);
+    }
+
+    Activate();
+    Run(sampleRate);
+    Cleanup(residentBefore);
+
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    BenchmarkOptions options;
+
+    int option;
+
+    while ((option = getopt(argc, argv, "n:r:b:t:")) != -1)
+    {
+        switch (option)
+        {
+        case 'n':
+            options.InstancesCount = static_cast<size_t>(std::max(1, atoi(optarg)));
+            break;
+
+        case 'r':
+            options.SampleRates = ParseList(optarg);
+            break;
+
+        case 'b':
+            options.BlockSizes = ParseList(optarg);
+            break;
+
+        case 't':
+            options.SecondsPerBlockSize = std::max(0.01, atof(optarg));
+            break;
+
+        default:
+            return 1;
+        }
+    }
+
+    if (optind >= argc || options.SampleRates.empty() || options.BlockSizes.empty())
+    {
+        fprintf(stderr, "Usage: %s [-n instances] [-r sample rates] [-b block sizes] [-t seconds per block size] <plugin.so> [label]\n",
+                argv[0]);
+        return 1;
+    }
+
+    const char* libraryFileName = argv[optind];
+    const char* label = optind + 1 < argc ? argv[optind + 1] : nullptr;
+
+    // Everything a host pays before the first instance: dlopen, static construction and the descriptors
+    double residentBefore = ResidentMegabytes();
+    auto start = Clock::now();
+
+    void* library = loadLADSPAPluginLibrary(libraryFileName);
+
+    auto descriptorFunction = reinterpret_cast<LADSPA_Descriptor_Function>(dlsym(library, "ladspa_descriptor"));
+    std::vector<const LADSPA_Descriptor*> descriptors;
+
+    if (label != nullptr)
+    {
+        descriptors.push_back(findLADSPAPluginDescriptor(library, libraryFileName, label));
+    }
+    else
+    {
+        for (unsigned long index = 0; descriptorFunction != nullptr && descriptorFunction(index) != nullptr; index++)
+        {
+            descriptors.push_back(descriptorFunction(index));
+        }
+    }
+
+    printf("%s: load %.3f ms, rss %+.2f MB, %zu descriptors\n", libraryFileName, Milliseconds(start, Clock::now()),
+           ResidentMegabytes() - residentBefore, descriptors.size());
+
+    int result = 0;
+
+    for (auto descriptor : descriptors)
+    {
+        size_t audioInputs = 0, audioOutputs = 0;
+
+        for (unsigned long port = 0; port < descriptor->PortCount; port++)
+        {
+            if (LADSPA_IS_PORT_AUDIO(descriptor->PortDescriptors[port]))
+            {
+                (LADSPA_IS_PORT_INPUT(descriptor->PortDescriptors[port]) ? audioInputs : audioOutputs)++;
+            }
+        }
+
+        printf("%s (%lu), %zu audio inputs, %zu audio outputs\n", descriptor->Label, descriptor->UniqueID, audioInputs, audioOutputs);
+
+        for (size_t sampleRate : options.SampleRates)
+        {
+            DescriptorBenchmark descriptorBenchmark(descriptor, options);
+
+            if (descriptorBenchmark.Benchmark(sampleRate) == false)
+            {
+                result = 1;
+            }
+        }
+    }
+
+    unloadLADSPAPluginLibrary(library);
+
+    return result;
+}
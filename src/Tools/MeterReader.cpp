@@ -0,0 +1,276 @@
+// Shared meters reader.
+//
+// Maps the segment a pipeline publishes when its description sets "sharedMetersName" and prints levels in dBFS,
+// held auto gain levels, clip counts and variables (gain steps, compressor gains). Reading never blocks the audio thread:
+// entries are copied under their sequence counters and retried when a write was in progress.
+// Further instances of a description publish to "<name>-<pid>-<n>"; --list prints every shared meters segment with its
+// writer process, optionally only those starting with a prefix.
+//
+// Usage: meterreader <segment name> [interval ms] [--once]
+//        meterreader --list [name prefix]
+//
+// Build: g++ -std=c++17 -O2 MeterReader.cpp -I.. -o meterreader -lrt
+
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Reflection/SharedMetersLayout.h"
+
+using namespace dePhonica::Core;
+
+namespace {
+
+struct LevelSnapshot
+{
+    float Peak, Rms, HeldPeak;
+    uint64_t ClipsCount;
+};
+
+template<typename Entry, typename Snapshot, typename CopyFunction>
+Snapshot ReadEntry(const Entry& entry, CopyFunction copyValues)
+{
+    Snapshot snapshot;
+
+    for (;;)
+    {
+        uint32_t sequenceBefore = entry.Sequence.load(std::memory_order_acquire);
+
+        if (sequenceBefore & 1)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        snapshot = copyValues(entry);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        if (entry.Sequence.load(std::memory_order_relaxed) == sequenceBefore)
+        {
+            return snapshot;
+        }
+    }
+}
+
+float ToDecibels(float value)
+{
+    return value > 0 ? 20 * std::log10(value) : -INFINITY;
+}
+
+void PrintMeters(const SharedMetersHeader* header)
+{
+    auto mappingBytes = reinterpret_cast<const char*>(header);
+    auto levels = reinterpret_cast<const SharedLevelEntry*>(mappingBytes + sizeof(SharedMetersHeader));
+    auto variables = reinterpret_cast<const SharedVariableEntry*>(mappingBytes + sizeof(SharedMetersHeader) +
+        header->LevelsCount * sizeof(SharedLevelEntry));
+
+    uint64_t blocksCount = header->BlocksCount.load(std::memory_order_relaxed);
+    uint64_t samplesCount = header->SamplesCount.load(std::memory_order_relaxed);
+
+    printf("blocks %llu, %.1f s processed at %u Hz\n", static_cast<unsigned long long>(blocksCount),
+        header->SampleRate > 0 ? static_cast<double>(samplesCount) / header->SampleRate : 0.0, header->SampleRate);
+
+    printf("%-32s %9s %9s %9s %9s\n", "binding", "peak dB", "rms dB", "held dB", "clips");
+
+    for (uint32_t slot = 0; slot < header->LevelsCount; slot++)
+    {
+        auto level = ReadEntry<SharedLevelEntry, LevelSnapshot>(levels[slot], [](const SharedLevelEntry& entry)
+        {
+            return LevelSnapshot { entry.Peak.load(std::memory_order_relaxed),
+                                   entry.Rms.load(std::memory_order_relaxed),
+                                   entry.HeldPeak.load(std::memory_order_relaxed),
+                                   entry.ClipsCount.load(std::memory_order_relaxed) };
+        });
+
+        printf("%-32s %9.2f %9.2f %9.2f %9llu\n", levels[slot].Name, ToDecibels(level.Peak), ToDecibels(level.Rms),
+            ToDecibels(level.HeldPeak), static_cast<unsigned long long>(level.ClipsCount));
+    }
+
+    for (uint32_t slot = 0; slot < header->VariablesCount; slot++)
+    {
+        auto value = ReadEntry<SharedVariableEntry, float>(variables[slot], [](const SharedVariableEntry& entry)
+        {
+            return entry.Value.load(std::memory_order_relaxed);
+        });
+
+        printf("%-32s %9.2f\n", variables[slot].Name, value);
+    }
+}
+
+// Read only mapping of a shared meters segment of this version, nullptr otherwise; reasons are printed when isReported
+const SharedMetersHeader* MapSegment(const std::string& segmentName, size_t& mappingSize, bool isReported)
+{
+    int segmentDescriptor = shm_open(segmentName.c_str(), O_RDONLY, 0);
+
+    if (segmentDescriptor < 0)
+    {
+        if (isReported)
+        {
+            fprintf(stderr, "Unable to open %s: %s\n", segmentName.c_str(), strerror(errno));
+        }
+
+        return nullptr;
+    }
+
+    struct stat segmentStat;
+
+    if (fstat(segmentDescriptor, &segmentStat) != 0 || static_cast<size_t>(segmentStat.st_size) < sizeof(SharedMetersHeader))
+    {
+        if (isReported)
+        {
+            fprintf(stderr, "%s is not a shared meters segment\n", segmentName.c_str());
+        }
+
+        close(segmentDescriptor);
+        return nullptr;
+    }
+
+    mappingSize = segmentStat.st_size;
+    void* mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_SHARED, segmentDescriptor, 0);
+    close(segmentDescriptor);
+
+    if (mapping == MAP_FAILED)
+    {
+        if (isReported)
+        {
+            fprintf(stderr, "Unable to map %s: %s\n", segmentName.c_str(), strerror(errno));
+        }
+
+        return nullptr;
+    }
+
+    auto header = static_cast<const SharedMetersHeader*>(mapping);
+
+    // The writer stores the magic last
+    uint32_t magic = header->Magic;
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    if (magic != SHARED_METERS_MAGIC || header->Version != SHARED_METERS_VERSION ||
+        SharedMetersSize(header->LevelsCount, header->VariablesCount) > mappingSize)
+    {
+        if (isReported)
+        {
+            fprintf(stderr, "%s is not a shared meters segment of version %d\n", segmentName.c_str(), SHARED_METERS_VERSION);
+        }
+
+        munmap(mapping, mappingSize);
+        return nullptr;
+    }
+
+    return header;
+}
+
+int ListSegments(const std::string& namePrefix)
+{
+    DIR* segmentsDirectory = opendir("/dev/shm");
+
+    if (segmentsDirectory == nullptr)
+    {
+        fprintf(stderr, "Unable to list /dev/shm: %s\n", strerror(errno));
+        return 1;
+    }
+
+    printf("%-40s %9s %6s %9s %9s\n", "segment", "writer", "state", "levels", "variables");
+
+    while (auto directoryEntry = readdir(segmentsDirectory))
+    {
+        std::string segmentName = std::string("/") + directoryEntry->d_name;
+
+        if (directoryEntry->d_name[0] == '.' || segmentName.compare(0, namePrefix.size(), namePrefix) != 0)
+        {
+            continue;
+        }
+
+        size_t mappingSize = 0;
+        auto header = MapSegment(segmentName, mappingSize, false);
+
+        if (header == nullptr)
+        {
+            continue;
+        }
+
+        bool isAlive = kill(static_cast<pid_t>(header->WriterPid), 0) == 0 || errno != ESRCH;
+
+        printf("%-40s %9u %6s %9u %9u\n", segmentName.c_str(), header->WriterPid, isAlive ? "live" : "stale",
+            header->LevelsCount, header->VariablesCount);
+
+        munmap(const_cast<SharedMetersHeader*>(header), mappingSize);
+    }
+
+    closedir(segmentsDirectory);
+
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <segment name> [interval ms] [--once]\n"
+                        "       %s --list [name prefix]\n", argv[0], argv[0]);
+        return 2;
+    }
+
+    if (strcmp(argv[1], "--list") == 0)
+    {
+        return ListSegments(argc > 2 ? argv[2] : "");
+    }
+
+    std::string segmentName = argv[1];
+    unsigned intervalMilliseconds = 500;
+    bool isOnce = false;
+
+    for (int argument = 2; argument < argc; argument++)
+    {
+        if (strcmp(argv[argument], "--once") == 0)
+        {
+            isOnce = true;
+        }
+        else
+        {
+            intervalMilliseconds = std::strtoul(argv[argument], nullptr, 10);
+        }
+    }
+
+    size_t mappingSize = 0;
+    auto header = MapSegment(segmentName, mappingSize, true);
+
+    if (header == nullptr)
+    {
+        return 1;
+    }
+
+    for (;;)
+    {
+        PrintMeters(header);
+
+        if (isOnce)
+        {
+            break;
+        }
+
+        printf("\n");
+        fflush(stdout);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(intervalMilliseconds));
+    }
+
+    munmap(const_cast<SharedMetersHeader*>(header), mappingSize);
+
+    return 0;
+}
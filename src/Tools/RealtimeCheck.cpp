@@ -0,0 +1,422 @@
+// Real-time safety check for LADSPA plug-ins.
+//
+// Loads a plug-in library, instantiates every descriptor (or the one given by label) and runs it with randomized block sizes.
+// The program defines malloc, free and friends, write, pthread_mutex_lock and the blocking waits (sem_wait, sem_timedwait,
+// pthread_cond_wait, pthread_cond_timedwait, nanosleep, usleep and futex waits made through syscall) itself, which interposes
+// them for the loaded plug-in the same way LD_PRELOAD would. Any of those called from inside run() is reported and fails the check.
+//
+// Usage: realtimecheck <plugin.so> [label] [blocks count] [max block size] [seed]
+// Set REALTIMECHECK_ABORT=1 to print the stack and abort on the first violation.
+//
+// Build: g++ -std=c++17 -O2 RealtimeCheck.cpp -I.. -o realtimecheck -ldl -lpthread
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <cstdarg>
+
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "Ladspa/src/ladspa.h"
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* pointer);
+}
+
+namespace {
+
+enum RealtimeViolations
+{
+    Malloc = 0,
+    Free,
+    Write,
+    MutexLock,
+    SemaphoreWait,
+    SemaphoreTimedWait,
+    ConditionWait,
+    ConditionTimedWait,
+    Nanosleep,
+    Usleep,
+    FutexWait,
+    ViolationsCount
+};
+
+const char* ViolationNames[ViolationsCount] = { "malloc", "free", "write", "pthread_mutex_lock", "sem_wait", "sem_timedwait",
+                                                "pthread_cond_wait", "pthread_cond_timedwait", "nanosleep", "usleep", "futex wait" };
+
+// Only the thread calling run() is watched, pipelined stage threads may lock freely
+thread_local bool isInRun = false;
+
+bool isAbortOnViolation = false;
+
+std::atomic<size_t> violationCounters[ViolationsCount];
+
+using MutexLockFunction = int (*)(pthread_mutex_t*);
+MutexLockFunction nextMutexLock = nullptr;
+
+using SemaphoreWaitFunction = int (*)(sem_t*);
+using SemaphoreTimedWaitFunction = int (*)(sem_t*, const timespec*);
+using ConditionWaitFunction = int (*)(pthread_cond_t*, pthread_mutex_t*);
+using ConditionTimedWaitFunction = int (*)(pthread_cond_t*, pthread_mutex_t*, const timespec*);
+using NanosleepFunction = int (*)(const timespec*, timespec*);
+using UsleepFunction = int (*)(useconds_t);
+using SyscallFunction = long (*)(long, long, long, long, long, long, long);
+
+SemaphoreWaitFunction nextSemaphoreWait = nullptr;
+SemaphoreTimedWaitFunction nextSemaphoreTimedWait = nullptr;
+ConditionWaitFunction nextConditionWait = nullptr;
+ConditionTimedWaitFunction nextConditionTimedWait = nullptr;
+NanosleepFunction nextNanosleep = nullptr;
+UsleepFunction nextUsleep = nullptr;
+SyscallFunction nextSyscall = nullptr;
+
+// Condition variables keep an older symbol version next to the current one, plain dlsym may return the old one
+void* NextCondition(const char* name)
+{
+    void* function = dlvsym(RTLD_NEXT, name, "GLIBC_2.3.2");
+    return function != nullptr ? function : dlsym(RTLD_NEXT, name);
+}
+
+// Wakes never block, everything else waits or may wait for a lock owner
+bool IsFutexWait(int operation)
+{
+    switch (operation & FUTEX_CMD_MASK)
+    {
+    case FUTEX_WAIT:
+    case FUTEX_WAIT_BITSET:
+    case FUTEX_LOCK_PI:
+    case FUTEX_WAIT_REQUEUE_PI:
+        return true;
+    default:
+        return false;
+    }
+}
+
+inline void CountViolation(RealtimeViolations violation)
+{
+    if (isInRun)
+    {
+        violationCounters[violation]++;
+
+        if (isAbortOnViolation)
+        {
+            isInRun = false;
+
+            void* stackFrames[64];
+            backtrace_symbols_fd(stackFrames, backtrace(stackFrames, 64), STDERR_FILENO);
+
+            abort();
+        }
+    }
+}
+
+} // namespace
+
+extern "C" {
+
+void* malloc(size_t size)
+{
+    CountViolation(RealtimeViolations::Malloc);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+    CountViolation(RealtimeViolations::Malloc);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size)
+{
+    CountViolation(RealtimeViolations::Malloc);
+    return __libc_realloc(pointer, size);
+}
+
+void* memalign(size_t alignment, size_t size)
+{
+    CountViolation(RealtimeViolations::Malloc);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** pointer, size_t alignment, size_t size)
+{
+    CountViolation(RealtimeViolations::Malloc);
+    *pointer = __libc_memalign(alignment, size);
+    return *pointer != nullptr ? 0 : ENOMEM;
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+    CountViolation(RealtimeViolations::Malloc);
+    return __libc_memalign(alignment, size);
+}
+
+void free(void* pointer)
+{
+    if (pointer != nullptr)
+    {
+        CountViolation(RealtimeViolations::Free);
+    }
+
+    __libc_free(pointer);
+}
+
+ssize_t write(int fileDescriptor, const void* data, size_t length)
+{
+    CountViolation(RealtimeViolations::Write);
+    return syscall(SYS_write, fileDescriptor, data, length);
+}
+
+int pthread_mutex_lock(pthread_mutex_t* mutex)
+{
+    CountViolation(RealtimeViolations::MutexLock);
+    return nextMutexLock(mutex);
+}
+
+int sem_wait(sem_t* semaphore)
+{
+    CountViolation(RealtimeViolations::SemaphoreWait);
+    return nextSemaphoreWait(semaphore);
+}
+
+int sem_timedwait(sem_t* semaphore, const timespec* timeout)
+{
+    CountViolation(RealtimeViolations::SemaphoreTimedWait);
+    return nextSemaphoreTimedWait(semaphore, timeout);
+}
+
+int pthread_cond_wait(pthread_cond_t* condition, pthread_mutex_t* mutex)
+{
+    CountViolation(RealtimeViolations::ConditionWait);
+    return nextConditionWait(condition, mutex);
+}
+
+int pthread_cond_timedwait(pthread_cond_t* condition, pthread_mutex_t* mutex, const timespec* timeout)
+{
+    CountViolation(RealtimeViolations::ConditionTimedWait);
+    return nextConditionTimedWait(condition, mutex, timeout);
+}
+
+int nanosleep(const timespec* duration, timespec* remaining)
+{
+    CountViolation(RealtimeViolations::Nanosleep);
+    return nextNanosleep(duration, remaining);
+}
+
+int usleep(useconds_t duration)
+{
+    CountViolation(RealtimeViolations::Usleep);
+    return nextUsleep(duration);
+}
+
+// Only reached by code calling syscall() itself, libc waits on futexes internally
+long syscall(long number, ...)
+{
+    va_list arguments;
+    va_start(arguments, number);
+
+    long values[6];
+
+    for (auto& value : values)
+    {
+        value = va_arg(arguments, long);
+    }
+
+    va_end(arguments);
+
+    if (number == SYS_futex && IsFutexWait(static_cast<int>(values[1])))
+    {
+        CountViolation(RealtimeViolations::FutexWait);
+    }
+
+    if (nextSyscall == nullptr)
+    {
+        nextSyscall = reinterpret_cast<SyscallFunction>(dlsym(RTLD_NEXT, "syscall"));
+    }
+
+    return nextSyscall(number, values[0], values[1], values[2], values[3], values[4], values[5]);
+}
+
+} // extern "C"
+
+namespace {
+
+struct PluginPorts
+{
+    std::vector<std::vector<LADSPA_Data>> Buffers;
+};
+
+bool CheckDescriptor(const LADSPA_Descriptor* descriptor, size_t blocksCount, size_t maxBlockSize, unsigned seed)
+{
+    const unsigned long sampleRate = 48000;
+
+    auto instance = descriptor->instantiate(descriptor, sampleRate);
+
+    if (instance == NULL)
+    {
+        printf("%s: unable to instantiate\n", descriptor->Label);
+        return false;
+    }
+
+    PluginPorts ports;
+    ports.Buffers.resize(descriptor->PortCount);
+
+    for (unsigned long port = 0; port < descriptor->PortCount; port++)
+    {
+        bool isAudio = LADSPA_IS_PORT_AUDIO(descriptor->PortDescriptors[port]);
+
+        ports.Buffers[port].resize(isAudio ? maxBlockSize : 1);
+        descriptor->connect_port(instance, port, ports.Buffers[port].data());
+    }
+
+    if (descriptor->activate != NULL)
+    {
+        descriptor->activate(instance);
+    }
+
+    for (auto& counter : violationCounters)
+    {
+        counter = 0;
+    }
+
+    std::mt19937 randomGenerator(seed);
+    std::uniform_int_distribution<size_t> blockSizes(1, maxBlockSize);
+    std::uniform_real_distribution<float> samples(-1.0f, 1.0f);
+
+    for (size_t block = 0; block < blocksCount; block++)
+    {
+        size_t blockSize = blockSizes(randomGenerator);
+
+        for (unsigned long port = 0; port < descriptor->PortCount; port++)
+        {
+            auto portDescriptor = descriptor->PortDescriptors[port];
+
+            if (LADSPA_IS_PORT_INPUT(portDescriptor) && LADSPA_IS_PORT_AUDIO(portDescriptor))
+            {
+                for (size_t n = 0; n < blockSize; n++)
+                {
+                    ports.Buffers[port][n] = samples(randomGenerator);
+                }
+            }
+        }
+
+        isInRun = true;
+        descriptor->run(instance, blockSize);
+        isInRun = false;
+    }
+
+    if (descriptor->deactivate != NULL)
+    {
+        descriptor->deactivate(instance);
+    }
+
+    descriptor->cleanup(instance);
+
+    bool isRealtimeSafe = true;
+
+    printf("%s: %zu blocks of up to %zu samples\n", descriptor->Label, blocksCount, maxBlockSize);
+
+    for (int violation = 0; violation < ViolationsCount; violation++)
+    {
+        size_t violationsCount = violationCounters[violation];
+
+        if (violationsCount > 0)
+        {
+            printf("  %s called %zu times in run()\n", ViolationNames[violation], violationsCount);
+            isRealtimeSafe = false;
+        }
+    }
+
+    printf("  %s\n", isRealtimeSafe ? "real-time safe" : "NOT real-time safe");
+
+    return isRealtimeSafe;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <plugin.so> [label] [blocks count] [max block size] [seed]\n", argv[0]);
+        return 2;
+    }
+
+    nextMutexLock = reinterpret_cast<MutexLockFunction>(dlsym(RTLD_NEXT, "pthread_mutex_lock"));
+    nextSemaphoreWait = reinterpret_cast<SemaphoreWaitFunction>(dlsym(RTLD_NEXT, "sem_wait"));
+    nextSemaphoreTimedWait = reinterpret_cast<SemaphoreTimedWaitFunction>(dlsym(RTLD_NEXT, "sem_timedwait"));
+    nextConditionWait = reinterpret_cast<ConditionWaitFunction>(NextCondition("pthread_cond_wait"));
+    nextConditionTimedWait = reinterpret_cast<ConditionTimedWaitFunction>(NextCondition("pthread_cond_timedwait"));
+    nextNanosleep = reinterpret_cast<NanosleepFunction>(dlsym(RTLD_NEXT, "nanosleep"));
+    nextUsleep = reinterpret_cast<UsleepFunction>(dlsym(RTLD_NEXT, "usleep"));
+
+    auto abortVariable = getenv("REALTIMECHECK_ABORT");
+    isAbortOnViolation = abortVariable != nullptr && strcmp(abortVariable, "1") == 0;
+
+    std::string label = argc > 2 ? argv[2] : "";
+    size_t blocksCount = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 2000;
+    size_t maxBlockSize = argc > 4 ? std::strtoul(argv[4], nullptr, 10) : 4096;
+    unsigned seed = argc > 5 ? std::strtoul(argv[5], nullptr, 10) : 1;
+
+    void* pluginHandle = dlopen(argv[1], RTLD_NOW | RTLD_LOCAL);
+
+    if (pluginHandle == NULL)
+    {
+        fprintf(stderr, "%s\n", dlerror());
+        return 2;
+    }
+
+    auto descriptorFunction = reinterpret_cast<LADSPA_Descriptor_Function>(dlsym(pluginHandle, "ladspa_descriptor"));
+
+    if (descriptorFunction == NULL)
+    {
+        fprintf(stderr, "%s is not a LADSPA plug-in\n", argv[1]);
+        return 2;
+    }
+
+    bool isRealtimeSafe = true;
+    bool isLabelFound = false;
+
+    for (unsigned long index = 0;; index++)
+    {
+        auto descriptor = descriptorFunction(index);
+
+        if (descriptor == NULL)
+        {
+            break;
+        }
+
+        if (label.empty() == false && label != descriptor->Label)
+        {
+            continue;
+        }
+
+        isLabelFound = true;
+        isRealtimeSafe = CheckDescriptor(descriptor, blocksCount, maxBlockSize, seed) && isRealtimeSafe;
+    }
+
+    if (isLabelFound == false)
+    {
+        fprintf(stderr, "No plug-in labelled %s\n", label.c_str());
+        return 2;
+    }
+
+    return isRealtimeSafe ? 0 : 1;
+}
@@ -0,0 +1,172 @@
+// Throughput of RingBuffer against SlidingBuffer.
+//
+// Pushes and pops blocks of the given sizes through both classes on one thread, then streams through a RingBuffer
+// between two threads the way the pipeline stages and the spectrum analyzer use it. Reports samples per second.
+//
+// Usage: ringbufferbenchmark [megasamples] [capacity] [block sizes...]
+//
+// Build: g++ -std=c++17 -O2 RingBufferBenchmark.cpp -I.. -o ringbufferbenchmark -lpthread
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "Buffers/RingBuffer.h"
+#include "Buffers/SlidingBuffer.h"
+
+using namespace dePhonica::Buffers;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double SecondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Keeps the copies from being optimized away
+volatile float checksumSink;
+
+double BenchmarkSliding(size_t samplesCount, size_t capacity, size_t blockSize)
+{
+    SlidingBuffer<float> slidingBuffer(capacity, false);
+    std::vector<float> source(blockSize, 1.0f), target(blockSize);
+
+    float checksum = 0;
+    auto start = Clock::now();
+
+    for (size_t processed = 0; processed < samplesCount; processed += blockSize)
+    {
+        slidingBuffer.Push(source, 0, blockSize);
+        slidingBuffer.Pop(target, 0, blockSize);
+
+        checksum += target[blockSize - 1];
+    }
+
+    double seconds = SecondsSince(start);
+    checksumSink = checksum;
+
+    return samplesCount / seconds;
+}
+
+double BenchmarkRing(size_t samplesCount, size_t capacity, size_t blockSize)
+{
+    RingBuffer<float> ringBuffer(capacity);
+    std::vector<float> source(blockSize, 1.0f), target(blockSize);
+
+    float checksum = 0;
+    auto start = Clock::now();
+
+    for (size_t processed = 0; processed < samplesCount; processed += blockSize)
+    {
+        ringBuffer.Push(source.data(), blockSize);
+        ringBuffer.Pop(target.data(), blockSize);
+
+        checksum += target[blockSize - 1];
+    }
+
+    double seconds = SecondsSince(start);
+    checksumSink = checksum;
+
+    return samplesCount / seconds;
+}
+
+// Consumer reads in place through the spans, the way the spectrum analyzer does
+double BenchmarkRingThreads(size_t samplesCount, size_t capacity, size_t blockSize)
+{
+    RingBuffer<float> ringBuffer(capacity);
+    std::vector<float> source(blockSize, 1.0f);
+
+    auto start = Clock::now();
+
+    std::thread consumer([&]() {
+        float checksum = 0;
+        size_t consumed = 0;
+
+        while (consumed < samplesCount)
+        {
+            auto spans = ringBuffer.ReadSpans(samplesCount - consumed);
+
+            if (spans.Length() == 0)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            for (size_t n = 0; n < spans.FirstLength; n++)
+            {
+                checksum += spans.First[n];
+            }
+
+            for (size_t n = 0; n < spans.SecondLength; n++)
+            {
+                checksum += spans.Second[n];
+            }
+
+            ringBuffer.CommitRead(spans.Length());
+            consumed += spans.Length();
+        }
+
+        checksumSink = checksum;
+    });
+
+    for (size_t produced = 0; produced < samplesCount;)
+    {
+        size_t length = std::min(blockSize, samplesCount - produced);
+
+        if (ringBuffer.Push(source.data(), length) == false)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        produced += length;
+    }
+
+    consumer.join();
+
+    return samplesCount / SecondsSince(start);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    size_t samplesCount = (argc > 1 ? atoi(argv[1]) : 200) * size_t(1000000);
+    size_t capacity = argc > 2 ? atoi(argv[2]) : 65536;
+
+    std::vector<size_t> blockSizes;
+
+    for (int n = 3; n < argc; n++)
+    {
+        blockSizes.push_back(atoi(argv[n]));
+    }
+
+    if (blockSizes.empty())
+    {
+        blockSizes = { 17, 64, 256, 1024, 4096 };
+    }
+
+    printf("%zu Msamples, capacity %zu, Msamples/s\n", samplesCount / 1000000, capacity);
+    printf("%8s %12s %12s %14s\n", "block", "sliding", "ring", "ring 2 threads");
+
+    for (auto blockSize : blockSizes)
+    {
+        if (blockSize == 0 || blockSize > capacity / 2)
+        {
+            fprintf(stderr, "Block size %zu does not fit capacity %zu\n", blockSize, capacity);
+            return 1;
+        }
+
+        double slidingRate = BenchmarkSliding(samplesCount, capacity, blockSize);
+        double ringRate = BenchmarkRing(samplesCount, capacity, blockSize);
+        double threadsRate = BenchmarkRingThreads(samplesCount, capacity, blockSize);
+
+        printf("%8zu %12.1f %12.1f %14.1f\n", blockSize, slidingRate / 1e6, ringRate / 1e6, threadsRate / 1e6);
+    }
+
+    return 0;
+}
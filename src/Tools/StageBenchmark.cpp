@@ -0,0 +1,547 @@
+// Per-stage microbenchmarks.
+//
+// Times every processing stage on its own with a deterministic test signal: FftEngine convolution per FFT size,
+// FirStreamConvolver per kernel length and host block size, IirFilter per type and order, Compressor in RMS and peak modes,
+// AutoGain, PipelineReflection peak and loudness metering, then full pipelines built from the descriptions given.
+// Each case runs for a fixed time split in repetitions, the median repetition is reported. Results go to stdout as JSON,
+// nsPerSample is per sample of one channel and realTimeFactor is audio time over processing time, progress goes to stderr.
+// In place stages copy the next block of the signal before every run, the "signal copy" case times that alone.
+// Anything else the stages print is sent to stderr, so the output can be piped straight to a file.
+//
+// Usage: stagebenchmark [-t seconds per case] [-r repetitions] [-c channels] [-s sample rate] [-f name filter] [descriptions...]
+//
+// Build: g++ -std=c++17 -O2 StageBenchmark.cpp $(ls ../*.cpp ../*/*.cpp ../IIR/spcc/*.cpp | grep -v -e LadspaWrapper -e FftEngineKiss -e Tools/)
+//        -I.. -I../FIR -I../IIR ../../lib/x64/libfftw3f.a -o stagebenchmark -lpthread -lrt
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/utsname.h>
+#include <unistd.h>
+
+#include "Pipeline.h"
+#include "PipelineDescription.h"
+#include "FIR/FftEngineFftw.h"
+#include "FIR/FirStreamConvolver.h"
+#include "IIR/IirFilter.h"
+#include "Dynamics/Compressor.h"
+#include "Gain/AutoGain.h"
+#include "Reflection/PipelineReflection.h"
+
+using namespace dePhonica;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Host block sizes the streaming stages are timed at
+const std::vector<size_t> BlockSizes = { 64, 256, 1024, 4096 };
+
+struct BenchmarkOptions
+{
+    double SecondsPerCase = 0.5;
+    int Repetitions = 5;
+    int ChannelsCount = 2;
+    unsigned SampleRate = 48000;
+    std::string NameFilter;
+};
+
+// One second of music-like material: a slow sweep, bursts that push compressors in and out, and noise.
+// Every run gets the next block, so detectors and gains see a moving signal instead of one block over and over.
+class SignalSource
+{
+private:
+    Buffers::SingleBuffer<PCMTYPE> signal_;
+    size_t position_;
+
+public:
+    SignalSource(unsigned sampleRate, int channelsCount)
+        : signal_(sampleRate, channelsCount)
+        , position_(0)
+    {
+        unsigned seed = 1;
+
+        for (size_t n = 0; n < sampleRate; n++)
+        {
+            seed = seed * 1103515245 + 12345;
+
+            double time = static_cast<double>(n) / sampleRate;
+            double sweep = std::sin(2 * M_PI * (50 * time + 2000 * time * time));
+            double burst = (n / (sampleRate / 8)) % 2 == 0 ? 0.6 : 0.1;
+            double noise = ((seed >> 16) & 0x7fff) / 32768.0 - 0.5;
+
+            for (int channel = 0; channel < channelsCount; channel++)
+            {
+                signal_.ChannelData(channel)[n] = static_cast<PCMTYPE>(burst * sweep + 0.05 * noise * (channel + 1));
+            }
+        }
+
+        signal_.SampleRate(sampleRate);
+        signal_.DataLengthSamples(sampleRate);
+    }
+
+    void Next(Buffers::SingleBuffer<PCMTYPE>& targetBuffer, size_t samplesCount)
+    {
+        if (position_ + samplesCount > signal_.DataLengthSamples())
+        {
+            position_ = 0;
+        }
+
+        for (int channel = 0; channel < signal_.Channels(); channel++)
+        {
+            targetBuffer.CopyChannel(channel, signal_.ChannelDataConst(channel) + position_, samplesCount);
+        }
+
+        targetBuffer.SampleRate(signal_.SampleRate());
+        targetBuffer.DataLengthSamples(samplesCount);
+
+        position_ += samplesCount;
+    }
+};
+
+struct BenchmarkCase
+{
+    std::string Stage;
+    std::string Name;
+    size_t BlockSize;
+    int ChannelsCount;
+
+    // Processes one block of BlockSize samples per channel
+    std::function<void()> Run;
+};
+
+struct BenchmarkResult
+{
+    double NsPerSample;
+    double NsPerSampleMin;
+    double RealTimeFactor;
+    size_t RunsCount;
+};
+
+BenchmarkResult Measure(const BenchmarkCase& benchmarkCase, const BenchmarkOptions& options)
+{
+    const double repetitionSeconds = options.SecondsPerCase / options.Repetitions;
+
+    // Warm up caches and lazily sized buffers, then find how many runs fill a repetition
+    size_t runsPerRepetition = 1;
+
+    for (;;)
+    {
+        auto start = Clock::now();
+
+        for (size_t run = 0; run < runsPerRepetition; run++)
+        {
+            benchmarkCase.Run();
+        }
+
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        if (seconds >= repetitionSeconds / 4)
+        {
+            runsPerRepetition = std::max<size_t>(1, static_cast<size_t>(runsPerRepetition * repetitionSeconds / seconds));
+            break;
+        }
+
+        runsPerRepetition *= 2;
+    }
+
+    std::vector<double> nsPerSample;
+
+    for (int repetition = 0; repetition < options.Repetitions; repetition++)
+    {
+        auto start = Clock::now();
+
+        for (size_t run = 0; run < runsPerRepetition; run++)
+        {
+            benchmarkCase.Run();
+        }
+
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        nsPerSample.push_back(seconds * 1e9 / (runsPerRepetition * benchmarkCase.BlockSize * benchmarkCase.ChannelsCount));
+    }
+
+    std::sort(nsPerSample.begin(), nsPerSample.end());
+
+    BenchmarkResult result;
+    result.NsPerSample = nsPerSample[nsPerSample.size() / 2];
+    result.NsPerSampleMin = nsPerSample.front();
+    result.RealTimeFactor = 1e9 / (result.NsPerSample * benchmarkCase.ChannelsCount * options.SampleRate);
+    result.RunsCount = runsPerRepetition * options.Repetitions;
+
+    return result;
+}
+
+std::string JsonString(const std::string& value)
+{
+    std::string escaped = "\"";
+
+    for (char character : value)
+    {
+        if (character == '"' || character == '\\')
+        {
+            escaped += '\\';
+        }
+
+        escaped += character;
+    }
+
+    return escaped + "\"";
+}
+
+// Owns the stages under test, cases capture them by pointer
+class StageBenchmark
+{
+private:
+    const BenchmarkOptions& options_;
+
+    std::vector<BenchmarkCase> cases_;
+
+    // Pipelines refer to their descriptions, so those go last
+    std::vector<std::unique_ptr<Core::PipelineDescription>> descriptions_;
+    std::vector<std::shared_ptr<void>> stages_;
+
+    template<typename T, typename... Arguments>
+    T* Keep(Arguments&&... arguments)
+    {
+        auto stage = std::make_shared<T>(std::forward<Arguments>(arguments)...);
+        stages_.push_back(stage);
+        return stage.get();
+    }
+
+    // In place stages get the next block of the signal copied before every run
+    template<typename Process>
+    void AddInPlace(const std::string& stage, const std::string& name, size_t blockSize, int channelsCount, Process process)
+    {
+        auto source = Keep<SignalSource>(options_.SampleRate, channelsCount);
+        auto buffer = Keep<Buffers::SingleBuffer<PCMTYPE>>(blockSize, channelsCount);
+
+        cases_.push_back({ stage, name, blockSize, channelsCount, [=]() {
+            source->Next(*buffer, blockSize);
+            process(*buffer);
+        } });
+    }
+
+    void AddSignalCopy();
+    void AddFftConvolutions();
+    void AddStreamConvolvers();
+    void AddIirFilters();
+    void AddCompressors();
+    void AddAutoGain();
+    void AddMetering();
+    void AddPipeline(const std::string& descriptionFileName);
+
+public:
+    explicit StageBenchmark(const BenchmarkOptions& options)
+        : options_(options)
+    {
+    }
+
+    void AddCases(const std::vector<std::string>& descriptionFileNames)
+    {
+        AddSignalCopy();
+        AddFftConvolutions();
+        AddStreamConvolvers();
+        AddIirFilters();
+        AddCompressors();
+        AddAutoGain();
+        AddMetering();
+
+        for (const auto& descriptionFileName : descriptionFileNames)
+        {
+            AddPipeline(descriptionFileName);
+        }
+    }
+
+    void Run(FILE* output);
+};
+
+void StageBenchmark::AddSignalCopy()
+{
+    for (size_t blockSize : BlockSizes)
+    {
+        AddInPlace("baseline", "signal copy", blockSize, options_.ChannelsCount, [](Buffers::SingleBuffer<PCMTYPE>&) {});
+    }
+}
+
+void StageBenchmark::AddFftConvolutions()
+{
+    for (size_t fftSize = 256; fftSize <= 65536; fftSize *= 4)
+    {
+        auto fftEngine = Keep<Fir::FftEngine>(fftSize);
+        auto input = Keep<std::vector<PCMTYPE>>(fftSize);
+        auto output = Keep<std::vector<PCMTYPE>>(fftSize);
+
+        std::vector<std::complex<PCMTYPE>> kernel(fftSize / 2 + 1);
+
+        for (size_t n = 0; n < kernel.size(); n++)
+        {
+            kernel[n] = std::polar(1.0f / (1.0f + n / 64.0f), -static_cast<float>(n) * 0.01f);
+            (*input)[n] = std::sin(n * 0.05f);
+        }
+
+        fftEngine->SetConvolutionKernel(kernel);
+
+        // Overlap-save with a half size kernel consumes half the FFT per convolution
+        cases_.push_back({ "fft", "convolution " + std::to_string(fftSize), fftSize / 2, 1,
+                           [=]() { fftEngine->ExecuteConvolution(*input, *output); } });
+    }
+}
+
+void StageBenchmark::AddStreamConvolvers()
+{
+    for (size_t taps : { 1024, 4096, 16384 })
+    {
+        // Gentle tilt, the kernel length is what matters here
+        std::vector<Fir::EnvelopePoint> envelope(taps / 2 + 1);
+
+        for (size_t n = 0; n < envelope.size(); n++)
+        {
+            float frequency = static_cast<float>(n) * options_.SampleRate / taps;
+            envelope[n] = { frequency, 1.0f / (1.0f + frequency / 5000.0f), 0.0f };
+        }
+
+        for (size_t blockSize : BlockSizes)
+        {
+            auto convolver = Keep<Fir::FirStreamConvolver>(Fir::FirKernelSource(options_.SampleRate, envelope), 0, options_.ChannelsCount);
+            auto source = Keep<SignalSource>(options_.SampleRate, options_.ChannelsCount);
+            auto input = Keep<Buffers::SingleBuffer<PCMTYPE>>(blockSize, options_.ChannelsCount);
+            auto output = Keep<Buffers::SingleBuffer<PCMTYPE>>(blockSize * 2, options_.ChannelsCount);
+
+            cases_.push_back({ "fir", "stream convolver " + std::to_string(taps) + " taps", blockSize, options_.ChannelsCount, [=]() {
+                source->Next(*input, blockSize);
+                convolver->Convolve(*input, *output, 1.0f);
+            } });
+        }
+    }
+}
+
+void StageBenchmark::AddIirFilters()
+{
+    const std::vector<std::string> filterTypeNames = { "lowPass", "highPass", "bandPass", "lowShelf", "highShelf", "bandShelf" };
+
+    for (size_t filterType = 0; filterType < filterTypeNames.size(); filterType++)
+    {
+        for (int order : { 2, 4, 8 })
+        {
+            auto filterDescription = Keep<Iir::IirFilterDescription>();
+
+            filterDescription->IsCrossover = false;
+            filterDescription->FilterType = static_cast<Iir::IirFilterTypes>(filterType);
+            filterDescription->Order = order;
+            filterDescription->CenterFrequency = 1000;
+            filterDescription->BandWidth = 500;
+            filterDescription->GainDb = 6;
+
+            auto filter = Keep<Iir::IirFilter>(options_.SampleRate, options_.ChannelsCount, *filterDescription);
+
+            AddInPlace("iir", filterTypeNames[filterType] + " order " + std::to_string(order), 1024, options_.ChannelsCount,
+                       [=](Buffers::SingleBuffer<PCMTYPE>& buffer) { filter->Apply(buffer); });
+        }
+    }
+}
+
+void StageBenchmark::AddCompressors()
+{
+    for (bool isRmsDetector : { true, false })
+    {
+        for (bool areChannelsLinked : { true, false })
+        {
+            Dynamics::CompressorDescription compressorDescription;
+
+            compressorDescription.SideChainGainDb = 0;
+            compressorDescription.MakeupGainDb = 0;
+            compressorDescription.IsUpward = false;
+            compressorDescription.IsRmsDetector = isRmsDetector;
+            compressorDescription.AreSidechainChannelsAveraged = false;
+            compressorDescription.AreChannelsLinked = areChannelsLinked;
+            compressorDescription.AttackMilliseconds = 20;
+            compressorDescription.ReleaseMilliseconds = 250;
+            compressorDescription.Knee = 2.828427f;
+            compressorDescription.ThresholdDb = -20;
+            compressorDescription.Ratio = 3;
+
+            auto compressor = Keep<Dynamics::Compressor<PCMTYPE>>(options_.SampleRate, options_.ChannelsCount, compressorDescription);
+
+            std::string name = std::string(isRmsDetector ? "rms" : "peak") + (areChannelsLinked ? " linked" : " per channel");
+
+            AddInPlace("compressor", name, 1024, options_.ChannelsCount,
+                       [=](Buffers::SingleBuffer<PCMTYPE>& buffer) { compressor->Apply(buffer); });
+        }
+    }
+}
+
+void StageBenchmark::AddAutoGain()
+{
+    auto reflection = Keep<Core::PipelineReflection>(options_.SampleRate, options_.ChannelsCount, 3);
+    auto autoGainDescription = Keep<Gain::AutoGainDescription>();
+
+    autoGainDescription->IsBypassed = false;
+    autoGainDescription->IsMaster = true;
+    autoGainDescription->Binding = "input";
+    autoGainDescription->GainStepVariableName = "gain";
+    autoGainDescription->GainIncreasePeriodMs = 500;
+
+    auto autoGain = Keep<Gain::AutoGain<PCMTYPE>>(options_.SampleRate, *autoGainDescription, *reflection);
+    auto inputSlot = reflection->PeakLevelSlot("input");
+
+    // Metered the way the pipeline does it, so the gain keeps stepping
+    AddInPlace("autogain", "peak binding", 1024, options_.ChannelsCount, [=](Buffers::SingleBuffer<PCMTYPE>& buffer) {
+        reflection->PushPeakLevel(inputSlot, buffer);
+        autoGain->Apply(buffer);
+    });
+}
+
+void StageBenchmark::AddMetering()
+{
+    for (size_t blockSize : BlockSizes)
+    {
+        auto reflection = Keep<Core::PipelineReflection>(options_.SampleRate, options_.ChannelsCount, 3);
+        auto slot = reflection->PeakLevelSlot("input");
+
+        AddInPlace("metering", "peak", blockSize, options_.ChannelsCount,
+                   [=](Buffers::SingleBuffer<PCMTYPE>& buffer) { reflection->PushPeakLevel(slot, buffer); });
+    }
+
+    auto loudnessReflection = Keep<Core::PipelineReflection>(options_.SampleRate, options_.ChannelsCount, 3);
+    auto loudnessSlot = loudnessReflection->LevelBindingSlot("input:momentary").Slot;
+
+    AddInPlace("metering", "loudness", 1024, options_.ChannelsCount,
+               [=](Buffers::SingleBuffer<PCMTYPE>& buffer) { loudnessReflection->PushPeakLevel(loudnessSlot, buffer); });
+}
+
+void StageBenchmark::AddPipeline(const std::string& descriptionFileName)
+{
+    auto pipelineDescription = std::make_unique<Core::PipelineDescription>(Core::PipelineDescription::FromFile(descriptionFileName));
+
+    // A plug-in running next to the benchmark keeps its meters
+    pipelineDescription->SharedMetersName.clear();
+    pipelineDescription->IsGraphPlanPrinted = false;
+
+    const int channelsCount = pipelineDescription->ChannelsCount;
+    std::string name = descriptionFileName.substr(descriptionFileName.find_last_of('/') + 1);
+
+    for (size_t blockSize : BlockSizes)
+    {
+        auto pipeline = Keep<Core::Pipeline>(options_.SampleRate, *pipelineDescription);
+        auto source = Keep<SignalSource>(options_.SampleRate, channelsCount);
+        auto input = Keep<Buffers::SingleBuffer<PCMTYPE>>(blockSize, channelsCount);
+
+        pipeline->Reserve(blockSize);
+
+        cases_.push_back({ "pipeline", name, blockSize, channelsCount, [=]() {
+            source->Next(*input, blockSize);
+            pipeline->Push(*input);
+            pipeline->Pop();
+        } });
+    }
+
+    descriptions_.push_back(std::move(pipelineDescription));
+}
+
+void StageBenchmark::Run(FILE* output)
+{
+    struct utsname machine;
+    uname(&machine);
+
+    fprintf(output, "{\n  \"machine\": %s,\n  \"system\": %s,\n  \"compiler\": %s,\n", JsonString(machine.machine).c_str(),
+            JsonString(std::string(machine.sysname) + " " + machine.release).c_str(), JsonString(__VERSION__).c_str());
+    fprintf(output, "  \"sampleRate\": %u,\n  \"secondsPerCase\": %g,\n  \"repetitions\": %d,\n  \"results\": [", options_.SampleRate,
+            options_.SecondsPerCase, options_.Repetitions);
+
+    bool isFirst = true;
+
+    for (const auto& benchmarkCase : cases_)
+    {
+        std::string fullName = benchmarkCase.Stage + " " + benchmarkCase.Name;
+
+        if (fullName.find(options_.NameFilter) == std::string::npos)
+        {
+            continue;
+        }
+
+        fprintf(stderr, "%s, block %zu\n", fullName.c_str(), benchmarkCase.BlockSize);
+
+        BenchmarkResult result = Measure(benchmarkCase, options_);
+
+        fprintf(output, "%s\n    { \"stage\": %s, \"name\": %s, \"blockSize\": %zu, \"channels\": %d, \"runs\": %zu, "
+                        "\"nsPerSample\": %.3f, \"nsPerSampleMin\": %.3f, \"realTimeFactor\": %.1f }",
+                isFirst ? "" : ",", JsonString(benchmarkCase.Stage).c_str(), JsonString(benchmarkCase.Name).c_str(), benchmarkCase.BlockSize,
+                benchmarkCase.ChannelsCount, result.RunsCount, result.NsPerSample, result.NsPerSampleMin, result.RealTimeFactor);
+        fflush(output);
+
+        isFirst = false;
+    }
+
+    fprintf(output, "\n  ]\n}\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    BenchmarkOptions options;
+
+    int option;
+
+    while ((option = getopt(argc, argv, "t:r:c:s:f:")) != -1)
+    {
+        switch (option)
+        {
+        case 't':
+            options.SecondsPerCase = std::max(0.01, atof(optarg));
+            break;
+
+        case 'r':
+            options.Repetitions = std::max(1, atoi(optarg));
+            break;
+
+        case 'c':
+            options.ChannelsCount = std::max(1, atoi(optarg));
+            break;
+
+        case 's':
+            options.SampleRate = std::max(8000, atoi(optarg));
+            break;
+
+        case 'f':
+            options.NameFilter = optarg;
+            break;
+
+        default:
+            fprintf(stderr, "Usage: %s [-t seconds per case] [-r repetitions] [-c channels] [-s sample rate] [-f name filter] "
+                            "[descriptions...]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // Descriptions and stages print their settings to stdout, only the results may go there
+    fflush(stdout);
+    FILE* resultsOutput = fdopen(dup(STDOUT_FILENO), "w");
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+
+    StageBenchmark stageBenchmark(options);
+
+    try
+    {
+        stageBenchmark.AddCases(std::vector<std::string>(argv + optind, argv + argc));
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "Unable to set up the benchmarks: %s\n", e.what());
+        return 1;
+    }
+
+    stageBenchmark.Run(resultsOutput);
+    fclose(resultsOutput);
+
+    return 0;
+}